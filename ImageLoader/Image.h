@@ -1,4 +1,6 @@
 #pragma once
+#include <concepts>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 
@@ -24,15 +26,16 @@ public:
 
 	/// <summary>
 	/// Gets the path from which image was originally loaded. This also serves as a unique identifier in <see cref="IImageCache"/>.
+	/// Returned by reference, as it is read on every cache operation. The reference is valid for the lifetime of the image.
 	/// </summary>
 	[[nodiscard]]
-	virtual std::filesystem::path GetImagePath() const = 0;
+	virtual const std::filesystem::path& GetImagePath() const = 0;
 
 	/// <summary>
-	/// Gets the size in bytes of the image.
+	/// Gets the size in bytes of the image. This is 64 bit, as the pixel data of a large image can exceed 4 GiB.
 	/// </summary>
 	[[nodiscard]]
-	virtual unsigned int GetSizeInBytes() const = 0;
+	virtual int64_t GetSizeInBytes() const = 0;
 };
 
 struct IImageSource : public IImage
@@ -48,4 +51,12 @@ public:
 
 };
 
-
+/// <summary>
+/// Satisfied by image types which expose their 8 bit rgba pixel data via GetPixels(). Cached instances of such types can be used
+/// in place of the source image when creating smaller copies of the image.
+/// </summary>
+template<typename TImage>
+concept PixelReadableImage = requires(const TImage& image)
+{
+	{ image.GetPixels() } -> std::convertible_to<const unsigned char*>;
+};
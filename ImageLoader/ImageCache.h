@@ -1,10 +1,76 @@
 #pragma once
 
 #include "Image.h"
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
+#include "Implementations/ImagePathTable.h"
+
+/// <summary>
+/// Why an <see cref="ImageCache"/> removed an image, see <see cref="ImageCache::Subscribe"/>.
+/// </summary>
+enum class CacheRemovalReason
+{
+	/// <summary>
+	/// Evicted to stay within a memory budget.
+	/// </summary>
+	Evicted,
+
+	/// <summary>
+	/// The entry was not requested within the idle timeout, see <see cref="ImageCache::SetIdleTimeout"/>.
+	/// </summary>
+	Expired,
+
+	/// <summary>
+	/// The file at the path changed, see <see cref="ImageCache::TryInvalidateImage"/>.
+	/// </summary>
+	Invalidated,
+
+	/// <summary>
+	/// The image was removed by <see cref="ImageCache::TryRemoveImage"/>, or its last reference was released and it was not retained.
+	/// </summary>
+	Removed
+};
+
+/// <summary>
+/// What an <see cref="ImageCache"/> removed for the image at a path.
+/// </summary>
+enum class CacheRemovalTier
+{
+	SourceImage,
+	ResizedImage,
+	EncodedBytes,
+
+	/// <summary>
+	/// Nothing is cached for the path any longer, reported once for the path of a removed entry and once for each path that was an
+	/// alias of it, so that anything held for those paths can be released. Reported with a size of 0.
+	/// </summary>
+	Entry
+};
+
+/// <summary>
+/// An image removed from an <see cref="ImageCache"/>, reported to its subscribers.
+/// </summary>
+struct CacheRemoval
+{
+	std::filesystem::path ImagePath;
+
+	/// <summary>
+	/// Dimensions of the removed image, or of the source image for encoded contents.
+	/// </summary>
+	int Width = 0;
+	int Height = 0;
+
+	CacheRemovalTier Tier = CacheRemovalTier::ResizedImage;
+	int64_t SizeInBytes = 0;
+	CacheRemovalReason Reason = CacheRemovalReason::Evicted;
+};
 
 namespace ImageCaching
 {
@@ -24,6 +90,13 @@ namespace ImageCaching
 		/// </summary>
 		FoundSourceImageOfDifferentDimensions,
 
+		/// <summary>
+		/// The specified image was not found at the specified dimensions, but a cached copy that is at least as large in both
+		/// dimensions and smaller than the source image was found. The copy is provided as the image, to be resized from instead of
+		/// the source image. Only returned for image types that satisfy <see cref="PixelReadableImage"/>.
+		/// </summary>
+		FoundLargerImageOfDifferentDimensions,
+
 		/// <summary>
 		/// No image matching the path to the image was found.
 		/// </summary>
@@ -51,7 +124,45 @@ namespace ImageCaching
 		/// </summary>
 		NoChange,
 
-		OutOfMemory
+		OutOfMemory,
+
+		/// <summary>
+		/// The cache's admission policy declined to store the provided image, because it has not been requested often enough to
+		/// displace other images. The image is still valid, but the caller remains solely responsible for it.
+		/// </summary>
+		NotAdmitted
+	};
+
+	/// <summary>
+	/// Information provided when an image is added to an implementation of an <see cref="IImageCache" /> interface.
+	/// </summary>
+	struct CacheInsertInfo
+	{
+		/// <summary>
+		/// The measured time it took to create the image, i.e. decoding for a source image, or resizing for a resized image. Used by
+		/// cost aware eviction policies to prefer evicting images which are cheap to re-create.
+		/// </summary>
+		std::chrono::microseconds CreationCost{ 0 };
+
+		/// <summary>
+		/// Hash of the encoded file contents a source image was decoded from, or 0 if it is not known. Files with the same content hash
+		/// and identical contents share a single cache entry, regardless of their paths. Ignored for resized images.
+		/// </summary>
+		uint64_t ContentHash = 0;
+
+		/// <summary>
+		/// The encoded file contents a source image was decoded from, or nullptr if they were not read into memory. A cache may keep
+		/// these after the decoded source image is evicted, see <see cref="IImageCache::TryGetEncodedImage"/>. Ignored for resized
+		/// images.
+		/// </summary>
+		std::shared_ptr<const std::vector<unsigned char>> EncodedBytes;
+
+		/// <summary>
+		/// The namespace of the subsystem adding the image, for caches that give each namespace its own memory budget. The image is
+		/// accounted to this namespace, a source image along with its encoded contents. Empty for the default namespace, which has no
+		/// budget of its own.
+		/// </summary>
+		std::string Namespace;
 	};
 
 	template<typename TImage>
@@ -77,11 +188,12 @@ namespace ImageCaching
 		/// </summary>
 		/// <param name="imagePath">Source path of the image.</param>
 		/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
-		/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
+		/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path. This is nullptr
+		/// if the source image has been evicted from the cache.</param>
 		/// <returns>Result of the operation</returns>
 		virtual TryGetImageResult TryGetImage(const std::filesystem::path& imagePath,
 			std::shared_ptr<const TImage>& outImage,
-			const IImageSource*& outSourceImage) = 0;
+			std::shared_ptr<const IImageSource>& outSourceImage) = 0;
 
 		/// <summary>
 		/// Attempts to get the image identified by the specified path, with the specified width and height in pixels.
@@ -90,12 +202,91 @@ namespace ImageCaching
 		/// <param name="width">The width in pixels of the image to be retrieved.</returns>
 		/// <param name="height">The height in pixels of the image to be retrieved.</returns>
 		/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
-		/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
+		/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path. If the cache
+		/// generates mipmaps, this is the smallest mipmap level that is at least as large as the specified dimensions instead. This is
+		/// nullptr if the source image has been evicted from the cache.</param>
 		/// <returns>Result of the operation</returns>
 		virtual TryGetImageResult TryGetImageAtSize(const std::filesystem::path& imagePath,
 			unsigned int width, unsigned int height,
 			std::shared_ptr<const TImage>& outImage,
-			const IImageSource*& outSourceImage) = 0;
+			std::shared_ptr<const IImageSource>& outSourceImage) = 0;
+
+		/// <summary>
+		/// Attempts to get the image identified by the handle of its interned path, see <see cref="ImagePathTable"/>.
+		/// </summary>
+		/// <param name="imageId">Handle of the source path of the image, which the caller holds a reference to.</param>
+		/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+		/// <param name="outSourceImage">The source image instance retrieved from the cache.</param>
+		/// <returns>Result of the operation</returns>
+		virtual TryGetImageResult TryGetImage(ImageId imageId,
+			std::shared_ptr<const TImage>& outImage,
+			std::shared_ptr<const IImageSource>& outSourceImage) = 0;
+
+		/// <summary>
+		/// Attempts to get the image identified by the handle of its interned path at the specified size, see <see cref="ImagePathTable"/>.
+		/// </summary>
+		/// <param name="imageId">Handle of the source path of the image, which the caller holds a reference to.</param>
+		/// <param name="width">The width in pixels of the image to be retrieved.</returns>
+		/// <param name="height">The height in pixels of the image to be retrieved.</returns>
+		/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+		/// <param name="outSourceImage">The source image instance retrieved from the cache.</param>
+		/// <returns>Result of the operation</returns>
+		virtual TryGetImageResult TryGetImageAtSize(ImageId imageId,
+			unsigned int width, unsigned int height,
+			std::shared_ptr<const TImage>& outImage,
+			std::shared_ptr<const IImageSource>& outSourceImage) = 0;
+
+		/// <summary>
+		/// Attempts to get an image whose file contents are identical to the file at the specified path, by the hash of those contents.
+		/// If a cache entry was added for a different path with the same content hash and identical contents, the specified path
+		/// becomes an alias of that entry so that both paths share its source image and resized images. The returned images may
+		/// report the path of the file that was loaded first.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		/// <param name="contentHash">Hash of the encoded contents of the file at the path.</param>
+		/// <param name="encodedBytes">The encoded contents of the file at the path, compared with those of the entry before the path
+		/// becomes its alias.</param>
+		/// <param name="width">The width in pixels of the image to be retrieved, or 0 together with height for the source dimensions.</param>
+		/// <param name="height">The height in pixels of the image to be retrieved, or 0 together with width for the source dimensions.</param>
+		/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+		/// <param name="outSourceImage">The source image instance retrieved from the cache. This is nullptr if the source image has
+		/// been evicted from the cache.</param>
+		/// <returns>Result of the operation</returns>
+		virtual TryGetImageResult TryGetImageByContent(const std::filesystem::path& imagePath,
+			uint64_t contentHash,
+			const std::vector<unsigned char>& encodedBytes,
+			unsigned int width, unsigned int height,
+			std::shared_ptr<const TImage>& outImage,
+			std::shared_ptr<const IImageSource>& outSourceImage) = 0;
+
+		/// <summary>
+		/// Attempts to get the encoded file contents that the source image at the specified path was decoded from, which the cache may
+		/// keep after evicting the decoded source image. The source image can then be decoded again without reading the file.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		/// <param name="outEncodedBytes">The encoded file contents, or nullptr if they are not cached.</param>
+		/// <returns>True if the encoded file contents were found.</returns>
+		virtual bool TryGetEncodedImage(const std::filesystem::path& imagePath,
+			std::shared_ptr<const std::vector<unsigned char>>& outEncodedBytes) = 0;
+
+		/// <summary>
+		/// Pins the cached image at the specified size, so that it is never evicted whatever the eviction policy, and is kept by the
+		/// cache after its last reference is released. Pinned images are accounted in a separate budget for pinned bytes.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		/// <param name="width">The width in pixels of the image to pin, or 0 together with height to pin the source image.</param>
+		/// <param name="height">The height in pixels of the image to pin, or 0 together with width to pin the source image.</param>
+		/// <returns>True if the image is pinned, false if it is not cached or pinning it would exceed the budget for pinned bytes.</returns>
+		virtual bool Pin(const std::filesystem::path& imagePath, unsigned int width, unsigned int height) = 0;
+
+		/// <summary>
+		/// Unpins an image pinned with <see cref="Pin"/>, so that it is evicted by the eviction policy again.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		/// <param name="width">The width in pixels of the image to unpin, or 0 together with height to unpin the source image.</param>
+		/// <param name="height">The height in pixels of the image to unpin, or 0 together with width to unpin the source image.</param>
+		/// <returns>True if the image was pinned.</returns>
+		virtual bool Unpin(const std::filesystem::path& imagePath, unsigned int width, unsigned int height) = 0;
 
 		/// <summary>
 		/// Constructs a shared pointer to the image instance, adding a custom deleter if required.
@@ -106,20 +297,40 @@ namespace ImageCaching
 		/// <summary>
 		/// Adds the image to the cache, unless the image already exists in the cache at the image's path.
 		/// If there is already an image in the cache for the image's path, outImage will be the instance that that was in the cache.
+		/// If the cache has no entry for the image's path, an entry without a source image is created for it, as for an image created
+		/// from data that did not require the source image to be loaded.
 		/// </summary>
 		/// <param name="image">The image to add into the cache.</param>
+		/// <param name="insertInfo">Information about how the image was created.</param>
 		/// <param name="outImage">If a different instance already exists in the cache at the image's path, this will be set to that instance.
 		/// Otherwise is nullptr.</param>
 		/// <returns>Result of the operation</returns>
-		virtual TryAddImageResult TryAddImage(std::shared_ptr<const TImage> image, const TImage*& outImage) = 0;
+		virtual TryAddImageResult TryAddImage(std::shared_ptr<const TImage> image, const CacheInsertInfo& insertInfo, const TImage*& outImage) = 0;
 
 		/// <summary>
 		/// Adds the source image containing the pixel data of the source file to the cache, unless the source image already 
-		/// exists in the cache.
+		/// exists in the cache. If the cache already has an entry for the image whose source image was evicted, the provided source
+		/// image is restored into that entry.
 		/// </summary>
 		/// <param name="image">The source image</param>
+		/// <param name="insertInfo">Information about how the source image was created.</param>
 		/// <returns>Result of the operation</returns>
-		virtual TryAddImageResult TryAddSourceImage(const IImageSource* image) = 0;
+		virtual TryAddImageResult TryAddSourceImage(std::shared_ptr<const IImageSource> image, const CacheInsertInfo& insertInfo) = 0;
+
+		/// <summary>
+		/// Discards everything cached for the image at the path, because the file at the path has changed. Instances of the image that
+		/// are still referenced remain valid, but are no longer returned by the cache.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		/// <returns>True if anything was cached for the path.</returns>
+		virtual bool TryInvalidateImage(const std::filesystem::path& imagePath) = 0;
+
+		/// <summary>
+		/// Gets whether anything is cached for the image at the path, either in its own entry or as an alias of another entry. Does not
+		/// count as an access of the image.
+		/// </summary>
+		/// <param name="imagePath">Source path of the image.</param>
+		virtual bool ContainsImage(const std::filesystem::path& imagePath) = 0;
 
 		/// <summary>
 		/// Tries to remove the provided image from the cache.
@@ -127,6 +338,19 @@ namespace ImageCaching
 		/// <param name="image">The image to remove.</param>
 		/// <returns>True if the image was removed, false if the image was not found in the cache.</returns>
 		virtual bool TryRemoveImage(const TImage* image) = 0;
+
+		/// <summary>
+		/// Subscribes to the images removed from the cache. Removals are reported in batches once the cache's lock has been released.
+		/// </summary>
+		/// <param name="onRemoved">Invoked with each batch of removals.</param>
+		/// <returns>The id of the subscription, to pass to <see cref="Unsubscribe"/>.</returns>
+		virtual uint64_t Subscribe(std::function<void(const std::vector<CacheRemoval>&)> onRemoved) = 0;
+
+		/// <summary>
+		/// Ends a subscription made with <see cref="Subscribe"/>.
+		/// </summary>
+		/// <returns>True if the subscription existed.</returns>
+		virtual bool Unsubscribe(uint64_t subscriptionId) = 0;
 	};
 
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <future>
 #include <cassert>
 #include <filesystem>
+#include <vector>
 #include "Assert.h"
 
 /// <summary>
@@ -36,13 +37,31 @@ protected:
 
 public:
 	/// <summary>
-	/// Reads the data for an image file from a path. Returns null if the file is not found.
+	/// Reads the data for an image file from a path. Returns null if the file is not found, or could not be decoded.
 	/// </summary>
 	/// <param name="filePath">The absolute path to the file.</param>
 	/// <returns>Image data with dimensions.</returns>
 	[[nodiscard]]
 	virtual ImageData* ReadFile(const std::filesystem::path& filePath) const = 0;
 
+	/// <summary>
+	/// Reads the encoded contents of an image file from a path without decoding it. Returns false if the file is not found.
+	/// </summary>
+	/// <param name="filePath">The absolute path to the file.</param>
+	/// <param name="outBytes">The contents of the file.</param>
+	/// <returns>True if the file was read.</returns>
+	[[nodiscard]]
+	virtual bool TryReadFileBytes(const std::filesystem::path& filePath, std::vector<unsigned char>& outBytes) const = 0;
+
+	/// <summary>
+	/// Decodes image data from the encoded contents of an image file. Returns null if the contents could not be decoded.
+	/// </summary>
+	/// <param name="bytes">The encoded contents of the file.</param>
+	/// <param name="size">Number of bytes of encoded contents.</param>
+	/// <returns>Image data with dimensions.</returns>
+	[[nodiscard]]
+	virtual ImageData* ReadMemory(const unsigned char* bytes, size_t size) const = 0;
+
 	//TODO: zoea 01/12/2024 this should use a TryGet pattern, rather than just have a nullptr returned indicating file not found.
 };
 
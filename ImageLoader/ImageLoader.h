@@ -40,7 +40,12 @@ namespace std
 enum TryGetImageStatus
 {
 	PlacedNewTaskInQueue,
-	TaskAlreadyExistsAndIsQueued
+	TaskAlreadyExistsAndIsQueued,
+
+	/// <summary>
+	/// The file was recently found to be missing or could not be decoded, so no task was created and the callback is not invoked.
+	/// </summary>
+	FileIsUnreadable
 };
 
 template<typename TImage>
@@ -0,0 +1,144 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "../Image.h"
+#include "EvictionPolicy.h"
+#include "ImageCache.h"
+#include "ImageSource.h"
+#include "RequestTrace.h"
+
+/// <summary>
+/// An image with dimensions but no pixels, cached by a <see cref="CacheSimulator"/> in place of a loaded image.
+/// </summary>
+class SimulatedImage final : public IImage
+{
+	const std::filesystem::path _path;
+	const int _width;
+	const int _height;
+
+public:
+	SimulatedImage(const std::filesystem::path& path, const int width, const int height)
+		: _path(path)
+		, _width(width)
+		, _height(height)
+	{
+	}
+
+	[[nodiscard]]
+	int GetWidth() const override {
+		return _width;
+	}
+
+	[[nodiscard]]
+	int GetHeight() const override {
+		return _height;
+	}
+
+	[[nodiscard]]
+	const std::filesystem::path& GetImagePath() const override {
+		return _path;
+	}
+
+	[[nodiscard]]
+	int64_t GetSizeInBytes() const override {
+		return static_cast<int64_t>(_width) * _height * 4;
+	}
+};
+
+/// <summary>
+/// The settings of the cache simulated by a <see cref="CacheSimulator"/>.
+/// </summary>
+struct CacheSimulationSettings
+{
+	int64_t MaxMemory = 0;
+	EvictionPolicy SourcePolicy = EvictionPolicy::LeastRecentlyUsed;
+	EvictionPolicy ResizedPolicy = EvictionPolicy::LeastRecentlyUsed;
+
+	/// <summary>
+	/// The budget for released images, see <see cref="ImageCache::SetMaxRetainedMemory"/>. Negative to retain released images up to
+	/// the whole budget. The simulator releases each image as soon as it is served, so resized images are only found again when
+	/// they are retained.
+	/// </summary>
+	int64_t MaxRetainedMemory = -1;
+};
+
+/// <summary>
+/// The outcome of replaying a request trace through a simulated cache.
+/// </summary>
+struct CacheSimulationResult
+{
+	int64_t MaxMemory = 0;
+	uint64_t RequestCount = 0;
+
+	/// <summary>
+	/// Requests served from the cache at the requested size, without decoding or resizing.
+	/// </summary>
+	uint64_t HitCount = 0;
+
+	/// <summary>
+	/// Bytes of the images requested, and of those served from the cache at the requested size.
+	/// </summary>
+	int64_t RequestedBytes = 0;
+	int64_t HitBytes = 0;
+
+	/// <summary>
+	/// Estimated time spent decoding and resizing images that were not found in the cache.
+	/// </summary>
+	std::chrono::microseconds RecomputeCost{ 0 };
+
+	double GetHitRate() const
+	{
+		return RequestCount > 0 ? static_cast<double>(HitCount) / static_cast<double>(RequestCount) : 0.0;
+	}
+
+	double GetByteHitRate() const
+	{
+		return RequestedBytes > 0 ? static_cast<double>(HitBytes) / static_cast<double>(RequestedBytes) : 0.0;
+	}
+};
+
+/// <summary>
+/// Replays a request trace recorded by a <see cref="RequestTraceRecorder"/> through an <see cref="ImageCache"/> that holds images
+/// with dimensions but no pixels, so that budgets and eviction policies can be compared offline without decoding anything. Each
+/// request is served as an <see cref="ImageLoader"/> would serve it, and costs what the trace measured for decoding and resizing
+/// that image. The costs of work that was not needed when the trace was recorded are estimated from the rest of the trace.
+/// </summary>
+class CacheSimulator final
+{
+	struct SourceInfo
+	{
+		int Width = 0;
+		int Height = 0;
+		int64_t DecodeCostMicroseconds = -1;
+	};
+
+	std::vector<RequestTraceEntry> _trace;
+	std::map<const std::string, SourceInfo> _sources;
+	double _decodeCostPerByte = 0.0;
+	double _resizeCostPerByte = 0.0;
+
+	int64_t EstimateResizeCost(const RequestTraceEntry& request) const;
+
+public:
+	/// <param name="trace">The requests to replay, ordered by timestamp, e.g. read with <see cref="RequestTraceRecorder::TryLoad"/>.</param>
+	CacheSimulator(std::vector<RequestTraceEntry> trace);
+
+	/// <summary>
+	/// Replays the trace through a cache with the settings.
+	/// </summary>
+	CacheSimulationResult Simulate(const CacheSimulationSettings& settings) const;
+
+	/// <summary>
+	/// Replays the trace through a cache at each of the budgets, to plot the hit rate, byte hit rate and recompute cost against the
+	/// budget.
+	/// </summary>
+	/// <param name="budgets">The maximum memory of each simulated cache, in bytes.</param>
+	/// <param name="settings">The settings of every simulated cache other than its maximum memory.</param>
+	std::vector<CacheSimulationResult> SimulateBudgets(const std::vector<int64_t>& budgets, CacheSimulationSettings settings) const;
+};
+
+#include "CacheSimulator.inl"
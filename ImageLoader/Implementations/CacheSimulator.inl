@@ -0,0 +1,128 @@
+#include "CacheSimulator.h"
+#include <algorithm>
+#include <memory>
+
+
+inline CacheSimulator::CacheSimulator(std::vector<RequestTraceEntry> trace)
+	: _trace(std::move(trace))
+{
+	int64_t decodeCost = 0, decodedBytes = 0;
+	int64_t resizeCost = 0, resizedBytes = 0;
+	for (const auto& request : _trace)
+	{
+		auto& source = _sources[request.ImagePath];
+		if (request.SourceWidth > 0 && request.SourceHeight > 0 && source.DecodeCostMicroseconds < 0)
+		{
+			source.Width = request.SourceWidth;
+			source.Height = request.SourceHeight;
+			source.DecodeCostMicroseconds = request.DecodeCostMicroseconds;
+			decodeCost += request.DecodeCostMicroseconds;
+			decodedBytes += static_cast<int64_t>(request.SourceWidth) * request.SourceHeight * 4;
+		}
+
+		if (request.ResizeCostMicroseconds > 0)
+		{
+			resizeCost += request.ResizeCostMicroseconds;
+			resizedBytes += static_cast<int64_t>(request.Width) * request.Height * 4;
+		}
+	}
+
+	_decodeCostPerByte = decodedBytes > 0 ? static_cast<double>(decodeCost) / static_cast<double>(decodedBytes) : 0.0;
+	_resizeCostPerByte = resizedBytes > 0 ? static_cast<double>(resizeCost) / static_cast<double>(resizedBytes) : 0.0;
+
+	//a source that was already cached when the trace was recorded is at least as large as every image served from it.
+	for (const auto& request : _trace)
+	{
+		auto& source = _sources[request.ImagePath];
+		if (source.DecodeCostMicroseconds >= 0)
+			continue;
+
+		source.Width = std::max(source.Width, request.Width);
+		source.Height = std::max(source.Height, request.Height);
+	}
+
+	for (auto& source : _sources)
+	{
+		if (source.second.DecodeCostMicroseconds < 0)
+		{
+			const auto sourceBytes = static_cast<double>(source.second.Width) * source.second.Height * 4;
+			source.second.DecodeCostMicroseconds = static_cast<int64_t>(_decodeCostPerByte * sourceBytes);
+		}
+	}
+}
+
+inline int64_t CacheSimulator::EstimateResizeCost(const RequestTraceEntry& request) const
+{
+	if (request.ResizeCostMicroseconds > 0)
+		return request.ResizeCostMicroseconds;
+
+	return static_cast<int64_t>(_resizeCostPerByte * static_cast<double>(request.Width) * request.Height * 4);
+}
+
+inline CacheSimulationResult CacheSimulator::Simulate(const CacheSimulationSettings& settings) const
+{
+	using namespace ImageCaching;
+
+	ImageCache<SimulatedImage> cache(settings.MaxMemory);
+	cache.SetEvictionPolicy(settings.SourcePolicy, settings.ResizedPolicy);
+	cache.SetMaxRetainedMemory(settings.MaxRetainedMemory < 0 ? settings.MaxMemory : settings.MaxRetainedMemory);
+
+	CacheSimulationResult result;
+	result.MaxMemory = settings.MaxMemory;
+	int64_t recomputeCost = 0;
+
+	for (const auto& request : _trace)
+	{
+		const auto& source = _sources.at(request.ImagePath);
+		const auto imageBytes = static_cast<int64_t>(request.Width) * request.Height * 4;
+		++result.RequestCount;
+		result.RequestedBytes += imageBytes;
+
+		std::shared_ptr<const SimulatedImage> image;
+		std::shared_ptr<const IImageSource> sourceImage;
+		const auto getResult = cache.TryGetImageAtSize(request.ImagePath, request.Width, request.Height, image, sourceImage);
+		if (getResult == TryGetImageResult::FoundExactMatch)
+		{
+			++result.HitCount;
+			result.HitBytes += imageBytes;
+			continue;
+		}
+
+		//served as an image loader serves it, decoding the source if it is not cached and resizing it to the requested size.
+		if (getResult == TryGetImageResult::NotFound)
+		{
+			CacheInsertInfo sourceInsertInfo;
+			sourceInsertInfo.CreationCost = std::chrono::microseconds(source.DecodeCostMicroseconds);
+			cache.TryAddSourceImage(std::make_shared<ImageSource>(request.ImagePath, source.Width, source.Height, nullptr), sourceInsertInfo);
+			recomputeCost += source.DecodeCostMicroseconds;
+		}
+
+		const auto resizeCost = EstimateResizeCost(request);
+		recomputeCost += resizeCost;
+
+		CacheInsertInfo insertInfo;
+		insertInfo.CreationCost = std::chrono::microseconds(resizeCost);
+		const SimulatedImage* existingImage = nullptr;
+		image = cache.MakeSharedPtr(new SimulatedImage(request.ImagePath, request.Width, request.Height));
+		cache.TryAddImage(image, insertInfo, existingImage);
+
+		//released straight away, so that the image is only found again if the cache retains it.
+		image = nullptr;
+	}
+
+	result.RecomputeCost = std::chrono::microseconds(recomputeCost);
+	return result;
+}
+
+inline std::vector<CacheSimulationResult> CacheSimulator::SimulateBudgets(const std::vector<int64_t>& budgets,
+	CacheSimulationSettings settings) const
+{
+	std::vector<CacheSimulationResult> results;
+	for (const auto budget : budgets)
+	{
+		settings.MaxMemory = budget;
+		results.push_back(Simulate(settings));
+	}
+
+	return results;
+}
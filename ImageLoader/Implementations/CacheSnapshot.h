@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// An image that was cached at a particular size, and how often it was requested.
+/// </summary>
+struct CacheSnapshotEntry
+{
+	std::string ImagePath;
+	int Width = 0;
+	int Height = 0;
+	uint32_t AccessCount = 0;
+};
+
+/// <summary>
+/// Reads and writes the hot key set of an image cache, so that a cache can be warmed up with the images that were requested most
+/// often by a previous run. A snapshot only records which images were cached, never their pixels, and is small enough to be written
+/// on shutdown or periodically.
+/// </summary>
+class CacheSnapshot final
+{
+	static constexpr uint32_t FileMagic = 0x53434C49;//"ILCS"
+	static constexpr uint32_t FileVersion = 1;
+
+	template<typename T>
+	static void WriteValue(std::ostream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool ReadValue(std::istream& stream, T& outValue)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&outValue), sizeof(T)));
+	}
+
+public:
+	/// <summary>
+	/// Writes the entries to a snapshot file, replacing any existing snapshot. The file is written beside the path and then renamed
+	/// over it, so that a crash while saving leaves the previous snapshot intact.
+	/// </summary>
+	/// <param name="filePath">Path of the snapshot file.</param>
+	/// <param name="entries">The entries to write.</param>
+	/// <returns>True if the snapshot was written.</returns>
+	static bool TrySave(const std::filesystem::path& filePath, const std::vector<CacheSnapshotEntry>& entries)
+	{
+		auto temporaryPath = filePath;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			WriteValue(file, FileMagic);
+			WriteValue(file, FileVersion);
+			WriteValue(file, static_cast<uint64_t>(entries.size()));
+
+			for (const auto& entry : entries)
+			{
+				WriteValue(file, static_cast<uint32_t>(entry.ImagePath.size()));
+				file.write(entry.ImagePath.data(), static_cast<std::streamsize>(entry.ImagePath.size()));
+				WriteValue(file, entry.Width);
+				WriteValue(file, entry.Height);
+				WriteValue(file, entry.AccessCount);
+			}
+
+			if (!file)
+				return false;
+		}
+
+		std::error_code errorCode;
+		std::filesystem::rename(temporaryPath, filePath, errorCode);
+		return !errorCode;
+	}
+
+	/// <summary>
+	/// Reads the entries of a snapshot file, ordered by access count with the most frequently requested image first.
+	/// </summary>
+	/// <param name="filePath">Path of the snapshot file.</param>
+	/// <param name="outEntries">The entries of the snapshot, empty if it could not be read.</param>
+	/// <returns>False if the snapshot is missing or corrupt.</returns>
+	static bool TryLoad(const std::filesystem::path& filePath, std::vector<CacheSnapshotEntry>& outEntries)
+	{
+		outEntries.clear();
+
+		std::ifstream file(filePath, std::ios::binary);
+		uint32_t magic, version;
+		uint64_t entryCount;
+		if (!file || !ReadValue(file, magic) || !ReadValue(file, version) || !ReadValue(file, entryCount)
+			|| magic != FileMagic || version != FileVersion)
+			return false;
+
+		for (uint64_t i = 0; i < entryCount; i++)
+		{
+			uint32_t pathLength;
+			if (!ReadValue(file, pathLength))
+			{
+				outEntries.clear();
+				return false;
+			}
+
+			CacheSnapshotEntry entry;
+			entry.ImagePath.resize(pathLength);
+			if (!file.read(entry.ImagePath.data(), pathLength) || !ReadValue(file, entry.Width) || !ReadValue(file, entry.Height)
+				|| !ReadValue(file, entry.AccessCount) || entry.Width < 0 || entry.Height < 0)
+			{
+				outEntries.clear();
+				return false;
+			}
+
+			outEntries.push_back(std::move(entry));
+		}
+
+		SortByAccessCount(outEntries);
+		return true;
+	}
+
+	/// <summary>
+	/// Orders the entries with the most frequently requested image first.
+	/// </summary>
+	static void SortByAccessCount(std::vector<CacheSnapshotEntry>& entries)
+	{
+		std::stable_sort(entries.begin(), entries.end(), [](const CacheSnapshotEntry& a, const CacheSnapshotEntry& b)
+		{
+			return a.AccessCount > b.AccessCount;
+		});
+	}
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/// <summary>
+/// Computes a fast non-cryptographic 64 bit hash of file contents, used to recognize byte identical image files stored under different
+/// paths. The hash consumes 8 bytes per step with the mixing and finalization steps of xxHash64, and is only suitable for
+/// detecting duplicates, not for detecting deliberate tampering.
+/// </summary>
+class ContentHasher final
+{
+	static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	static constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	static constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	static uint64_t RotateLeft(const uint64_t value, const int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+public:
+	/// <summary>
+	/// Hashes the provided bytes. The result is never 0, so that 0 can be used to indicate that no hash is known.
+	/// </summary>
+	/// <param name="data">The bytes to hash.</param>
+	/// <param name="size">Number of bytes to hash.</param>
+	/// <returns>Hash of the bytes.</returns>
+	[[nodiscard]]
+	static uint64_t Hash(const unsigned char* data, const size_t size)
+	{
+		uint64_t hash = Prime5 + static_cast<uint64_t>(size);
+
+		size_t offset = 0;
+		for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, data + offset, sizeof(word));
+
+			hash ^= RotateLeft(word * Prime2, 31) * Prime1;
+			hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+		}
+
+		for (; offset < size; offset++)
+		{
+			hash ^= data[offset] * Prime5;
+			hash = RotateLeft(hash, 11) * Prime1;
+		}
+
+		hash ^= hash >> 33;
+		hash *= Prime2;
+		hash ^= hash >> 29;
+		hash *= Prime3;
+		hash ^= hash >> 32;
+
+		return hash != 0 ? hash : 1;
+	}
+
+	/// <summary>
+	/// Gets whether the file at the path holds exactly the provided bytes. Files with equal hashes are compared with this before
+	/// they are treated as identical, as different files can share a 64 bit hash.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	/// <param name="data">The bytes to compare the file with.</param>
+	/// <param name="size">Number of bytes to compare.</param>
+	/// <returns>False if the contents differ, or the file cannot be read.</returns>
+	[[nodiscard]]
+	static bool IsFileContent(const std::filesystem::path& filePath, const unsigned char* data, const size_t size)
+	{
+		std::error_code errorCode;
+		if (std::filesystem::file_size(filePath, errorCode) != size || errorCode)
+			return false;
+
+		std::ifstream file(filePath, std::ios::binary);
+		std::vector<char> chunk(64 * 1024);
+		for (size_t offset = 0; offset < size; offset += chunk.size())
+		{
+			const auto length = std::min(chunk.size(), size - offset);
+			if (!file.read(chunk.data(), static_cast<std::streamsize>(length)) || memcmp(chunk.data(), data + offset, length) != 0)
+				return false;
+		}
+
+		return true;
+	}
+};
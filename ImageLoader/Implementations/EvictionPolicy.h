@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+/// <summary>
+/// Specifies how <see cref="ImageCache"/> chooses which items to evict when memory is needed for a new image.
+/// </summary>
+enum EvictionPolicy
+{
+	/// <summary>
+	/// Nothing is evicted. Adding an image that would exceed the maximum memory fails with OutOfMemory.
+	/// </summary>
+	NeverEvict,
+
+	/// <summary>
+	/// The least recently requested items are evicted first.
+	/// </summary>
+	LeastRecentlyUsed,
+
+	/// <summary>
+	/// GreedyDual-Size-Frequency. Items are evicted in order of (creation cost x request frequency / size), offset by an inflation
+	/// value that rises with each eviction so that items which are no longer requested eventually age out. Under memory pressure
+	/// this minimizes the total time spent re-creating evicted items, rather than only the number of bytes freed.
+	/// </summary>
+	GreedyDualSizeFrequency
+};
+
+/// <summary>
+/// Computes the eviction priority of cached items for an <see cref="EvictionPolicy"/>. Items with the lowest priority are evicted first.
+/// This class is not threadsafe, the owning cache is responsible for synchronization.
+/// </summary>
+class EvictionPriorityCalculator final
+{
+	EvictionPolicy _policy;
+	double _inflation = 0.0;
+	uint64_t _accessCount = 0;
+
+public:
+	EvictionPriorityCalculator(const EvictionPolicy policy = EvictionPolicy::NeverEvict)
+		: _policy(policy)
+	{
+	}
+
+	[[nodiscard]]
+	EvictionPolicy GetPolicy() const {
+		return _policy;
+	}
+
+	/// <summary>
+	/// Computes the priority of an item that has just been added or requested.
+	/// </summary>
+	/// <param name="frequency">Number of times the item has been requested.</param>
+	/// <param name="creationCost">Measured time it took to create the item.</param>
+	/// <param name="sizeInBytes">Size of the item.</param>
+	/// <returns>The new eviction priority of the item.</returns>
+	[[nodiscard]]
+	double OnAccess(const uint32_t frequency, const std::chrono::microseconds creationCost, const int64_t sizeInBytes)
+	{
+		switch (_policy)
+		{
+		case EvictionPolicy::NeverEvict:
+		case EvictionPolicy::LeastRecentlyUsed:
+			return static_cast<double>(++_accessCount);
+
+		case EvictionPolicy::GreedyDualSizeFrequency:
+		{
+			//a cost of zero would make every unmeasured item equally worthless, so count it as a minimal cost instead.
+			const double cost = static_cast<double>(std::max<int64_t>(creationCost.count(), 1));
+			const double size = static_cast<double>(std::max<int64_t>(sizeInBytes, 1));
+			return _inflation + static_cast<double>(frequency) * cost / size;
+		}
+
+		default:
+			throw std::runtime_error("Unknown value for EvictionPolicy");
+		}
+	}
+
+	/// <summary>
+	/// Informs the calculator that an item with the provided priority has been evicted.
+	/// </summary>
+	void OnEvicted(const double priority)
+	{
+		if (_policy == EvictionPolicy::GreedyDualSizeFrequency && priority > _inflation)
+			_inflation = priority;
+	}
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+/// <summary>
+/// The identity of a file's contents on disk, used to detect that a file has changed without reading it.
+/// </summary>
+struct FileStat
+{
+	uint64_t SizeInBytes = 0;
+
+	/// <summary>
+	/// Last write time of the file, in ticks of the filesystem clock.
+	/// </summary>
+	int64_t ModifiedTime = 0;
+
+	/// <summary>
+	/// Inode number of the file, or 0 on platforms where it is not available.
+	/// </summary>
+	uint64_t FileId = 0;
+
+	bool operator==(const FileStat&) const = default;
+};
+
+/// <summary>
+/// Caches the results of querying the filesystem for image files for a short time, so that repeated requests for the same path do not
+/// hit the filesystem each time. Paths which are missing or could not be decoded are cached as well, so that repeated requests for
+/// them fail without touching the filesystem or the decoder. This class is threadsafe.
+/// </summary>
+class FileStatCache final
+{
+	enum FileState
+	{
+		Readable,
+		Missing,
+		Undecodable
+	};
+
+	struct CachedFileStat
+	{
+		FileStat Stat;
+		FileState State = FileState::Readable;
+		std::chrono::steady_clock::time_point ExpiresAt;
+	};
+
+	/// <summary>
+	/// Number of cached paths above which expired entries are pruned when a new path is added.
+	/// </summary>
+	static constexpr size_t PruneThreshold = 4096;
+
+	mutable std::mutex _lock;
+	std::map<const std::string, CachedFileStat> _stats;
+	std::chrono::steady_clock::duration _timeToLive;
+
+	/// <summary>
+	/// Queries the filesystem for the stat of a file. Returns false if the file does not exist.
+	/// </summary>
+	static bool TryReadStat(const std::string& path, FileStat& outStat)
+	{
+#if defined(_WIN32)
+		std::error_code errorCode;
+		const auto size = std::filesystem::file_size(path, errorCode);
+		if (errorCode)
+			return false;
+
+		const auto modifiedTime = std::filesystem::last_write_time(path, errorCode);
+		if (errorCode)
+			return false;
+
+		outStat.SizeInBytes = size;
+		outStat.ModifiedTime = modifiedTime.time_since_epoch().count();
+		outStat.FileId = 0;
+#else
+		//a single stat call provides all three values, where std::filesystem would query the file once for each.
+		struct stat fileStatus {};
+		if (stat(path.c_str(), &fileStatus) != 0 || !S_ISREG(fileStatus.st_mode))
+			return false;
+
+		outStat.SizeInBytes = static_cast<uint64_t>(fileStatus.st_size);
+#if defined(__APPLE__)
+		outStat.ModifiedTime = static_cast<int64_t>(fileStatus.st_mtimespec.tv_sec) * 1000000000 + fileStatus.st_mtimespec.tv_nsec;
+#else
+		outStat.ModifiedTime = static_cast<int64_t>(fileStatus.st_mtim.tv_sec) * 1000000000 + fileStatus.st_mtim.tv_nsec;
+#endif
+		outStat.FileId = static_cast<uint64_t>(fileStatus.st_ino);
+#endif
+		return true;
+	}
+
+	void PruneExpired(const std::chrono::steady_clock::time_point now)
+	{
+		for (auto iterator = _stats.begin(); iterator != _stats.end();)
+		{
+			if (iterator->second.ExpiresAt <= now)
+				iterator = _stats.erase(iterator);
+			else
+				++iterator;
+		}
+	}
+
+public:
+	/// <param name="timeToLive">How long the result of querying the filesystem for a path is reused before it is queried again.</param>
+	FileStatCache(const std::chrono::steady_clock::duration timeToLive = std::chrono::seconds(2))
+		: _timeToLive(timeToLive)
+	{
+	}
+
+	/// <summary>
+	/// Sets how long the result of querying the filesystem for a path is reused before it is queried again. A value of 0 queries the
+	/// filesystem on every request.
+	/// </summary>
+	void SetTimeToLive(const std::chrono::steady_clock::duration timeToLive)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		_timeToLive = timeToLive;
+	}
+
+	/// <summary>
+	/// Gets the stat of a readable file. Returns false if the file does not exist, or if it was marked as undecodable and has not
+	/// changed since.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	/// <param name="outStat">The stat of the file.</param>
+	/// <returns>True if the file exists and may be decodable.</returns>
+	bool TryGetStat(const std::filesystem::path& filePath, FileStat& outStat)
+	{
+		const auto key = filePath.string();
+		const auto now = std::chrono::steady_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lockGuard(_lock);
+			if (auto search = _stats.find(key); search != _stats.end() && search->second.ExpiresAt > now)
+			{
+				outStat = search->second.Stat;
+				return search->second.State == FileState::Readable;
+			}
+		}
+
+		//the filesystem is queried outside of the lock, so that a slow filesystem does not block requests for other paths.
+		FileStat stat;
+		const bool exists = TryReadStat(key, stat);
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		auto& cached = _stats[key];
+
+		//a file that could not be decoded stays undecodable until it is changed.
+		if (!exists)
+			cached.State = FileState::Missing;
+		else if (cached.State != FileState::Undecodable || !(cached.Stat == stat))
+			cached.State = FileState::Readable;
+
+		cached.Stat = stat;
+		cached.ExpiresAt = now + _timeToLive;
+
+		if (_stats.size() > PruneThreshold)
+			PruneExpired(now);
+
+		outStat = stat;
+		return exists && cached.State == FileState::Readable;
+	}
+
+	/// <summary>
+	/// Records that the file at the path exists but could not be decoded. Requests for the path fail without being decoded again
+	/// until the file is changed.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	void MarkUndecodable(const std::filesystem::path& filePath)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		auto& cached = _stats[filePath.string()];
+		cached.State = FileState::Undecodable;
+		cached.ExpiresAt = std::chrono::steady_clock::now() + _timeToLive;
+	}
+
+	/// <summary>
+	/// Gets whether the path was recently found to be missing or undecodable, without querying the filesystem.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	bool IsKnownUnreadable(const std::filesystem::path& filePath) const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		const auto search = _stats.find(filePath.string());
+		return search != _stats.end()
+			&& search->second.ExpiresAt > std::chrono::steady_clock::now()
+			&& search->second.State != FileState::Readable;
+	}
+
+	/// <summary>
+	/// Discards the cached result for the path, so that the next request queries the filesystem.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	void Invalidate(const std::filesystem::path& filePath)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		_stats.erase(filePath.string());
+	}
+};
@@ -0,0 +1,285 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Watches image files for changes on a background thread, and reports each changed, replaced or deleted file to a callback. On Linux
+/// this uses inotify, watching the directory of each file so that files which are replaced by a rename are still reported, and costs
+/// no polling. On other platforms <see cref="IsSupported"/> is false and files are never reported.
+/// </summary>
+class FileWatcher final
+{
+	std::function<void(const std::filesystem::path&)> _onFileChanged;
+
+#if defined(__linux__)
+	struct WatchedPath
+	{
+		std::filesystem::path Path;
+		int ReferenceCount = 0;
+	};
+
+	struct WatchedDirectory
+	{
+		std::string DirectoryPath;
+
+		/// <summary>
+		/// Watched files in the directory, by file name, with each spelling of the path the file was registered with. A change to the
+		/// file is reported once for every spelling.
+		/// </summary>
+		std::map<const std::string, std::map<const std::string, WatchedPath>> Files;
+	};
+
+	std::mutex _lock;
+	std::map<int, WatchedDirectory> _directories;
+	std::map<const std::string, int> _directoryWatches;
+	int _inotifyFd = -1;
+	int _wakeFd = -1;
+	std::atomic<bool> _stop = false;
+	std::thread _thread;
+#endif
+
+public:
+	/// <param name="onFileChanged">Invoked on the watcher's thread with the registered path of each watched file that changed.</param>
+	FileWatcher(std::function<void(const std::filesystem::path&)> onFileChanged)
+		: _onFileChanged(std::move(onFileChanged))
+	{
+#if defined(__linux__)
+		_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_inotifyFd < 0)
+			throw std::runtime_error("Failed to initialize inotify.");
+
+		_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (_wakeFd < 0)
+		{
+			close(_inotifyFd);
+			throw std::runtime_error("Failed to create the file watcher wake event.");
+		}
+
+		_thread = std::thread(&FileWatcher::Run, this);
+#endif
+	}
+
+	~FileWatcher()
+	{
+#if defined(__linux__)
+		_stop = true;
+		const uint64_t wake = 1;
+		[[maybe_unused]] const auto written = write(_wakeFd, &wake, sizeof(wake));
+		_thread.join();
+
+		close(_wakeFd);
+		close(_inotifyFd);
+#endif
+	}
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	/// <summary>
+	/// Gets whether file watching is available on this platform.
+	/// </summary>
+	static constexpr bool IsSupported()
+	{
+#if defined(__linux__)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/// <summary>
+	/// Gets the number of watched paths, counting each spelling of a file's path.
+	/// </summary>
+	size_t GetWatchedFileCount()
+	{
+#if defined(__linux__)
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		size_t count = 0;
+		for (const auto& directory : _directories)
+			for (const auto& file : directory.second.Files)
+				count += file.second.size();
+
+		return count;
+#else
+		return 0;
+#endif
+	}
+
+	/// <summary>
+	/// Starts watching the file at the path. Watches are counted per spelling of the path, each call has to be matched by a call to
+	/// <see cref="Unwatch"/> with the same spelling.
+	/// </summary>
+	/// <param name="filePath">Path to the file.</param>
+	/// <returns>True if the file is watched.</returns>
+	bool Watch(const std::filesystem::path& filePath)
+	{
+#if defined(__linux__)
+		const auto directoryPath = GetDirectoryPath(filePath);
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+
+		int watch;
+		if (auto search = _directoryWatches.find(directoryPath); search != _directoryWatches.end())
+		{
+			watch = search->second;
+		}
+		else
+		{
+			watch = inotify_add_watch(_inotifyFd, directoryPath.c_str(),
+				IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF);
+			if (watch < 0)
+				return false;
+
+			_directoryWatches[directoryPath] = watch;
+			_directories[watch].DirectoryPath = directoryPath;
+		}
+
+		auto& watchedPath = _directories[watch].Files[filePath.filename().string()][filePath.string()];
+		watchedPath.Path = filePath;
+		++watchedPath.ReferenceCount;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/// <summary>
+	/// Releases one watch of the file at the path. The spelling is no longer reported once all its watches are released, and the
+	/// directory of the file is no longer watched once it has no watched files.
+	/// </summary>
+	/// <param name="filePath">Path to the file, spelled as it was watched.</param>
+	void Unwatch(const std::filesystem::path& filePath)
+	{
+#if defined(__linux__)
+		const auto directoryPath = GetDirectoryPath(filePath);
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		const auto search = _directoryWatches.find(directoryPath);
+		if (search == _directoryWatches.end())
+			return;
+
+		auto& directory = _directories[search->second];
+		const auto file = directory.Files.find(filePath.filename().string());
+		if (file == directory.Files.end())
+			return;
+
+		const auto watchedPath = file->second.find(filePath.string());
+		if (watchedPath == file->second.end() || --watchedPath->second.ReferenceCount > 0)
+			return;
+
+		file->second.erase(watchedPath);
+		if (file->second.empty())
+			directory.Files.erase(file);
+
+		if (directory.Files.empty())
+		{
+			inotify_rm_watch(_inotifyFd, search->second);
+			_directories.erase(search->second);
+			_directoryWatches.erase(search);
+		}
+#endif
+	}
+
+private:
+#if defined(__linux__)
+	/// <summary>
+	/// Gets the absolute path of the directory of the file, so that different spellings of the path share one watch.
+	/// </summary>
+	static std::string GetDirectoryPath(const std::filesystem::path& filePath)
+	{
+		std::error_code errorCode;
+		auto absolutePath = std::filesystem::absolute(filePath, errorCode);
+		if (errorCode)
+			absolutePath = filePath;
+
+		auto directoryPath = absolutePath.lexically_normal().parent_path().string();
+		return directoryPath.empty() ? "." : directoryPath;
+	}
+
+	void Run()
+	{
+		//inotify events are aligned to and contain an int, the buffer must be aligned to match.
+		alignas(inotify_event) char buffer[4096];
+
+		pollfd pollFds[2] = { { _inotifyFd, POLLIN, 0 }, { _wakeFd, POLLIN, 0 } };
+		while (!_stop)
+		{
+			if (poll(pollFds, 2, -1) <= 0)
+				continue;
+
+			if (pollFds[1].revents & POLLIN)
+				break;
+
+			std::vector<std::filesystem::path> changedFiles;
+			ssize_t length;
+			while ((length = read(_inotifyFd, buffer, sizeof(buffer))) > 0)
+			{
+				std::lock_guard<std::mutex> lockGuard(_lock);
+				for (char* position = buffer; position < buffer + length;)
+				{
+					const auto* event = reinterpret_cast<const inotify_event*>(position);
+					position += sizeof(inotify_event) + event->len;
+					OnEvent(*event, changedFiles);
+				}
+			}
+
+			//the callback is invoked without holding the lock, so that it can watch or unwatch files.
+			for (const auto& changedFile : changedFiles)
+				_onFileChanged(changedFile);
+		}
+	}
+
+	void OnEvent(const inotify_event& event, std::vector<std::filesystem::path>& outChangedFiles)
+	{
+		//events were dropped, so any watched file may have changed.
+		if (event.mask & IN_Q_OVERFLOW)
+		{
+			for (const auto& directory : _directories)
+				for (const auto& file : directory.second.Files)
+					for (const auto& watchedPath : file.second)
+						outChangedFiles.push_back(watchedPath.second.Path);
+
+			return;
+		}
+
+		const auto search = _directories.find(event.wd);
+		if (search == _directories.end())
+			return;
+
+		//the directory itself is gone, every file in it is reported and the watch is dropped.
+		if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+		{
+			for (const auto& file : search->second.Files)
+				for (const auto& watchedPath : file.second)
+					outChangedFiles.push_back(watchedPath.second.Path);
+
+			if (!(event.mask & IN_IGNORED))
+				inotify_rm_watch(_inotifyFd, event.wd);
+
+			_directoryWatches.erase(search->second.DirectoryPath);
+			_directories.erase(search);
+			return;
+		}
+
+		if (event.len == 0)
+			return;
+
+		if (auto file = search->second.Files.find(event.name); file != search->second.Files.end())
+			for (const auto& watchedPath : file->second)
+				outChangedFiles.push_back(watchedPath.second.Path);
+	}
+#endif
+};
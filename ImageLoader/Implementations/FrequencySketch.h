@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Count-min sketch used to estimate how often a key has been requested, without storing the keys themselves.
+/// Counters saturate at 15 and are halved once enough increments have been recorded, so that the estimate follows
+/// recent popularity rather than popularity since the start of the process.
+/// </summary>
+class FrequencySketch final
+{
+	static constexpr int RowCount = 4;
+	static constexpr uint64_t RowSeeds[RowCount] = {
+		0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full, 0xcbf29ce484222325ull };
+
+	std::vector<uint8_t> _counters;
+	uint64_t _rowWidth = 1;
+	uint64_t _sampleSize;
+	uint64_t _incrementCount = 0;
+
+public:
+	/// <summary>
+	/// The value counters saturate at.
+	/// </summary>
+	static constexpr uint8_t MaxCounterValue = 15;
+
+	/// <summary>
+	/// Constructs a sketch sized for approximately the provided number of distinct keys.
+	/// </summary>
+	/// <param name="expectedEntryCount">Number of distinct keys the sketch is expected to track.</param>
+	FrequencySketch(const size_t expectedEntryCount)
+	{
+		while (_rowWidth < std::max<size_t>(expectedEntryCount, 16))
+			_rowWidth <<= 1;
+
+		_counters.resize(_rowWidth * RowCount, 0);
+		_sampleSize = _rowWidth * 10;
+	}
+
+	/// <summary>
+	/// Records one occurrence of the key identified by the hash.
+	/// </summary>
+	void Increment(const uint64_t keyHash)
+	{
+		for (int row = 0; row < RowCount; row++)
+		{
+			auto& counter = _counters[IndexOf(keyHash, row)];
+			if (counter < MaxCounterValue)
+				++counter;
+		}
+
+		if (++_incrementCount >= _sampleSize)
+			Age();
+	}
+
+	/// <summary>
+	/// Gets the estimated number of recent occurrences of the key identified by the hash.
+	/// </summary>
+	[[nodiscard]]
+	uint32_t EstimateFrequency(const uint64_t keyHash) const
+	{
+		uint32_t result = MaxCounterValue;
+		for (int row = 0; row < RowCount; row++)
+			result = std::min<uint32_t>(result, _counters[IndexOf(keyHash, row)]);
+
+		return result;
+	}
+
+private:
+	[[nodiscard]]
+	size_t IndexOf(const uint64_t keyHash, const int row) const
+	{
+		uint64_t mixed = (keyHash ^ RowSeeds[row]) * 0x9e3779b97f4a7c15ull;
+		mixed ^= mixed >> 32;
+		return static_cast<size_t>(row * _rowWidth + (mixed & (_rowWidth - 1)));
+	}
+
+	/// <summary>
+	/// Halves every counter, so that keys which are no longer requested lose their accumulated frequency over time.
+	/// </summary>
+	void Age()
+	{
+		for (auto& counter : _counters)
+			counter >>= 1;
+
+		_incrementCount /= 2;
+	}
+};
@@ -1,11 +1,32 @@
 #pragma once
 #include "../ImageCache.h"
 #include "../Image.h"
+#include "../SourceImageStore.h"
+#include <algorithm>
+#include <cmath>
 #include <string>
+#include <limits>
+#include <tuple>
 #include <map>
+#include <set>
 #include <filesystem>
+#include <functional>
 #include <mutex>
 #include <memory>
+#include <optional>
+#include <vector>
+#include <atomic>
+#include "../Assert.h"
+#include "CacheSnapshot.h"
+#include "ContentHasher.h"
+#include "EvictionPolicy.h"
+#include "ImagePathTable.h"
+#include "ImageResampler.h"
+#include "ImageSource.h"
+#include "PathCanonicalizer.h"
+#include "SpillFile.h"
+#include "ThreadLocalImageLookup.h"
+#include "TinyLfuAdmissionFilter.h"
 
 struct ResizedImageKey
 {
@@ -25,17 +46,87 @@ struct ResizedImageKey
 	}
 };
 
+/// <summary>
+/// The memory budget and usage of a namespace of an <see cref="ImageCache"/>, see <see cref="ImageCache::SetNamespaceBudget"/>.
+/// </summary>
+struct CacheNamespace
+{
+	int64_t MinimumMemory = 0;
+	int64_t MaxMemory = std::numeric_limits<int64_t>::max();
+	int64_t MemoryUsage = 0;
+};
+
 template<typename TImage>
 class ImageCacheItem
 {
 
 	std::weak_ptr<const TImage> _image;
+	const TImage* _imageInstance;
+
+	/// <summary>
+	/// The image instance, owned by this item once its last shared pointer has been released and the cache chose to retain it.
+	/// </summary>
+	const TImage* _retainedImage = nullptr;
 
 public:
+	/// <summary>
+	/// Size in bytes accounted to this item by the cache.
+	/// </summary>
+	const int64_t SizeInBytes;
+
+	/// <summary>
+	/// Measured time it took to resize the image.
+	/// </summary>
+	const std::chrono::microseconds CreationCost;
+
+	/// <summary>
+	/// Priority of this item for the cache's <see cref="EvictionPolicy"/> while it is retained, the lowest priority is evicted first.
+	/// </summary>
+	double EvictionPriority = 0.0;
+
+	/// <summary>
+	/// The priority the item is ordered by in the cache's index of retained images, which lags <see cref="EvictionPriority"/> until
+	/// the item is indexed again.
+	/// </summary>
+	double IndexedEvictionPriority = 0.0;
+
+	/// <summary>
+	/// Number of times the item has been requested from the cache.
+	/// </summary>
+	uint32_t AccessCount = 1;
+
+	/// <summary>
+	/// Requests for the item answered by thread-local lookups that have not been folded into <see cref="AccessCount"/> yet, or nullptr
+	/// if the item was never placed in a thread-local lookup.
+	/// </summary>
+	std::shared_ptr<ThreadLocalHitCounter> ThreadLocalHits;
+
+	/// <summary>
+	/// True if the item is pinned, in which case it is never evicted, and is retained outside of the cache's retention budget.
+	/// </summary>
+	bool IsPinned = false;
+
+	/// <summary>
+	/// The namespace the image is accounted to, or nullptr for the default namespace.
+	/// </summary>
+	CacheNamespace* Namespace = nullptr;
+
+	const int Width;
+	const int Height;
 
-	ImageCacheItem(std::weak_ptr<const TImage>& image)
+	ImageCacheItem(std::weak_ptr<const TImage>& image, const int64_t sizeInBytes, const std::chrono::microseconds creationCost)
 		: _image(image)
+		, _imageInstance(image.lock().get())
+		, SizeInBytes(sizeInBytes)
+		, CreationCost(creationCost)
+		, Width(_imageInstance->GetWidth())
+		, Height(_imageInstance->GetHeight())
+	{
+	}
+
+	~ImageCacheItem()
 	{
+		delete _retainedImage;
 	}
 
 	[[nodiscard]]
@@ -44,31 +135,204 @@ public:
 		return _image.lock();
 	}
 
+	/// <summary>
+	/// Gets whether the image has no remaining references outside the cache, and is being retained by this item.
+	/// </summary>
+	[[nodiscard]]
+	bool IsRetained() const
+	{
+		return _retainedImage != nullptr;
+	}
+
+	/// <summary>
+	/// Takes ownership of the image instance after its last shared pointer was released.
+	/// </summary>
+	void Retain(const TImage* image)
+	{
+		ASSERT_MSG(IsInstance(image), "Only the cached instance can be retained");
+		_retainedImage = image;
+	}
+
+	/// <summary>
+	/// Hands ownership of the retained image to a new shared pointer, which this item then references weakly again.
+	/// </summary>
+	/// <param name="makeSharedPtr">Constructs the shared pointer for the image.</param>
+	template<typename TMakeSharedPtr>
+	[[nodiscard]]
+	std::shared_ptr<const TImage> Reacquire(TMakeSharedPtr makeSharedPtr)
+	{
+		std::shared_ptr<const TImage> result = makeSharedPtr(_retainedImage);
+		_retainedImage = nullptr;
+		_image = result;
+		return result;
+	}
+	/// <summary>
+	/// Gets whether this item refers to the provided image instance. This remains valid after the weak pointer has expired, so that
+	/// an image which was never added to the cache cannot remove a different instance cached at the same size.
+	/// </summary>
+	[[nodiscard]]
+	bool IsInstance(const TImage* image) const
+	{
+		return _imageInstance == image;
+	}
+
 };
 
 template<typename TImage>
 struct ImageCacheEntry final
 {
-	const std::filesystem::path ImagePath;
-	const IImageSource* SourceImage;
+	/// <summary>
+	/// Handle of the path of the entry in the shared <see cref="ImagePathTable"/>, whose reference the entry holds.
+	/// </summary>
+	const ImageId Id;
+
+	/// <summary>
+	/// Key of the entry in the cache, which differs from its path if paths are canonicalized.
+	/// </summary>
+	std::string Key;
+
+	/// <summary>
+	/// The source image, or nullptr if it has been evicted. Resized images remain valid after their source is evicted.
+	/// </summary>
+	std::shared_ptr<const IImageSource> SourceImage;
+
+	/// <summary>
+	/// Dimensions of the source image, or 0 if the entry was created for a resized image without its source ever being added.
+	/// </summary>
+	int SourceWidth;
+	int SourceHeight;
+
+	/// <summary>
+	/// Measured time it took to decode the source image.
+	/// </summary>
+	std::chrono::microseconds SourceCreationCost{ 0 };
+
+	/// <summary>
+	/// Copies of the source image at successively halved dimensions, largest first. Empty unless the cache generates mipmaps.
+	/// These are derived from the source image, and are evicted along with it.
+	/// </summary>
+	std::vector<std::shared_ptr<const IImageSource>> MipLevels;
+
+	/// <summary>
+	/// Offset in the cache's spill file of the source image's pixels, or -1 if the source image has not been spilled.
+	/// </summary>
+	int64_t SpilledSourceOffset = -1;
+	uint64_t SpilledSourceLength = 0;
+
+	/// <summary>
+	/// The encoded file contents the source image was decoded from, or nullptr if they are not kept. These outlive the source image,
+	/// so that it can be decoded again without reading the file.
+	/// </summary>
+	std::shared_ptr<const std::vector<unsigned char>> EncodedBytes;
+
+	/// <summary>
+	/// Priority of the source image for the cache's <see cref="EvictionPolicy"/>, the lowest priority is evicted first.
+	/// </summary>
+	double SourceEvictionPriority = 0.0;
+
+	/// <summary>
+	/// The priority the entry is ordered by in the cache's eviction indexes, which lags <see cref="SourceEvictionPriority"/> until
+	/// the entry is indexed again.
+	/// </summary>
+	double IndexedEvictionPriority = 0.0;
+
+	/// <summary>
+	/// True if the source image is pinned, in which case it is never evicted.
+	/// </summary>
+	bool IsSourcePinned = false;
+
+	/// <summary>
+	/// The namespace the source image, its mipmap levels and its encoded contents are accounted to, or nullptr for the default
+	/// namespace. This is the namespace that created the entry, resized images are accounted to the namespace that added them.
+	/// </summary>
+	CacheNamespace* Namespace = nullptr;
+
+	/// <summary>
+	/// Number of times the entry has been requested from the cache.
+	/// </summary>
+	uint32_t AccessCount = 0;
+
+	/// <summary>
+	/// When the entry was created or last requested from the cache, see <see cref="ImageCache::SetIdleTimeout"/>.
+	/// </summary>
+	std::chrono::steady_clock::time_point LastAccessTime = std::chrono::steady_clock::now();
 
 	std::map<const std::string, ImageCacheItem<TImage>*> ResizedImages;
 
-	ImageCacheEntry(const IImageSource* sourceImage)
-		: ImagePath(sourceImage->GetImagePath())
-		, SourceImage(sourceImage)
+	/// <summary>
+	/// True if the entry was placed in the admission window of the cache's admission filter, rather than the main region.
+	/// </summary>
+	bool InAdmissionWindow = false;
+
+	/// <summary>
+	/// Order of the entry's last request among the entries in the admission window, the least recently requested entry leaves the
+	/// window first.
+	/// </summary>
+	uint64_t AdmissionWindowSequence = 0;
+
+	/// <summary>
+	/// Number of bytes accounted to this entry by the cache.
+	/// </summary>
+	int64_t SizeInBytes = 0;
+
+	/// <summary>
+	/// Estimated number of bytes of bookkeeping the cache holds for this entry, its resized images, path aliases and content key,
+	/// in addition to their pixel data.
+	/// </summary>
+	int64_t MetadataSizeInBytes = 0;
+
+	/// <summary>
+	/// Hash of the file contents the source image was decoded from, or 0 if it is not known or another entry was added first with
+	/// the same hash.
+	/// </summary>
+	uint64_t ContentHash = 0;
+
+	/// <summary>
+	/// Size of the file contents the source image was decoded from, or 0 if it is not known.
+	/// </summary>
+	uint64_t ContentSize = 0;
+
+	/// <summary>
+	/// Paths of byte identical files that resolve to this entry instead of having entries of their own.
+	/// </summary>
+	std::vector<std::string> PathAliases;
+
+	/// <param name="id">Handle of the path of the entry, whose reference is released when the entry is destroyed.</param>
+	/// <param name="sourceImage">The source image.</param>
+	ImageCacheEntry(const ImageId id, std::shared_ptr<const IImageSource> sourceImage)
+		: Id(id)
+		, SourceImage(std::move(sourceImage))
+		, SourceWidth(SourceImage->GetWidth())
+		, SourceHeight(SourceImage->GetHeight())
+	{
+		static_assert(std::is_convertible_v<TImage*, IImage*>, "TImage type must inherit from IImage.");
+	}
+
+	/// <summary>
+	/// Constructs an entry without a source image, for a resized image that was created without decoding the source.
+	/// </summary>
+	/// <param name="id">Handle of the path of the entry, whose reference is released when the entry is destroyed.</param>
+	ImageCacheEntry(const ImageId id)
+		: Id(id)
+		, SourceWidth(0)
+		, SourceHeight(0)
 	{
 		static_assert(std::is_convertible_v<TImage*, IImage*>, "TImage type must inherit from IImage.");
 	}
 
+	[[nodiscard]]
+	const std::filesystem::path& GetImagePath() const
+	{
+		return ImagePathTable::GetShared().GetPath(Id);
+	}
+
 	~ImageCacheEntry()
 	{
 		for (const auto& entry : ResizedImages)
 			delete entry.second;
 
 		ResizedImages.clear();
-
-		delete SourceImage;
+		ImagePathTable::GetShared().Release(Id);
 	}
 
 	ImageCacheItem<TImage>* TryGetResizedImageCacheItem(const int width, const int height)
@@ -82,19 +346,58 @@ struct ImageCacheEntry final
 		return nullptr;
 	}
 
-	unsigned int GetTotalSizeInBytes()
+	/// <summary>
+	/// Gets the number of bytes accounted to this entry for the source image and its mipmap levels.
+	/// </summary>
+	int64_t GetSourceSizeInBytes() const
 	{
-		unsigned int result = SourceImage->GetSizeInBytes();
+		if (!SourceImage)
+			return 0;
+
+		int64_t result = SourceImage->GetSizeInBytes();
+		for (const auto& mipLevel : MipLevels)
+			result += mipLevel->GetSizeInBytes();
 
-		if (ResizedImages)
+		return result;
+	}
+
+	/// <summary>
+	/// Gets the smallest of the source image and its mipmap levels that is at least the specified size in both dimensions, to resize
+	/// from. Returns the source image if no mipmap level is large enough.
+	/// </summary>
+	const std::shared_ptr<const IImageSource>& GetResizeSource(const unsigned int width, const unsigned int height) const
+	{
+		for (auto mipLevel = MipLevels.rbegin(); mipLevel != MipLevels.rend(); ++mipLevel)
 		{
-			for (auto resizedEntry : *ResizedImages)
-			{
-				result += resizedEntry.second->Image->GetSizeInBytes();
-			}
+			if ((*mipLevel)->GetWidth() >= static_cast<int>(width) && (*mipLevel)->GetHeight() >= static_cast<int>(height))
+				return *mipLevel;
 		}
 
-		return result;
+		return SourceImage;
+	}
+
+	/// <summary>
+	/// Gets whether the source image was evicted to the cache's spill file, from which it can be restored without being decoded.
+	/// </summary>
+	bool IsSourceSpilled() const
+	{
+		return SpilledSourceOffset >= 0;
+	}
+
+	/// <summary>
+	/// Gets whether the entry holds nothing that could be returned by the cache, and can be removed.
+	/// </summary>
+	bool IsEmpty() const
+	{
+		return !SourceImage && ResizedImages.empty() && !IsSourceSpilled() && !EncodedBytes;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes accounted to this entry by the cache, for the source image and all resized images.
+	/// </summary>
+	int64_t GetTotalSizeInBytes() const
+	{
+		return SizeInBytes;
 	}
 };
 
@@ -105,10 +408,150 @@ struct ImageCacheEntry final
 template<typename TImage>
 class ImageCache final : public ImageCaching::IImageCache<TImage>
 {
+	/// <summary>
+	/// Kinds of cached data that <see cref="TryEvictLowestPriority"/> may evict, combined as flags.
+	/// </summary>
+	enum EvictionCandidates
+	{
+		RetainedImages = 1,
+		SourceImages = 2,
+		EncodedBytes = 4,
+
+		/// <summary>
+		/// Only evict from what is accounted to the namespace room is made for.
+		/// </summary>
+		RequestingNamespaceOnly = 8,
+
+		/// <summary>
+		/// Do not evict from other namespaces below their guaranteed minimum memory.
+		/// </summary>
+		NamespaceMinimums = 16
+	};
+
 	int64_t _maxAllowedMemory;
 	int64_t _currentMemoryUsage = 0;
+	int64_t _maxSourceMemory = std::numeric_limits<int64_t>::max();
+	int64_t _sourceMemoryUsage = 0;
+	int64_t _maxResizedMemory = std::numeric_limits<int64_t>::max();
+	int64_t _resizedMemoryUsage = 0;
+	int64_t _metadataMemoryUsage = 0;
+	int64_t _admissionWindowMemoryUsage = 0;
+
+	/// <summary>
+	/// The entries in the admission window, ordered from the least recently requested.
+	/// </summary>
+	std::set<std::pair<uint64_t, ImageCacheEntry<TImage>*>> _admissionWindowIndex;
+	uint64_t _admissionWindowSequence = 0;
+	int64_t _maxRetainedMemory = 0;
+	int64_t _retainedMemoryUsage = 0;
+	int64_t _maxPinnedMemory = 0;
+	int64_t _pinnedMemoryUsage = 0;
+	int64_t _maxEncodedMemory = 0;
+	int64_t _encodedMemoryUsage = 0;
+	bool _evictSourceOnceResized = false;
+	double _evictSourceMinimumCopyArea = 0.5;
+	std::atomic<bool> _generateMipmaps = false;
+	std::atomic<bool> _useThreadLocalLookup = false;
+	bool _canonicalizePaths = false;
+	mutable PathCanonicalizer _pathCanonicalizer;
+	double _sizeTolerance = 0.0;
 	std::recursive_mutex _cacheLock;
 	std::map<const std::string, ImageCacheEntry<TImage>*> _images;
+	std::map<uint64_t, std::string> _contentKeys;
+	std::map<const std::string, std::string> _pathAliases;
+	std::map<const std::string, CacheNamespace> _namespaces;
+	TinyLfuAdmissionFilter* _admissionFilter = nullptr;
+	SpillFile* _spillFile = nullptr;
+	ImageCaching::ISourceImageStore* _sourceImageStore = nullptr;
+	std::chrono::microseconds _minimumSpillCreationCost{ 0 };
+
+	/// <summary>
+	/// The evictable source images, spilled sources, encoded contents and retained images, ordered by eviction priority so that an
+	/// eviction takes the lowest from the front instead of scanning every entry. Kept up to date by <see cref="ReindexEntry"/> and
+	/// <see cref="ReindexItem"/>.
+	/// </summary>
+	std::set<std::pair<double, ImageCacheEntry<TImage>*>> _sourceIndex;
+	std::set<std::pair<double, ImageCacheEntry<TImage>*>> _spilledIndex;
+	std::set<std::pair<double, ImageCacheEntry<TImage>*>> _encodedIndex;
+	std::set<std::tuple<double, ImageCacheItem<TImage>*, ImageCacheEntry<TImage>*>> _retainedIndex;
+	std::chrono::milliseconds _idleTimeout{ 0 };
+	std::string _trimCursor;
+	EvictionPriorityCalculator _evictionPriority;
+
+	/// <summary>
+	/// Computes the priorities of resized images when their policy differs from that of source images, in which case the priorities
+	/// of the two tiers are not comparable.
+	/// </summary>
+	EvictionPriorityCalculator _resizedEvictionPriority;
+	bool _hasResizedEvictionPolicy = false;
+
+	std::map<uint64_t, std::function<void(const std::vector<CacheRemoval>&)>> _removalSubscribers;
+	uint64_t _nextSubscriptionId = 1;
+	std::vector<CacheRemoval> _pendingRemovals;
+	std::atomic<bool> _hasPendingRemovals = false;
+
+	/// <summary>
+	/// Number of nested <see cref="RemovalNotificationScope"/> instances of a cache on the calling thread, and the reason of the
+	/// outermost one.
+	/// </summary>
+	struct RemovalScopeState
+	{
+		int Depth = 0;
+		CacheRemovalReason Reason = CacheRemovalReason::Evicted;
+	};
+
+	/// <summary>
+	/// Gets the open removal scopes of the calling thread, keyed by cache. A cache's members can remove images of another cache, e.g.
+	/// through a removal subscriber, whose removals must be reported when that cache's own outermost scope ends.
+	/// </summary>
+	static std::map<const ImageCache*, RemovalScopeState>& GetRemovalScopes()
+	{
+		thread_local std::map<const ImageCache*, RemovalScopeState> removalScopes;
+		return removalScopes;
+	}
+
+	/// <summary>
+	/// Gets the reason of the calling thread's outermost removal scope of this cache.
+	/// </summary>
+	[[nodiscard]]
+	CacheRemovalReason GetRemovalReason() const
+	{
+		const auto& removalScopes = GetRemovalScopes();
+		const auto search = removalScopes.find(this);
+		return search != removalScopes.end() ? search->second.Reason : CacheRemovalReason::Evicted;
+	}
+
+	/// <summary>
+	/// Declared before the cache lock by the public members that can remove images, so that removals queued while the lock is held
+	/// are reported once the outermost of them has released it.
+	/// </summary>
+	class RemovalNotificationScope final
+	{
+		ImageCache& _cache;
+
+	public:
+		RemovalNotificationScope(ImageCache& cache, const CacheRemovalReason reason = CacheRemovalReason::Evicted)
+			: _cache(cache)
+		{
+			auto& state = GetRemovalScopes()[&cache];
+			if (state.Depth++ == 0)
+				state.Reason = reason;
+		}
+
+		~RemovalNotificationScope()
+		{
+			auto& removalScopes = GetRemovalScopes();
+			const auto state = removalScopes.find(&_cache);
+			if (--state->second.Depth > 0)
+				return;
+
+			removalScopes.erase(state);
+			_cache.NotifyRemovals();
+		}
+
+		RemovalNotificationScope(const RemovalNotificationScope&) = delete;
+		RemovalNotificationScope& operator=(const RemovalNotificationScope&) = delete;
+	};
 
 public:
 	ImageCache(const int64_t maximumMemoryInBytes)
@@ -117,84 +560,1018 @@ public:
 		SetMaxMemory(maximumMemoryInBytes);
 	}
 
-	size_t GetCacheEntryCount()
+	~ImageCache()
 	{
-		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
-		return _images.size();
-	}
+		//another cache may be constructed at the same address, which must not find the images of this one.
+		ThreadLocalImageLookup<TImage>::Invalidate();
 
-	int64_t GetCurrentMemoryUsage() const
-	{
-		return _currentMemoryUsage;
+		//deleting the entries deletes the images they retain.
+		for (const auto& image : _images)
+			delete image.second;
+
+		delete _admissionFilter;
+		delete _spillFile;
 	}
 
 	/// <summary>
-	/// Sets the maximum memory in bytes that the cache is allowed to use. 
+	/// Enables a frequency based admission filter in front of <see cref="TryAddSourceImage"/> and <see cref="TryAddImage"/>. New
+	/// images are admitted into the filter's admission window, and the least recently requested images leave it to make room. Once
+	/// the cache is full, an image leaving the window is only kept if it was requested more often than the image the cache would
+	/// evict next, and an image too large for the window is returned to the caller uncached with
+	/// <see cref="ImageCaching::TryAddImageResult::NotAdmitted"/> unless it was.
 	/// </summary>
-	/// <param name="maximumMemoryInBytes"></param>
-	virtual void SetMaxMemory(int64_t maximumMemoryInBytes) override;
+	/// <param name="settings">Settings for the admission filter.</param>
+	void EnableAdmissionFilter(const AdmissionFilterSettings& settings);
 
 	/// <summary>
-	/// Gets the maximum memory in bytes that the cache is allowed to use.
+	/// Disables the admission filter, so that every image is admitted while there is memory available.
 	/// </summary>
-	virtual int64_t GetMaxMemory() const override {
-		return _maxAllowedMemory;
+	void DisableAdmissionFilter();
+
+	/// <summary>
+	/// Sets the policy used to evict source images when memory is needed for a new image, or when the maximum memory is reduced.
+	/// Resized images are never evicted while they are referenced. The default policy is <see cref="EvictionPolicy::NeverEvict"/>.
+	/// </summary>
+	/// <param name="policy">The eviction policy.</param>
+	void SetEvictionPolicy(const EvictionPolicy policy)
+	{
+		SetEvictionPolicy(policy, policy);
 	}
 
 	/// <summary>
-	/// Attempts to get the image identified by the specified path.
+	/// Sets separate eviction policies for the source tier and the resized tier, which typically have very different reuse patterns.
+	/// The resized policy orders the eviction of retained images, resized images are never evicted while they are referenced. When
+	/// the policies differ their priorities are not comparable, and memory needed for a new image is taken from source images before
+	/// retained images.
 	/// </summary>
-	/// <param name="imagePath">Source path of the image.</param>
-	/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
-	/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
-	/// <returns>Result of the operation</returns>
-	virtual ImageCaching::TryGetImageResult TryGetImage(const std::filesystem::path& imagePath,
-		std::shared_ptr<const TImage>& outImage,
-		const IImageSource*& outSourceImage) override;
+	/// <param name="sourcePolicy">The eviction policy for source images.</param>
+	/// <param name="resizedPolicy">The eviction policy for retained resized images.</param>
+	void SetEvictionPolicy(EvictionPolicy sourcePolicy, EvictionPolicy resizedPolicy);
 
 	/// <summary>
-	/// Attempts to get the image identified by the specified path, with the specified width and height in pixels.
+	/// Gets the policy used to evict source images.
 	/// </summary>
-	/// <param name="imagePath">Source path of the image.</param>
-	/// <param name="width">The width in pixels of the image to be retrieved.</returns>
-	/// <param name="height">The height in pixels of the image to be retrieved.</returns>
-	/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
-	/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
-	/// <returns>Result of the operation</returns>
-	virtual ImageCaching::TryGetImageResult TryGetImageAtSize(const std::filesystem::path& imagePath,
-		unsigned int width, unsigned int height,
-		std::shared_ptr<const TImage>& outImage,
-		const IImageSource*& outSourceImage) override;
+	EvictionPolicy GetEvictionPolicy() const {
+		return _evictionPriority.GetPolicy();
+	}
 
 	/// <summary>
-	/// Adds the image to the cache, unless the image already exists in the cache at the image's path.
-	/// If there is already an image in the cache for the image's path, outImage will be the instance that that was in the cache.
+	/// Gets the policy used to evict retained resized images.
 	/// </summary>
-	/// <param name="image">The image to add into the cache.</param>
-	/// <param name="outImage">If a different instance already exists in the cache at the image's path, this will be set to that instance.
-	/// Otherwise is nullptr.</param>
-	/// <returns>Result of the operation</returns>
-	virtual ImageCaching::TryAddImageResult TryAddImage(std::shared_ptr<const TImage> image, const TImage*& outImage) override;
+	EvictionPolicy GetResizedEvictionPolicy() const {
+		return GetResizedEvictionPriority().GetPolicy();
+	}
 
 	/// <summary>
-	/// Adds the source image containing the pixel data of the source file to the cache, unless the source image already 
-	/// exists in the cache.
+	/// Sets the maximum number of bytes of source images and their mipmap levels, within the cache's maximum memory, so that source
+	/// images cannot push resized images out of the cache. Source images are evicted by the source eviction policy when this budget
+	/// is exceeded. The default is no limit other than the maximum memory.
 	/// </summary>
-	/// <param name="image">The source image</param>
-	/// <returns>Result of the operation</returns>
-	virtual ImageCaching::TryAddImageResult TryAddSourceImage(const IImageSource* image) override;
+	/// <param name="maximumSourceMemoryInBytes">The source tier budget in bytes.</param>
+	void SetMaxSourceMemory(int64_t maximumSourceMemoryInBytes);
+
+	int64_t GetMaxSourceMemory() const {
+		return _maxSourceMemory;
+	}
 
 	/// <summary>
-	/// Tries to remove the provided image from the cache.
+	/// Gets the number of bytes of source images and their mipmap levels held by the cache.
 	/// </summary>
-	/// <param name="image">The image to remove.</param>
-	/// <returns>True if the image was removed, false if the image was not found in the cache.</returns>
-	virtual bool TryRemoveImage(const TImage* image) override;
+	int64_t GetSourceMemoryUsage() const {
+		return _sourceMemoryUsage;
+	}
 
-private:
+	/// <summary>
+	/// Sets the maximum number of bytes of resized images, referenced or retained, within the cache's maximum memory. Retained images
+	/// are evicted by the resized eviction policy when this budget is exceeded. Adding a resized image fails with OutOfMemory if the
+	/// budget is taken up by referenced images. The default is no limit other than the maximum memory.
+	/// </summary>
+	/// <param name="maximumResizedMemoryInBytes">The resized tier budget in bytes.</param>
+	void SetMaxResizedMemory(int64_t maximumResizedMemoryInBytes);
+
+	int64_t GetMaxResizedMemory() const {
+		return _maxResizedMemory;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of resized images, referenced or retained, held by the cache.
+	/// </summary>
+	int64_t GetResizedMemoryUsage() const {
+		return _resizedMemoryUsage;
+	}
+
+	/// <summary>
+	/// Sets the maximum number of bytes of resized images the cache retains after their last shared pointer has been released.
+	/// Retained images are returned by later requests without being re-created, and are evicted when this budget is exceeded or
+	/// when memory is needed for a new image. Retained images count towards the cache's memory usage. The default is 0, which
+	/// deletes images as soon as they are released.
+	/// </summary>
+	/// <param name="maximumRetainedMemoryInBytes">The retention budget in bytes.</param>
+	void SetMaxRetainedMemory(int64_t maximumRetainedMemoryInBytes);
+
+	/// <summary>
+	/// Gets the maximum number of bytes of released resized images the cache retains.
+	/// </summary>
+	int64_t GetMaxRetainedMemory() const {
+		return _maxRetainedMemory;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of released resized images currently retained by the cache.
+	/// </summary>
+	int64_t GetRetainedMemoryUsage() const {
+		return _retainedMemoryUsage;
+	}
+
+	/// <summary>
+	/// Sets whether the source image of an entry is evicted once a resized copy of it has been added that covers a minimum fraction
+	/// of the source's area. Smaller copies are then created from the nearest larger cached copy, and the source is only loaded
+	/// again for a size larger than every cached copy. A small thumbnail alone does not evict the source, so that a later request
+	/// for a larger size does not have to load it from disk again. Has no effect unless TImage satisfies <see cref="PixelReadableImage"/>.
+	/// </summary>
+	/// <param name="enabled">True to evict source images once resized.</param>
+	/// <param name="minimumCopyAreaFraction">Fraction of the source's area, from 0 to 1, a copy must cover for the source to be
+	/// evicted, 0 to evict the source once any copy exists.</param>
+	void SetEvictSourceOnceResized(const bool enabled, const double minimumCopyAreaFraction = 0.5)
+	{
+		if (minimumCopyAreaFraction < 0.0 || minimumCopyAreaFraction > 1.0)
+			throw std::runtime_error("The minimum copy area fraction must be from 0 to 1");
+
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		_evictSourceOnceResized = enabled;
+		_evictSourceMinimumCopyArea = minimumCopyAreaFraction;
+	}
+
+	/// <summary>
+	/// Sets whether a mipmap chain, each level half the dimensions of the previous one, is generated for each source image added to
+	/// the cache. Requests for a new size are then resized from the smallest level that is at least the requested size, which bounds
+	/// the cost of resizing for any size, at the cost of up to a third more memory per source image. Only affects source images
+	/// added after the setting is changed.
+	/// </summary>
+	/// <param name="enabled">True to generate mipmaps.</param>
+	void SetGenerateMipmaps(const bool enabled)
+	{
+		_generateMipmaps = enabled;
+	}
+
+	/// <summary>
+	/// Sets whether paths are canonicalized before they are used as keys, see <see cref="PathCanonicalizer"/>. Relative and absolute
+	/// paths, paths such as "a/../b.jpg", and paths through links to the same file then share one entry and one decode, at the cost
+	/// of querying the filesystem once for each new path. Must be set before images are added, entries that exist keep their keys.
+	/// </summary>
+	/// <param name="enabled">True to canonicalize paths.</param>
+	void SetCanonicalizePaths(const bool enabled)
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		_canonicalizePaths = enabled;
+	}
+
+	/// <summary>
+	/// Sets how long an entry may go without being requested before <see cref="TrimIdleEntries"/> frees what the cache holds for it:
+	/// its source image, encoded contents and released resized images. Images that are still referenced are kept. Requests answered
+	/// by the thread local lookup do not count as requests, but only ever return referenced images. Idle entries are only freed
+	/// when the cache is trimmed, e.g. by an <see cref="ImageCacheTrimmer"/>.
+	/// </summary>
+	/// <param name="timeout">The idle timeout, or 0 for entries to never expire.</param>
+	void SetIdleTimeout(const std::chrono::milliseconds timeout)
+	{
+		if (timeout.count() < 0)
+			throw std::runtime_error("Idle timeout must be positive");
+
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		_idleTimeout = timeout;
+	}
+
+	/// <summary>
+	/// Frees what the cache holds for the idle entries among the next entries after those visited by the previous call, wrapping
+	/// around to the first entry, see <see cref="SetIdleTimeout"/>. Visiting a few entries per call bounds how long the cache is locked
+	/// for, so that the cache can be trimmed incrementally without delaying requests.
+	/// </summary>
+	/// <param name="maxEntries">Maximum number of entries to visit.</param>
+	/// <returns>The number of bytes freed.</returns>
+	int64_t TrimIdleEntries(size_t maxEntries);
+
+	/// <summary>
+	/// Sets how far the dimensions of a cached image may differ from those requested by <see cref="TryGetImageAtSize"/> for it to be
+	/// returned as an exact match when there is no image at exactly the requested size. Near identical sizes, e.g. 255x143, 256x144
+	/// and 257x145, then share one cached image and one resize. The image closest to the requested size is returned, and its
+	/// dimensions are those it was created at rather than those requested.
+	/// </summary>
+	/// <param name="fraction">The largest difference per axis, as a fraction of the requested dimension, e.g. 0.02 for 2%. 0 to
+	/// only return images at exactly the requested size.</param>
+	void SetSizeTolerance(const double fraction)
+	{
+		if (fraction < 0.0 || fraction >= 1.0)
+			throw std::runtime_error("Size tolerance must be at least 0 and less than 1");
+
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		_sizeTolerance = fraction;
+	}
+
+	/// <summary>
+	/// Sets whether images found by the <see cref="ImageId"/> overloads of <see cref="TryGetImage"/> and
+	/// <see cref="TryGetImageAtSize"/> are remembered in a small table per thread, see <see cref="ThreadLocalImageLookup"/>. Repeated
+	/// requests for a referenced image by its handle are then answered without taking the cache's lock. Requests by path always take
+	/// the lock.
+	/// </summary>
+	/// <param name="enabled">True to use thread local lookups.</param>
+	void SetUseThreadLocalLookup(const bool enabled)
+	{
+		_useThreadLocalLookup = enabled;
+		ThreadLocalImageLookup<TImage>::Invalidate();
+	}
+
+	/// <summary>
+	/// Sets a store that holds the source images of this cache, so that they are shared with other caches, of any image type, that
+	/// use the same store. Source images are then added to and found in the store, under its budget, and no longer count towards this
+	/// cache's memory. The cache only holds resized images, so its mipmap, spill and encoded tiers apply to sources it held before the
+	/// store was set. The store is not owned by the cache, and must outlive it.
+	/// </summary>
+	/// <param name="store">The shared store, or nullptr for the cache to hold its own source images.</param>
+	void SetSourceImageStore(ImageCaching::ISourceImageStore* store)
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		_sourceImageStore = store;
+	}
+
+	/// <summary>
+	/// Subscribes to the images removed from the cache, e.g. to free copies of them held by dependent caches. Removals are reported
+	/// in a batch per operation of the cache, on the thread that performed it, once the cache's lock has been released. Source images,
+	/// resized images and encoded contents are reported as they are evicted, expire, are invalidated or are removed, followed by the
+	/// entry of each path that no longer has anything cached, but not when the cache is destroyed. The callback may use the cache,
+	/// and must not throw.
+	/// </summary>
+	/// <param name="onRemoved">Invoked with each batch of removals.</param>
+	/// <returns>The id of the subscription, to pass to <see cref="Unsubscribe"/>.</returns>
+	virtual uint64_t Subscribe(std::function<void(const std::vector<CacheRemoval>&)> onRemoved) override
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		const auto subscriptionId = _nextSubscriptionId++;
+		_removalSubscribers.emplace(subscriptionId, std::move(onRemoved));
+		return subscriptionId;
+	}
+
+	/// <summary>
+	/// Ends a subscription made with <see cref="Subscribe"/>. A batch that is being reported on another thread may still be reported
+	/// to it.
+	/// </summary>
+	/// <returns>True if the subscription existed.</returns>
+	virtual bool Unsubscribe(const uint64_t subscriptionId) override
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		return _removalSubscribers.erase(subscriptionId) > 0;
+	}
+
+	/// <summary>
+	/// Enables a spill tier between the cache's memory and eviction. A source image that would otherwise be dropped, because it is
+	/// evicted or because its last resized image was released, is written to a preallocated scratch file instead and its entry is
+	/// kept. The next request for the image reads the source back from the file rather than decoding it again. When the file is full
+	/// the spilled sources with the lowest eviction priority are dropped. Spilled sources do not count towards the cache's memory usage.
+	/// A std::runtime_error is thrown if the scratch file cannot be created, or the disk space for all of it cannot be reserved.
+	/// </summary>
+	/// <param name="filePath">Path of the scratch file, which is replaced if it exists.</param>
+	/// <param name="capacityInBytes">Size of the scratch file.</param>
+	/// <param name="minimumCreationCost">Only source images that took at least this long to decode are spilled, cheaper images are
+	/// dropped as before.</param>
+	void EnableSpillTier(const std::filesystem::path& filePath, uint64_t capacityInBytes,
+		std::chrono::microseconds minimumCreationCost = std::chrono::microseconds(0));
+
+	/// <summary>
+	/// Disables the spill tier, dropping all spilled source images.
+	/// </summary>
+	void DisableSpillTier();
+
+	/// <summary>
+	/// Gets the number of bytes of the spill file used by spilled source images, or 0 if the spill tier is disabled.
+	/// </summary>
+	uint64_t GetSpillUsage()
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		return _spillFile ? _spillFile->GetUsedSizeInBytes() : 0;
+	}
+
+	/// <summary>
+	/// Sets the maximum number of bytes of images that can be pinned with <see cref="Pin"/>. Pinned images count towards the cache's
+	/// memory usage, but not towards its retention budget. Reducing the budget does not unpin images that are already pinned. The
+	/// default is 0, which disables pinning.
+	/// </summary>
+	/// <param name="maximumPinnedMemoryInBytes">The budget for pinned images in bytes.</param>
+	void SetMaxPinnedMemory(int64_t maximumPinnedMemoryInBytes);
+
+	/// <summary>
+	/// Gets the maximum number of bytes of images that can be pinned.
+	/// </summary>
+	int64_t GetMaxPinnedMemory() const {
+		return _maxPinnedMemory;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of images currently pinned.
+	/// </summary>
+	int64_t GetPinnedMemoryUsage() const {
+		return _pinnedMemoryUsage;
+	}
+
+	/// <summary>
+	/// Gives a namespace of the cache its own memory budget, for caches that are shared by several subsystems. Images added with
+	/// <see cref="ImageCaching::CacheInsertInfo::Namespace"/> are accounted to their namespace, within the cache's maximum memory.
+	/// Adding an image that exceeds the namespace's maximum only evicts images of the same namespace, or fails with OutOfMemory. Images
+	/// of a namespace are not evicted to make room for other namespaces while its usage is within its guaranteed minimum, so a noisy
+	/// namespace cannot evict everything else. Source images are shared between namespaces, and accounted to the namespace that first
+	/// added them. The budget of a namespace can be changed, but not removed.
+	/// </summary>
+	/// <param name="cacheNamespace">The namespace, which must not be empty.</param>
+	/// <param name="minimumMemoryInBytes">The memory guaranteed to the namespace.</param>
+	/// <param name="maximumMemoryInBytes">The maximum memory of the namespace.</param>
+	void SetNamespaceBudget(const std::string& cacheNamespace, int64_t minimumMemoryInBytes, int64_t maximumMemoryInBytes);
+
+	/// <summary>
+	/// Gets the number of bytes accounted to a namespace, or 0 if it has no budget.
+	/// </summary>
+	int64_t GetNamespaceMemoryUsage(const std::string& cacheNamespace)
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		const auto search = _namespaces.find(cacheNamespace);
+		return search != _namespaces.end() ? search->second.MemoryUsage : 0;
+	}
+
+	/// <summary>
+	/// Sets the maximum number of bytes of encoded file contents the cache keeps, for source images added with
+	/// <see cref="ImageCaching::CacheInsertInfo::EncodedBytes"/>. Encoded contents are kept after their decoded source image is
+	/// evicted, so that it can be decoded again without reading the file, which is typically an order of magnitude smaller than the
+	/// decoded pixels. Encoded contents count towards the cache's memory usage, and are only evicted for memory once no decoded
+	/// source image can be, or when this budget is exceeded. The default is 0, which keeps no encoded contents.
+	/// </summary>
+	/// <param name="maximumEncodedMemoryInBytes">The budget for encoded file contents in bytes.</param>
+	void SetMaxEncodedMemory(int64_t maximumEncodedMemoryInBytes);
+
+	/// <summary>
+	/// Gets the maximum number of bytes of encoded file contents the cache keeps.
+	/// </summary>
+	int64_t GetMaxEncodedMemory() const {
+		return _maxEncodedMemory;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of encoded file contents currently kept by the cache.
+	/// </summary>
+	int64_t GetEncodedMemoryUsage() const {
+		return _encodedMemoryUsage;
+	}
+
+	/// <summary>
+	/// Gets the most frequently requested images in the cache at each size they are cached at, most frequent first, to be written
+	/// with <see cref="CacheSnapshot::TrySave"/> and used to warm up the cache of a later run.
+	/// </summary>
+	/// <param name="maxCount">Maximum number of images to return.</param>
+	std::vector<CacheSnapshotEntry> GetHotImages(size_t maxCount);
+
+	/// <summary>
+	/// Writes a snapshot of the most frequently requested images in the cache, e.g. on shutdown or periodically.
+	/// </summary>
+	/// <param name="filePath">Path of the snapshot file.</param>
+	/// <param name="maxCount">Maximum number of images written to the snapshot.</param>
+	/// <returns>True if the snapshot was written.</returns>
+	bool SaveSnapshot(const std::filesystem::path& filePath, const size_t maxCount)
+	{
+		return CacheSnapshot::TrySave(filePath, GetHotImages(maxCount));
+	}
+
+	size_t GetCacheEntryCount()
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		return _images.size();
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of image data held by the cache, i.e. pixels and encoded file contents.
+	/// </summary>
+	int64_t GetCurrentMemoryUsage() const
+	{
+		return _currentMemoryUsage;
+	}
+
+	/// <summary>
+	/// Gets the estimated number of bytes of bookkeeping held by the cache for its entries, i.e. map nodes, keys, paths and item
+	/// allocations. With many small images this is a significant part of the cache's footprint.
+	/// </summary>
+	int64_t GetMetadataMemoryUsage() const
+	{
+		return _metadataMemoryUsage;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of image data and bookkeeping held by the cache, which is what the maximum memory bounds.
+	/// </summary>
+	int64_t GetTotalMemoryUsage() const
+	{
+		return _currentMemoryUsage + _metadataMemoryUsage;
+	}
+
+	/// <summary>
+	/// Sets the maximum memory in bytes that the cache is allowed to use, including the estimated bookkeeping of its entries.
+	/// </summary>
+	/// <param name="maximumMemoryInBytes"></param>
+	virtual void SetMaxMemory(int64_t maximumMemoryInBytes) override;
+
+	/// <summary>
+	/// Gets the maximum memory in bytes that the cache is allowed to use.
+	/// </summary>
+	virtual int64_t GetMaxMemory() const override {
+		return _maxAllowedMemory;
+	}
+
+	/// <summary>
+	/// Attempts to get the image identified by the specified path.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
+	/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryGetImageResult TryGetImage(const std::filesystem::path& imagePath,
+		std::shared_ptr<const TImage>& outImage,
+		std::shared_ptr<const IImageSource>& outSourceImage) override;
+
+	/// <summary>
+	/// Attempts to get the image identified by the specified path, with the specified width and height in pixels.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="width">The width in pixels of the image to be retrieved.</returns>
+	/// <param name="height">The height in pixels of the image to be retrieved.</returns>
+	/// <param name="outImage">The image instance if type TImage retrieved from the cache or loaded from the path.</param>
+	/// <param name="outSourceImage">The source image instance retrieved from the cache or loaded from the path.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryGetImageResult TryGetImageAtSize(const std::filesystem::path& imagePath,
+		unsigned int width, unsigned int height,
+		std::shared_ptr<const TImage>& outImage,
+		std::shared_ptr<const IImageSource>& outSourceImage) override;
+
+	/// <summary>
+	/// Attempts to get the image identified by the handle of its interned path, see <see cref="ImagePathTable"/>. This is
+	/// <see cref="TryGetImage"/> without copying the path or converting it to a key.
+	/// </summary>
+	/// <param name="imageId">Handle of the source path of the image.</param>
+	/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+	/// <param name="outSourceImage">The source image instance retrieved from the cache.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryGetImageResult TryGetImage(const ImageId imageId,
+		std::shared_ptr<const TImage>& outImage,
+		std::shared_ptr<const IImageSource>& outSourceImage) override
+	{
+		const auto& pathTable = ImagePathTable::GetShared();
+		return TryGetImage(pathTable.GetPath(imageId), pathTable.GetKey(imageId), imageId, outImage, outSourceImage);
+	}
+
+	/// <summary>
+	/// Attempts to get the image identified by the handle of its interned path at the specified size, see <see cref="ImagePathTable"/>.
+	/// This is <see cref="TryGetImageAtSize"/> without copying the path or converting it to a key.
+	/// </summary>
+	/// <param name="imageId">Handle of the source path of the image.</param>
+	/// <param name="width">The width in pixels of the image to be retrieved.</returns>
+	/// <param name="height">The height in pixels of the image to be retrieved.</returns>
+	/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+	/// <param name="outSourceImage">The source image instance retrieved from the cache.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryGetImageResult TryGetImageAtSize(const ImageId imageId,
+		const unsigned int width, const unsigned int height,
+		std::shared_ptr<const TImage>& outImage,
+		std::shared_ptr<const IImageSource>& outSourceImage) override
+	{
+		const auto& pathTable = ImagePathTable::GetShared();
+		return TryGetImageAtSize(pathTable.GetPath(imageId), pathTable.GetKey(imageId), imageId, width, height, outImage,
+			outSourceImage);
+	}
+
+	/// <summary>
+	/// Attempts to get an image whose file contents are identical to the file at the specified path, by the hash of those contents.
+	/// If a cache entry was added for a different path with the same content hash, its contents are compared with those of the
+	/// file, from its kept encoded contents or else by reading its file, and only if they are identical does the specified path
+	/// become an alias of that entry so that both paths share its source image and resized images.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="contentHash">Hash of the encoded contents of the file at the path.</param>
+	/// <param name="encodedBytes">The encoded contents of the file at the path.</param>
+	/// <param name="width">The width in pixels of the image to be retrieved, or 0 together with height for the source dimensions.</param>
+	/// <param name="height">The height in pixels of the image to be retrieved, or 0 together with width for the source dimensions.</param>
+	/// <param name="outImage">The image instance if type TImage retrieved from the cache.</param>
+	/// <param name="outSourceImage">The source image instance retrieved from the cache.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryGetImageResult TryGetImageByContent(const std::filesystem::path& imagePath,
+		uint64_t contentHash,
+		const std::vector<unsigned char>& encodedBytes,
+		unsigned int width, unsigned int height,
+		std::shared_ptr<const TImage>& outImage,
+		std::shared_ptr<const IImageSource>& outSourceImage) override;
+
+	/// <summary>
+	/// Attempts to get the encoded file contents that the source image at the specified path was decoded from. These are only kept
+	/// if a budget was set with <see cref="SetMaxEncodedMemory"/>.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="outEncodedBytes">The encoded file contents, or nullptr if they are not cached.</param>
+	/// <returns>True if the encoded file contents were found.</returns>
+	virtual bool TryGetEncodedImage(const std::filesystem::path& imagePath,
+		std::shared_ptr<const std::vector<unsigned char>>& outEncodedBytes) override;
+
+	/// <summary>
+	/// Pins the cached image at the specified size, so that it is never evicted whatever the eviction policy, and is kept by the
+	/// cache after its last reference is released. Pinned images are accounted against <see cref="SetMaxPinnedMemory"/>.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="width">The width in pixels of the image to pin, or 0 together with height to pin the source image.</param>
+	/// <param name="height">The height in pixels of the image to pin, or 0 together with width to pin the source image.</param>
+	/// <returns>True if the image is pinned, false if it is not cached or pinning it would exceed the budget for pinned bytes.</returns>
+	virtual bool Pin(const std::filesystem::path& imagePath, unsigned int width, unsigned int height) override;
+
+	/// <summary>
+	/// Unpins an image pinned with <see cref="Pin"/>, so that it is evicted by the eviction policy again. A released resized image
+	/// is then retained within the retention budget, or deleted if it does not fit.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <param name="width">The width in pixels of the image to unpin, or 0 together with height to unpin the source image.</param>
+	/// <param name="height">The height in pixels of the image to unpin, or 0 together with width to unpin the source image.</param>
+	/// <returns>True if the image was pinned.</returns>
+	virtual bool Unpin(const std::filesystem::path& imagePath, unsigned int width, unsigned int height) override;
+
+	/// <summary>
+	/// Adds the image to the cache, unless the image already exists in the cache at the image's path.
+	/// If there is already an image in the cache for the image's path, outImage will be the instance that that was in the cache.
+	/// If the cache has no entry for the image's path, an entry without a source image is created for it, as for an image created
+	/// from data that did not require the source image to be loaded.
+	/// </summary>
+	/// <param name="image">The image to add into the cache.</param>
+	/// <param name="insertInfo">Information about how the image was created.</param>
+	/// <param name="outImage">If a different instance already exists in the cache at the image's path, this will be set to that instance.
+	/// Otherwise is nullptr.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryAddImageResult TryAddImage(std::shared_ptr<const TImage> image, const ImageCaching::CacheInsertInfo& insertInfo,
+		const TImage*& outImage) override;
+
+	/// <summary>
+	/// Adds the source image containing the pixel data of the source file to the cache, unless the source image already 
+	/// exists in the cache. If the cache already has an entry for the image whose source image was evicted, the provided source
+	/// image is restored into that entry.
+	/// </summary>
+	/// <param name="image">The source image</param>
+	/// <param name="insertInfo">Information about how the source image was created.</param>
+	/// <returns>Result of the operation</returns>
+	virtual ImageCaching::TryAddImageResult TryAddSourceImage(std::shared_ptr<const IImageSource> image,
+		const ImageCaching::CacheInsertInfo& insertInfo) override;
+
+	/// <summary>
+	/// Discards everything cached for the image at the path, because the file at the path has changed. Instances of the image that
+	/// are still referenced remain valid, but are no longer returned by the cache. If the path is an alias of an entry for a byte
+	/// identical file, only the alias is removed.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	/// <returns>True if anything was cached for the path.</returns>
+	virtual bool TryInvalidateImage(const std::filesystem::path& imagePath) override;
+
+	/// <summary>
+	/// Gets whether anything is cached for the image at the path, either in its own entry or as an alias of another entry. Does not
+	/// count as an access of the image.
+	/// </summary>
+	/// <param name="imagePath">Source path of the image.</param>
+	virtual bool ContainsImage(const std::filesystem::path& imagePath) override;
+
+	/// <summary>
+	/// Tries to remove the provided image from the cache.
+	/// </summary>
+	/// <param name="image">The image to remove.</param>
+	/// <returns>True if the image was removed, false if the image was not found in the cache.</returns>
+	virtual bool TryRemoveImage(const TImage* image) override;
+
+private:
+	/// <summary>
+	/// Estimated heap overhead of a std::map node beyond its key and value, for its links and colour and the allocator's header.
+	/// </summary>
+	static constexpr int64_t MapNodeOverhead = 4 * sizeof(void*) + 16;
+
+	/// <summary>
+	/// Gets the estimated bookkeeping of an entry, for its node in the map of entries, its key and path, and the entry itself.
+	/// </summary>
+	static int64_t GetEntryMetadataSize(const std::string& key)
+	{
+		return MapNodeOverhead + sizeof(std::string) + sizeof(ImageCacheEntry<TImage>) + sizeof(ImageSource)
+			+ static_cast<int64_t>(key.size()) * 2;
+	}
+
+	/// <summary>
+	/// Gets the estimated bookkeeping of a resized image, for its node in its entry's map, its key, the item and the image instance.
+	/// </summary>
+	static int64_t GetItemMetadataSize(const std::string& resizedImageKey)
+	{
+		return MapNodeOverhead + sizeof(std::string) + sizeof(ImageCacheItem<TImage>) + sizeof(TImage)
+			+ static_cast<int64_t>(resizedImageKey.size());
+	}
+
+	/// <summary>
+	/// Gets the estimated bookkeeping of a path alias, for its node in the map of aliases and its copy in the entry's list of aliases.
+	/// </summary>
+	static int64_t GetAliasMetadataSize(const std::string& path, const std::string& key)
+	{
+		return MapNodeOverhead + sizeof(std::string) * 3 + static_cast<int64_t>(path.size()) * 2 + static_cast<int64_t>(key.size());
+	}
+
+	/// <summary>
+	/// Gets the estimated bookkeeping of a content key, for its node in the map of content keys.
+	/// </summary>
+	static int64_t GetContentKeyMetadataSize(const std::string& key)
+	{
+		return MapNodeOverhead + sizeof(uint64_t) + sizeof(std::string) + static_cast<int64_t>(key.size());
+	}
+
+	/// <summary>
+	/// Adds to, or with a negative size removes from, the bookkeeping accounted to an entry.
+	/// </summary>
+	void AccountMetadata(ImageCacheEntry<TImage>* cacheEntry, const int64_t sizeInBytes)
+	{
+		cacheEntry->MetadataSizeInBytes += sizeInBytes;
+		_metadataMemoryUsage += sizeInBytes;
+	}
+
+	/// <summary>
+	/// Gets the key of the path, which is its canonical key if paths are canonicalized, otherwise the path itself.
+	/// </summary>
+	std::string GetPathKey(const std::filesystem::path& imagePath) const
+	{
+		return _canonicalizePaths ? _pathCanonicalizer.GetKey(imagePath) : imagePath.string();
+	}
+
+	/// <summary>
+	/// Gets the key of the cache entry for the path, which is the key of another path's entry if the path is an alias of it.
+	/// </summary>
+	std::string ResolveKey(const std::filesystem::path& imagePath) const
+	{
+		return ResolveKey(imagePath, imagePath.string());
+	}
+
+	/// <summary>
+	/// Gets the key of the cache entry for the path, given the path as a string so that it is not converted again.
+	/// </summary>
+	std::string ResolveKey(const std::filesystem::path& imagePath, const std::string& pathString) const;
+
+	/// <summary>
+	/// Makes the path an alias of the entry, so that requests for the path resolve to it.
+	/// </summary>
+	void AddPathAlias(const std::string& path, const std::string& key, ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Applies the admission filter, if enabled, to an image about to be added to the cache. An image that fits in the admission
+	/// window is admitted into it, and the least recently requested entries leave the window until it has room again, see
+	/// <see cref="EvictFromAdmissionWindow"/>. An image larger than the window competes for the main region directly.
+	/// </summary>
+	/// <param name="key">Key of the image's cache entry.</param>
+	/// <param name="cacheEntry">The existing cache entry for the image, or nullptr if the image is a source image without an entry.</param>
+	/// <param name="sizeInBytes">Size of the image being added.</param>
+	/// <param name="outInAdmissionWindow">Set to true if the image was admitted into the admission window.</param>
+	/// <returns>False if the image should not be added to the cache.</returns>
+	bool TryAdmit(const std::string& key, ImageCacheEntry<TImage>* cacheEntry, int64_t sizeInBytes, bool& outInAdmissionWindow);
+
+	/// <summary>
+	/// Moves the least recently requested entry out of the admission window. It joins the main region if that has room for the image
+	/// being added, or if it was requested more often than the entry the main region would evict next, and is evicted otherwise.
+	/// </summary>
+	/// <param name="excludedEntry">The entry of the image being added, which is not moved.</param>
+	/// <param name="sizeInBytes">Size of the image being added.</param>
+	/// <returns>False if there is no entry to move.</returns>
+	bool EvictFromAdmissionWindow(const ImageCacheEntry<TImage>* excludedEntry, int64_t sizeInBytes);
+
+	/// <summary>
+	/// Gets whether an image may join the main region, which it may without consulting the filter while the cache has room for the
+	/// image being added. Otherwise the image must have been requested more often than the entry the main region would evict next.
+	/// </summary>
+	bool IsAdmittedToMainRegion(const std::string& key, const ImageCacheEntry<TImage>* excludedEntry, int64_t sizeInBytes) const;
+
+	/// <summary>
+	/// Gets the entry outside the admission window that <see cref="TryEvictLowestPriority"/> would evict from next, or nullptr if
+	/// there is none.
+	/// </summary>
+	const ImageCacheEntry<TImage>* FindMainRegionVictim(const ImageCacheEntry<TImage>* excludedEntry) const;
+
+	/// <summary>
+	/// Moves an entry from the admission window to the main region.
+	/// </summary>
+	void LeaveAdmissionWindow(ImageCacheEntry<TImage>* cacheEntry)
+	{
+		_admissionWindowIndex.erase(std::make_pair(cacheEntry->AdmissionWindowSequence, cacheEntry));
+		_admissionWindowMemoryUsage -= cacheEntry->SizeInBytes;
+		cacheEntry->InAdmissionWindow = false;
+	}
+
+	/// <summary>
+	/// Queues the removal of an image of the entry for the subscribers, with the reason of the calling thread's outermost
+	/// <see cref="RemovalNotificationScope"/>.
+	/// </summary>
+	void QueueRemoval(const ImageCacheEntry<TImage>* cacheEntry, int width, int height, CacheRemovalTier tier, int64_t sizeInBytes);
+
+	/// <summary>
+	/// Queues the removal of everything cached for the path for the subscribers, see <see cref="CacheRemovalTier::Entry"/>.
+	/// </summary>
+	void QueueEntryRemoval(const std::filesystem::path& imagePath, const ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Reports the queued removals to the subscribers. Must be called without holding the cache's lock.
+	/// </summary>
+	void NotifyRemovals();
+
+	/// <summary>
+	/// Frees the source image, encoded contents and released resized images of an entry, removing the entry if nothing else remains.
+	/// Pinned images are kept.
+	/// </summary>
+	void ExpireEntry(const std::string& key, ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Gets the cached copy of the entry's image closest to the specified size whose dimensions are within the size tolerance of it.
+	/// Returns nullptr if there is no such copy.
+	/// </summary>
+	std::shared_ptr<const TImage> TryGetImageWithinTolerance(ImageCacheEntry<TImage>* cacheEntry, unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Gets the smallest cached copy of the entry's image that is at least the specified size in both dimensions, and smaller than the
+	/// provided area. Returns nullptr if there is no such copy.
+	/// </summary>
+	/// <param name="maxArea">Copies with this area in pixels or more are ignored.</param>
+	std::shared_ptr<const TImage> TryGetSmallestLargerImage(ImageCacheEntry<TImage>* cacheEntry, unsigned int width, unsigned int height,
+		int64_t maxArea);
+
+	/// <summary>
+	/// Builds the mipmap chain of the source image in a single cascaded pass, each level downsampled from the previous one.
+	/// </summary>
+	static std::vector<std::shared_ptr<const IImageSource>> BuildMipLevels(const IImageSource& sourceImage);
+
+	/// <summary>
+	/// Updates the access statistics and eviction priority of an entry that has been requested or added.
+	/// </summary>
+	void OnEntryAccessed(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Recomputes the eviction priority of the entry's source image from its current access statistics.
+	/// </summary>
+	void UpdateEvictionPriority(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Places the entry in the eviction indexes of the tiers it holds, at its current priority. Called whenever its priority, its
+	/// source image, spilled source, encoded contents or pinning change.
+	/// </summary>
+	void ReindexEntry(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Removes the entry and its resized images from the eviction indexes, before it is deleted.
+	/// </summary>
+	void UnindexEntry(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Places the item in the index of retained images at its current priority if it is retained and not pinned, otherwise removes
+	/// it. Called whenever its priority, retention or pinning change.
+	/// </summary>
+	void ReindexItem(ImageCacheEntry<TImage>* cacheEntry, ImageCacheItem<TImage>* item);
+
+	/// <summary>
+	/// Removes the item from the index of retained images, before it is deleted.
+	/// </summary>
+	void UnindexItem(ImageCacheEntry<TImage>* cacheEntry, ImageCacheItem<TImage>* item);
+
+	/// <summary>
+	/// Evicts retained images, and source images unless the eviction policy is <see cref="EvictionPolicy::NeverEvict"/>, in order of
+	/// the eviction policy until the provided number of additional bytes fit within the maximum memory. Returns false if not enough
+	/// memory could be freed, in which case nothing further can be evicted.
+	/// </summary>
+	/// <param name="sizeInBytes">Number of additional bytes required.</param>
+	/// <param name="excludedEntry">An entry whose source must not be evicted, or nullptr.</param>
+	/// <param name="cacheNamespace">The namespace the bytes will be accounted to, or nullptr for the default namespace.</param>
+	bool TryMakeRoom(int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry, const CacheNamespace* cacheNamespace = nullptr);
+
+	/// <summary>
+	/// Evicts source images until the provided number of additional bytes fit within the source tier budget.
+	/// </summary>
+	/// <param name="excludedEntry">An entry whose source must not be evicted, or nullptr.</param>
+	bool TryMakeRoomForSource(int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry, const CacheNamespace* cacheNamespace = nullptr);
+
+	/// <summary>
+	/// Evicts retained images until the provided number of additional bytes fit within the resized tier budget.
+	/// </summary>
+	/// <param name="excludedEntry">An entry from which nothing must be evicted, or nullptr.</param>
+	bool TryMakeRoomForResized(int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry, const CacheNamespace* cacheNamespace = nullptr);
+
+	/// <summary>
+	/// Evicts images of the namespace until the provided number of additional bytes fit within its maximum memory. Always succeeds
+	/// for the default namespace.
+	/// </summary>
+	/// <param name="excludedEntry">An entry from which nothing must be evicted, or nullptr.</param>
+	bool TryMakeRoomInNamespace(int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry, CacheNamespace* cacheNamespace);
+
+	/// <summary>
+	/// Evicts the single item with the lowest eviction priority, or the encoded file contents with the lowest priority if there is no
+	/// such item. Returns false if there was nothing that could be evicted.
+	/// </summary>
+	/// <param name="excludedEntry">An entry from which nothing must be evicted, or nullptr.</param>
+	/// <param name="candidates">The <see cref="EvictionCandidates"/> that may be evicted.</param>
+	/// <param name="cacheNamespace">The namespace room is made for, or nullptr for the default namespace.</param>
+	bool TryEvictLowestPriority(const ImageCacheEntry<TImage>* excludedEntry, int candidates, const CacheNamespace* cacheNamespace = nullptr);
+
+	/// <summary>
+	/// Gets whether bytes accounted to a namespace may be evicted to make room for another namespace.
+	/// </summary>
+	/// <param name="owner">The namespace the bytes are accounted to.</param>
+	/// <param name="sizeInBytes">The number of bytes that would be evicted.</param>
+	/// <param name="candidates">The <see cref="EvictionCandidates"/> of the eviction.</param>
+	/// <param name="cacheNamespace">The namespace room is made for.</param>
+	static bool IsEvictableForNamespace(const CacheNamespace* owner, int64_t sizeInBytes, int candidates, const CacheNamespace* cacheNamespace)
+	{
+		if (owner == cacheNamespace)
+			return true;
+
+		if (candidates & RequestingNamespaceOnly)
+			return false;
+
+		return !(candidates & NamespaceMinimums) || !owner || owner->MemoryUsage - sizeInBytes >= owner->MinimumMemory;
+	}
+
+	/// <summary>
+	/// Gets the namespace with the provided name, or nullptr if it is the default namespace or has no budget.
+	/// </summary>
+	CacheNamespace* FindNamespace(const std::string& cacheNamespace)
+	{
+		const auto search = _namespaces.find(cacheNamespace);
+		return search != _namespaces.end() ? &search->second : nullptr;
+	}
+
+	/// <summary>
+	/// Adds to the bytes accounted to the entry itself, i.e. its source image, mipmap levels and encoded contents.
+	/// </summary>
+	void AccountEntryBytes(ImageCacheEntry<TImage>* cacheEntry, const int64_t sizeInBytes)
+	{
+		cacheEntry->SizeInBytes += sizeInBytes;
+		if (cacheEntry->InAdmissionWindow)
+			_admissionWindowMemoryUsage += sizeInBytes;
+
+		if (cacheEntry->Namespace)
+			cacheEntry->Namespace->MemoryUsage += sizeInBytes;
+	}
+
+	/// <summary>
+	/// Gets the calculator of the eviction priorities of resized images.
+	/// </summary>
+	EvictionPriorityCalculator& GetResizedEvictionPriority()
+	{
+		return _hasResizedEvictionPolicy ? _resizedEvictionPriority : _evictionPriority;
+	}
+
+	const EvictionPriorityCalculator& GetResizedEvictionPriority() const
+	{
+		return _hasResizedEvictionPolicy ? _resizedEvictionPriority : _evictionPriority;
+	}
+
+	/// <summary>
+	/// Removes a resized image item from its entry, releasing the memory accounted to it and deleting the image if it was retained.
+	/// Removes the entry as well if it no longer holds any resized images.
+	/// </summary>
+	/// <param name="excludedEntry">An entry whose spilled source must not be dropped to make room in the spill file, or nullptr.</param>
+	void RemoveResizedImage(const std::string& key, ImageCacheEntry<TImage>* cacheEntry, const std::string& resizedImageKey,
+		const ImageCacheEntry<TImage>* excludedEntry = nullptr);
+
+	/// <summary>
+	/// Removes a resized image item from its entry, releasing the memory accounted to it and deleting the image if it was retained.
+	/// The entry is kept even if it no longer holds any resized images.
+	/// </summary>
+	void ReleaseResizedImageItem(ImageCacheEntry<TImage>* cacheEntry,
+		typename std::map<const std::string, ImageCacheItem<TImage>*>::iterator resizedImage);
+
+	/// <summary>
+	/// Retains the image instead of deleting it, if it is cached and either pinned or fits within the retention budget.
+	/// </summary>
+	/// <returns>True if the cache took ownership of the image.</returns>
+	bool TryRetainImage(const TImage* image);
+
+	/// <summary>
+	/// Releases the cache's reference to the source image of an entry, spilling it if the spill tier is enabled, and removes the entry
+	/// if it no longer holds any images. Callers which obtained the source image from the cache keep it alive until they release it.
+	/// </summary>
+	/// <param name="excludedEntry">An entry whose spilled source must not be dropped to make room in the spill file, or nullptr.</param>
+	void EvictSourceImage(const std::string& key, ImageCacheEntry<TImage>* cacheEntry, const ImageCacheEntry<TImage>* excludedEntry = nullptr);
+
+	/// <summary>
+	/// Writes the source image of an entry to the spill file, if the spill tier is enabled and the source is expensive enough to
+	/// decode. Spilled sources with a lower eviction priority are dropped if the spill file is full.
+	/// </summary>
+	/// <param name="excludedEntry">An entry whose spilled source must not be dropped, or nullptr.</param>
+	/// <returns>True if the source image was spilled.</returns>
+	bool TrySpillSource(ImageCacheEntry<TImage>* cacheEntry, const ImageCacheEntry<TImage>* excludedEntry);
+
+	/// <summary>
+	/// Reads the spilled source image of an entry back into memory, if there is room for it.
+	/// </summary>
+	void TryRestoreSpilledSource(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Frees the space of an entry's spilled source image in the spill file.
+	/// </summary>
+	void ReleaseSpilledSource(ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Keeps the encoded file contents in the entry, if there is a budget for them, dropping the encoded contents of other entries
+	/// with a lower eviction priority if the budget is exceeded.
+	/// </summary>
+	void KeepEncodedBytes(ImageCacheEntry<TImage>* cacheEntry, std::shared_ptr<const std::vector<unsigned char>> encodedBytes);
+
+	/// <summary>
+	/// Drops the encoded file contents of the entry with the lowest eviction priority, removing the entry if it no longer holds
+	/// anything else. Returns false if no entry holds encoded contents.
+	/// </summary>
+	/// <param name="excludedEntry">An entry whose encoded contents must not be dropped, or nullptr.</param>
+	/// <param name="candidates">The <see cref="EvictionCandidates"/> of the eviction, for the namespace restrictions.</param>
+	/// <param name="cacheNamespace">The namespace room is made for, or nullptr for the default namespace.</param>
+	bool TryDropLowestPriorityEncodedBytes(const ImageCacheEntry<TImage>* excludedEntry, int candidates = 0,
+		const CacheNamespace* cacheNamespace = nullptr);
+
+	/// <summary>
+	/// Implements <see cref="TryGetImage"/> and <see cref="TryGetImageAtSize"/>, given the path as a string so that callers with an
+	/// interned path do not convert it again.
+	/// </summary>
+	/// <param name="imageId">The handle of the path for requests by handle, which may use the thread-local lookup.</param>
+	ImageCaching::TryGetImageResult TryGetImage(const std::filesystem::path& imagePath, const std::string& pathString,
+		std::optional<ImageId> imageId, std::shared_ptr<const TImage>& outImage, std::shared_ptr<const IImageSource>& outSourceImage);
+	ImageCaching::TryGetImageResult TryGetImageAtSize(const std::filesystem::path& imagePath, const std::string& pathString,
+		std::optional<ImageId> imageId, unsigned int width, unsigned int height,
+		std::shared_ptr<const TImage>& outImage, std::shared_ptr<const IImageSource>& outSourceImage);
+
+	/// <summary>
+	/// Gets a referenced image from the calling thread's <see cref="ThreadLocalImageLookup"/>, without taking the cache's lock.
+	/// </summary>
+	/// <returns>True if the image was found, in which case there is no source image.</returns>
+	bool TryGetThreadLocalImage(const ImageId imageId, const unsigned int width, const unsigned int height,
+		std::shared_ptr<const TImage>& outImage, std::shared_ptr<const IImageSource>& outSourceImage) const
+	{
+		outImage = ThreadLocalImageLookup<TImage>::TryGet(this, imageId, width, height);
+		if (!outImage)
+			return false;
+
+		outSourceImage = nullptr;
+		return true;
+	}
+
+	/// <summary>
+	/// Places an image found in the entry in the calling thread's <see cref="ThreadLocalImageLookup"/>, along with the hit counter of
+	/// its item.
+	/// </summary>
+	void PutThreadLocalImage(ImageCacheEntry<TImage>* cacheEntry, const ImageId imageId, const unsigned int width,
+		const unsigned int height, const std::shared_ptr<const TImage>& image)
+	{
+		auto* item = cacheEntry->TryGetResizedImageCacheItem(image->GetWidth(), image->GetHeight());
+		if (!item)
+			return;
+
+		if (!item->ThreadLocalHits)
+			item->ThreadLocalHits = std::make_shared<ThreadLocalHitCounter>();
+
+		ThreadLocalImageLookup<TImage>::Put(this, imageId, width, height, image, item->ThreadLocalHits);
+	}
+
+	/// <summary>
+	/// Folds the requests for the entry's images that were answered by thread-local lookups into the access counts, access time,
+	/// eviction priorities and admission filter, as if they had been requested from the cache. This is done whenever those are read
+	/// to choose what to expire, evict or report, rather than on every hit.
+	/// </summary>
+	/// <returns>True if any hits were folded.</returns>
+	bool FoldThreadLocalHits(const std::string& key, ImageCacheEntry<TImage>* cacheEntry);
+
+	/// <summary>
+	/// Gets the source image of a path from the shared source image store, if one is set, for a request the cache could not serve.
+	/// </summary>
+	/// <returns>FoundSourceImageOfDifferentDimensions if the store holds the source image, otherwise NotFound.</returns>
+	ImageCaching::TryGetImageResult TryGetStoredSourceImage(const std::filesystem::path& imagePath,
+		std::shared_ptr<const IImageSource>& outSourceImage)
+	{
+		if (!_sourceImageStore || !_sourceImageStore->TryGetSourceImage(imagePath, outSourceImage))
+			return ImageCaching::TryGetImageResult::NotFound;
+
+		//an entry started by a resized image, e.g. in another cache sharing the store, learns the dimensions of its source here.
+		if (auto search = _images.find(ResolveKey(imagePath)); search != _images.end() && search->second->SourceWidth == 0)
+		{
+			search->second->SourceWidth = outSourceImage->GetWidth();
+			search->second->SourceHeight = outSourceImage->GetHeight();
+		}
+
+		return ImageCaching::TryGetImageResult::FoundSourceImageOfDifferentDimensions;
+	}
+
+	/// <summary>
+	/// Records the dimensions of a source image added to the shared source image store on the entry of its path, creating an entry
+	/// without a source image if there is none.
+	/// </summary>
+	void RecordStoredSourceDimensions(const std::filesystem::path& imagePath, int width, int height, const std::string& namespaceName);
+
+	/// <summary>
+	/// Removes the entry from the cache, releasing the memory accounted to it.
+	/// </summary>
+	void RemoveEntry(const std::string& key, ImageCacheEntry<TImage>* cacheEntry);
 
 	void OnDestroy(const TImage* image)
 	{
+		if (TryRetainImage(image))
+			return;
+
 		TryRemoveImage(image);
 		delete image;
 	}
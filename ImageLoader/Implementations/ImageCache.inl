@@ -9,8 +9,963 @@ void ImageCache<TImage>::SetMaxMemory(const int64_t maximumMemoryInBytes)
 	if (maximumMemoryInBytes < 0)
 		throw std::runtime_error("Max memory must be positive");
 
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
 	_maxAllowedMemory = maximumMemoryInBytes;
-	//TODO: zoea 25/11/2024 remove items if needed when the memory cap is reduced.
+
+	//images which are referenced cannot be removed, so with no eviction policy the usage can remain above a reduced cap until
+	//those images are released.
+	if (GetTotalMemoryUsage() > _maxAllowedMemory)
+		TryMakeRoom(0, nullptr);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetMaxRetainedMemory(const int64_t maximumRetainedMemoryInBytes)
+{
+	if (maximumRetainedMemoryInBytes < 0)
+		throw std::runtime_error("Max retained memory must be positive");
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_maxRetainedMemory = maximumRetainedMemoryInBytes;
+
+	while (_retainedMemoryUsage > _maxRetainedMemory && TryEvictLowestPriority(nullptr, RetainedImages))
+	{
+	}
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetMaxSourceMemory(const int64_t maximumSourceMemoryInBytes)
+{
+	if (maximumSourceMemoryInBytes < 0)
+		throw std::runtime_error("Max source memory must be positive");
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_maxSourceMemory = maximumSourceMemoryInBytes;
+	TryMakeRoomForSource(0, nullptr);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetMaxResizedMemory(const int64_t maximumResizedMemoryInBytes)
+{
+	if (maximumResizedMemoryInBytes < 0)
+		throw std::runtime_error("Max resized memory must be positive");
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_maxResizedMemory = maximumResizedMemoryInBytes;
+	TryMakeRoomForResized(0, nullptr);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetNamespaceBudget(const std::string& cacheNamespace, const int64_t minimumMemoryInBytes,
+	const int64_t maximumMemoryInBytes)
+{
+	if (cacheNamespace.empty())
+		throw std::runtime_error("The default namespace cannot have a budget");
+
+	if (minimumMemoryInBytes < 0 || maximumMemoryInBytes < minimumMemoryInBytes)
+		throw std::runtime_error("Namespace memory must be positive, and the maximum at least the minimum");
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	auto& budget = _namespaces[cacheNamespace];
+	budget.MinimumMemory = minimumMemoryInBytes;
+	budget.MaxMemory = maximumMemoryInBytes;
+	TryMakeRoomInNamespace(0, nullptr, &budget);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetMaxPinnedMemory(const int64_t maximumPinnedMemoryInBytes)
+{
+	if (maximumPinnedMemoryInBytes < 0)
+		throw std::runtime_error("Max pinned memory must be positive");
+
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_maxPinnedMemory = maximumPinnedMemoryInBytes;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetMaxEncodedMemory(const int64_t maximumEncodedMemoryInBytes)
+{
+	if (maximumEncodedMemoryInBytes < 0)
+		throw std::runtime_error("Max encoded memory must be positive");
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_maxEncodedMemory = maximumEncodedMemoryInBytes;
+
+	while (_encodedMemoryUsage > _maxEncodedMemory && TryDropLowestPriorityEncodedBytes(nullptr))
+	{
+	}
+}
+
+template<typename TImage>
+void ImageCache<TImage>::SetEvictionPolicy(const EvictionPolicy sourcePolicy, const EvictionPolicy resizedPolicy)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	_evictionPriority = EvictionPriorityCalculator(sourcePolicy);
+	_resizedEvictionPriority = EvictionPriorityCalculator(resizedPolicy);
+	_hasResizedEvictionPolicy = sourcePolicy != resizedPolicy;
+
+	//priorities computed under a previous policy are not comparable with the new ones.
+	for (auto& image : _images)
+	{
+		UpdateEvictionPriority(image.second);
+
+		for (auto& resized : image.second->ResizedImages)
+		{
+			auto* item = resized.second;
+			item->EvictionPriority = GetResizedEvictionPriority().OnAccess(item->AccessCount, item->CreationCost, item->SizeInBytes);
+			ReindexItem(image.second, item);
+		}
+	}
+}
+
+template<typename TImage>
+void ImageCache<TImage>::EnableAdmissionFilter(const AdmissionFilterSettings& settings)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+
+	delete _admissionFilter;
+	_admissionFilter = new TinyLfuAdmissionFilter(settings);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::DisableAdmissionFilter()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+
+	delete _admissionFilter;
+	_admissionFilter = nullptr;
+
+	//entries in the window are now part of the main region.
+	for (auto& image : _images)
+		image.second->InAdmissionWindow = false;
+
+	_admissionWindowIndex.clear();
+	_admissionWindowMemoryUsage = 0;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryAdmit(const std::string& key, ImageCacheEntry<TImage>* cacheEntry, const int64_t sizeInBytes, bool& outInAdmissionWindow)
+{
+	outInAdmissionWindow = false;
+	if (!_admissionFilter)
+		return true;
+
+	//resized copies of an image which already made it into the main region are always admitted.
+	if (cacheEntry && !cacheEntry->InAdmissionWindow)
+		return true;
+
+	const auto windowSize = _admissionFilter->GetWindowSizeInBytes(_maxAllowedMemory);
+	if (sizeInBytes > windowSize)
+	{
+		if (!IsAdmittedToMainRegion(key, cacheEntry, sizeInBytes))
+			return false;
+
+		//the whole entry of a copy too large for the window joins the main region with it.
+		if (cacheEntry)
+			LeaveAdmissionWindow(cacheEntry);
+
+		return true;
+	}
+
+	//the window only makes room for new images, what leaves it is evicted only if the cache would have to evict for it anyway.
+	while (_admissionWindowMemoryUsage + sizeInBytes > windowSize && EvictFromAdmissionWindow(cacheEntry, sizeInBytes))
+	{
+	}
+
+	_admissionWindowMemoryUsage += sizeInBytes;
+	outInAdmissionWindow = true;
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::EvictFromAdmissionWindow(const ImageCacheEntry<TImage>* excludedEntry, const int64_t sizeInBytes)
+{
+	ImageCacheEntry<TImage>* candidate = nullptr;
+	for (const auto& [sequence, cacheEntry] : _admissionWindowIndex)
+	{
+		if (cacheEntry != excludedEntry)
+		{
+			candidate = cacheEntry;
+			break;
+		}
+	}
+
+	if (!candidate)
+		return false;
+
+	const bool isAdmitted = IsAdmittedToMainRegion(candidate->Key, excludedEntry, sizeInBytes);
+	LeaveAdmissionWindow(candidate);
+	if (!isAdmitted)
+	{
+		const auto key = candidate->Key;
+		ExpireEntry(key, candidate);
+	}
+
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::IsAdmittedToMainRegion(const std::string& key, const ImageCacheEntry<TImage>* excludedEntry,
+	const int64_t sizeInBytes) const
+{
+	if (GetTotalMemoryUsage() + sizeInBytes <= _maxAllowedMemory)
+		return true;
+
+	const auto* victim = FindMainRegionVictim(excludedEntry);
+	return !victim || _admissionFilter->EstimateFrequency(key) > _admissionFilter->EstimateFrequency(victim->Key);
+}
+
+template<typename TImage>
+const ImageCacheEntry<TImage>* ImageCache<TImage>::FindMainRegionVictim(const ImageCacheEntry<TImage>* excludedEntry) const
+{
+	//the same victims as TryEvictLowestPriority, leaving out the entries in the window.
+	const ImageCacheEntry<TImage>* sourceVictim = nullptr;
+	if (_evictionPriority.GetPolicy() != EvictionPolicy::NeverEvict)
+	{
+		for (const auto& [priority, cacheEntry] : _sourceIndex)
+		{
+			if (cacheEntry != excludedEntry && !cacheEntry->InAdmissionWindow)
+			{
+				sourceVictim = cacheEntry;
+				break;
+			}
+		}
+	}
+
+	const ImageCacheEntry<TImage>* retainedVictim = nullptr;
+	const ImageCacheItem<TImage>* retainedItem = nullptr;
+	for (const auto& [priority, item, cacheEntry] : _retainedIndex)
+	{
+		if (cacheEntry != excludedEntry && !cacheEntry->InAdmissionWindow)
+		{
+			retainedVictim = cacheEntry;
+			retainedItem = item;
+			break;
+		}
+	}
+
+	if (sourceVictim && (!retainedVictim || _hasResizedEvictionPolicy
+		|| sourceVictim->IndexedEvictionPriority < retainedItem->IndexedEvictionPriority))
+		return sourceVictim;
+
+	return retainedVictim;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::OnEntryAccessed(ImageCacheEntry<TImage>* cacheEntry)
+{
+	++cacheEntry->AccessCount;
+	cacheEntry->LastAccessTime = std::chrono::steady_clock::now();
+	if (cacheEntry->InAdmissionWindow)
+	{
+		_admissionWindowIndex.erase(std::make_pair(cacheEntry->AdmissionWindowSequence, cacheEntry));
+		cacheEntry->AdmissionWindowSequence = ++_admissionWindowSequence;
+		_admissionWindowIndex.emplace(cacheEntry->AdmissionWindowSequence, cacheEntry);
+	}
+
+	UpdateEvictionPriority(cacheEntry);
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::FoldThreadLocalHits(const std::string& key, ImageCacheEntry<TImage>* cacheEntry)
+{
+	uint32_t entryHitCount = 0;
+	std::chrono::steady_clock::rep lastHitTime = 0;
+	for (auto& resized : cacheEntry->ResizedImages)
+	{
+		auto* item = resized.second;
+		if (!item->ThreadLocalHits)
+			continue;
+
+		const auto hitCount = item->ThreadLocalHits->HitCount.exchange(0, std::memory_order_relaxed);
+		if (hitCount == 0)
+			continue;
+
+		item->AccessCount += hitCount;
+		entryHitCount += hitCount;
+		lastHitTime = std::max(lastHitTime, item->ThreadLocalHits->LastHitTime.load(std::memory_order_relaxed));
+		if (item->IsRetained())
+		{
+			item->EvictionPriority = GetResizedEvictionPriority().OnAccess(item->AccessCount, item->CreationCost, item->SizeInBytes);
+			ReindexItem(cacheEntry, item);
+		}
+	}
+
+	if (entryHitCount == 0)
+		return false;
+
+	cacheEntry->AccessCount += entryHitCount;
+	const std::chrono::steady_clock::time_point lastHit{ std::chrono::steady_clock::duration(lastHitTime) };
+	cacheEntry->LastAccessTime = std::max(cacheEntry->LastAccessTime, lastHit);
+	UpdateEvictionPriority(cacheEntry);
+
+	//the sketch's counters saturate, so recording more accesses than that only ages the sketch sooner.
+	if (_admissionFilter)
+	{
+		for (uint32_t access = 0; access < std::min<uint32_t>(entryHitCount, FrequencySketch::MaxCounterValue); access++)
+			_admissionFilter->RecordAccess(key);
+	}
+
+	return true;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::UpdateEvictionPriority(ImageCacheEntry<TImage>* cacheEntry)
+{
+	if (cacheEntry->SourceImage)
+	{
+		cacheEntry->SourceEvictionPriority = _evictionPriority.OnAccess(
+			cacheEntry->AccessCount, cacheEntry->SourceCreationCost, cacheEntry->GetSourceSizeInBytes());
+	}
+
+	ReindexEntry(cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::ReindexEntry(ImageCacheEntry<TImage>* cacheEntry)
+{
+	const auto indexed = std::make_pair(cacheEntry->IndexedEvictionPriority, cacheEntry);
+	_sourceIndex.erase(indexed);
+	_spilledIndex.erase(indexed);
+	_encodedIndex.erase(indexed);
+
+	const auto priority = std::make_pair(cacheEntry->SourceEvictionPriority, cacheEntry);
+	cacheEntry->IndexedEvictionPriority = cacheEntry->SourceEvictionPriority;
+	if (cacheEntry->SourceImage && !cacheEntry->IsSourcePinned)
+		_sourceIndex.insert(priority);
+
+	if (cacheEntry->IsSourceSpilled())
+		_spilledIndex.insert(priority);
+
+	if (cacheEntry->EncodedBytes)
+		_encodedIndex.insert(priority);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::UnindexEntry(ImageCacheEntry<TImage>* cacheEntry)
+{
+	const auto indexed = std::make_pair(cacheEntry->IndexedEvictionPriority, cacheEntry);
+	_sourceIndex.erase(indexed);
+	_spilledIndex.erase(indexed);
+	_encodedIndex.erase(indexed);
+
+	for (const auto& resized : cacheEntry->ResizedImages)
+		UnindexItem(cacheEntry, resized.second);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::ReindexItem(ImageCacheEntry<TImage>* cacheEntry, ImageCacheItem<TImage>* item)
+{
+	UnindexItem(cacheEntry, item);
+	if (!item->IsRetained() || item->IsPinned)
+		return;
+
+	item->IndexedEvictionPriority = item->EvictionPriority;
+	_retainedIndex.emplace(item->EvictionPriority, item, cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::UnindexItem(ImageCacheEntry<TImage>* cacheEntry, ImageCacheItem<TImage>* item)
+{
+	_retainedIndex.erase(std::make_tuple(item->IndexedEvictionPriority, item, cacheEntry));
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryMakeRoom(const int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry,
+	const CacheNamespace* cacheNamespace)
+{
+	//retained images are evicted under memory pressure whatever the policy, they have no references outside the cache.
+	int candidates = RetainedImages | EncodedBytes | NamespaceMinimums;
+	if (_evictionPriority.GetPolicy() != EvictionPolicy::NeverEvict)
+		candidates |= SourceImages;
+
+	while (GetTotalMemoryUsage() + sizeInBytes > _maxAllowedMemory)
+	{
+		if (!TryEvictLowestPriority(excludedEntry, candidates, cacheNamespace))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryMakeRoomForSource(const int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry,
+	const CacheNamespace* cacheNamespace)
+{
+	while (_sourceMemoryUsage + sizeInBytes > _maxSourceMemory)
+	{
+		if (!TryEvictLowestPriority(excludedEntry, SourceImages | NamespaceMinimums, cacheNamespace))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryMakeRoomForResized(const int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry,
+	const CacheNamespace* cacheNamespace)
+{
+	while (_resizedMemoryUsage + sizeInBytes > _maxResizedMemory)
+	{
+		if (!TryEvictLowestPriority(excludedEntry, RetainedImages | NamespaceMinimums, cacheNamespace))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryMakeRoomInNamespace(const int64_t sizeInBytes, const ImageCacheEntry<TImage>* excludedEntry,
+	CacheNamespace* cacheNamespace)
+{
+	if (!cacheNamespace)
+		return true;
+
+	int candidates = RetainedImages | EncodedBytes | RequestingNamespaceOnly;
+	if (_evictionPriority.GetPolicy() != EvictionPolicy::NeverEvict)
+		candidates |= SourceImages;
+
+	while (cacheNamespace->MemoryUsage + sizeInBytes > cacheNamespace->MaxMemory)
+	{
+		if (!TryEvictLowestPriority(excludedEntry, candidates, cacheNamespace))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryEvictLowestPriority(const ImageCacheEntry<TImage>* excludedEntry, const int candidates,
+	const CacheNamespace* cacheNamespace)
+{
+	//the indexes are ordered by priority, so the first candidate that may be evicted is the lowest, usually at the front.
+	ImageCacheEntry<TImage>* sourceVictim = nullptr;
+	if (candidates & SourceImages)
+	{
+		for (const auto& [priority, cacheEntry] : _sourceIndex)
+		{
+			if (cacheEntry != excludedEntry
+				&& IsEvictableForNamespace(cacheEntry->Namespace, cacheEntry->GetSourceSizeInBytes(), candidates, cacheNamespace))
+			{
+				sourceVictim = cacheEntry;
+				break;
+			}
+		}
+	}
+
+	ImageCacheEntry<TImage>* retainedVictim = nullptr;
+	const ImageCacheItem<TImage>* retainedItem = nullptr;
+	if (candidates & RetainedImages)
+	{
+		for (const auto& [priority, item, cacheEntry] : _retainedIndex)
+		{
+			if (cacheEntry != excludedEntry && IsEvictableForNamespace(item->Namespace, item->SizeInBytes, candidates, cacheNamespace))
+			{
+				retainedVictim = cacheEntry;
+				retainedItem = item;
+				break;
+			}
+		}
+	}
+
+	//hits answered by thread-local lookups raise the priority of a victim, in which case another one may be lower now.
+	const bool sourceVictimWasHit = sourceVictim && FoldThreadLocalHits(sourceVictim->Key, sourceVictim);
+	const bool retainedVictimWasHit = retainedVictim && retainedVictim != sourceVictim
+		&& FoldThreadLocalHits(retainedVictim->Key, retainedVictim);
+	if (sourceVictimWasHit || retainedVictimWasHit)
+		return TryEvictLowestPriority(excludedEntry, candidates, cacheNamespace);
+
+	//the priorities of the two tiers are only comparable when they are computed by the same policy, otherwise a source image is
+	//evicted first as it can be re-created from the encoded file contents or the spill tier, or decoded again.
+	const bool evictSource = sourceVictim && (!retainedVictim || _hasResizedEvictionPolicy
+		|| sourceVictim->IndexedEvictionPriority < retainedItem->IndexedEvictionPriority);
+	if (evictSource)
+	{
+		//this only drops the cache's reference to the source, a resize in progress holds its own reference and keeps it alive.
+		const auto key = sourceVictim->Key;
+		_evictionPriority.OnEvicted(sourceVictim->IndexedEvictionPriority);
+		EvictSourceImage(key, sourceVictim, excludedEntry);
+		return true;
+	}
+
+	if (retainedVictim)
+	{
+		const auto key = retainedVictim->Key;
+		GetResizedEvictionPriority().OnEvicted(retainedItem->IndexedEvictionPriority);
+		RemoveResizedImage(key, retainedVictim, ResizedImageKey(retainedItem->Width, retainedItem->Height).ToStringKey(), excludedEntry);
+		return true;
+	}
+
+	//encoded file contents are only dropped once there are no decoded images left to evict, they are what makes re-creating those cheap.
+	return (candidates & EncodedBytes) && TryDropLowestPriorityEncodedBytes(excludedEntry, candidates, cacheNamespace);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::RemoveResizedImage(const std::string& key, ImageCacheEntry<TImage>* cacheEntry, const std::string& resizedImageKey,
+	const ImageCacheEntry<TImage>* excludedEntry)
+{
+	auto& resizedImages = cacheEntry->ResizedImages;
+	if (auto resizedSearch = resizedImages.find(resizedImageKey); resizedSearch != resizedImages.end())
+		ReleaseResizedImageItem(cacheEntry, resizedSearch);
+
+	if (!resizedImages.empty())
+		return;
+
+	//the source is dropped along with the last resized image, unless it can be spilled or is pinned.
+	if (cacheEntry->SourceImage && !cacheEntry->IsSourcePinned)
+		EvictSourceImage(key, cacheEntry, excludedEntry);
+	else if (cacheEntry->IsEmpty())
+		RemoveEntry(key, cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::ReleaseResizedImageItem(ImageCacheEntry<TImage>* cacheEntry,
+	typename std::map<const std::string, ImageCacheItem<TImage>*>::iterator resizedImage)
+{
+	auto* item = resizedImage->second;
+	UnindexItem(cacheEntry, item);
+	QueueRemoval(cacheEntry, item->Width, item->Height, CacheRemovalTier::ResizedImage, item->SizeInBytes);
+	_currentMemoryUsage -= item->SizeInBytes;
+	_resizedMemoryUsage -= item->SizeInBytes;
+	cacheEntry->SizeInBytes -= item->SizeInBytes;
+	if (cacheEntry->InAdmissionWindow)
+		_admissionWindowMemoryUsage -= item->SizeInBytes;
+
+	if (item->Namespace)
+		item->Namespace->MemoryUsage -= item->SizeInBytes;
+
+	if (item->IsPinned)
+		_pinnedMemoryUsage -= item->SizeInBytes;
+	else if (item->IsRetained())
+		_retainedMemoryUsage -= item->SizeInBytes;
+
+	AccountMetadata(cacheEntry, -GetItemMetadataSize(resizedImage->first));
+	cacheEntry->ResizedImages.erase(resizedImage);
+	delete item;
+	ThreadLocalImageLookup<TImage>::Invalidate();
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryRetainImage(const TImage* image)
+{
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	const auto key = ResolveKey(image->GetImagePath());
+	auto search = _images.find(key);
+	if (search == _images.end())
+		return false;
+
+	auto* item = search->second->TryGetResizedImageCacheItem(image->GetWidth(), image->GetHeight());
+	if (!item || !item->IsInstance(image))
+		return false;
+
+	//a pinned image is already accounted in the pinned budget, and is kept whatever the retention budget.
+	if (item->IsPinned)
+	{
+		item->Retain(image);
+		return true;
+	}
+
+	if (item->SizeInBytes > _maxRetainedMemory)
+		return false;
+
+	FoldThreadLocalHits(key, search->second);
+	item->Retain(image);
+	item->EvictionPriority = GetResizedEvictionPriority().OnAccess(item->AccessCount, item->CreationCost, item->SizeInBytes);
+	ReindexItem(search->second, item);
+	_retainedMemoryUsage += item->SizeInBytes;
+
+	//this may evict the image that was just retained, if it has the lowest priority.
+	while (_retainedMemoryUsage > _maxRetainedMemory && TryEvictLowestPriority(nullptr, RetainedImages))
+	{
+	}
+
+	return true;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::EvictSourceImage(const std::string& key, ImageCacheEntry<TImage>* cacheEntry,
+	const ImageCacheEntry<TImage>* excludedEntry)
+{
+	TrySpillSource(cacheEntry, excludedEntry);
+
+	const auto sourceSize = cacheEntry->GetSourceSizeInBytes();
+	if (cacheEntry->SourceImage)
+		QueueRemoval(cacheEntry, cacheEntry->SourceWidth, cacheEntry->SourceHeight, CacheRemovalTier::SourceImage, sourceSize);
+
+	_currentMemoryUsage -= sourceSize;
+	_sourceMemoryUsage -= sourceSize;
+	AccountEntryBytes(cacheEntry, -sourceSize);
+
+	cacheEntry->SourceImage = nullptr;
+	cacheEntry->MipLevels.clear();
+	ReindexEntry(cacheEntry);
+
+	//the entry is kept while it holds resized images, a spilled source, or the encoded file contents to decode the source from.
+	if (cacheEntry->IsEmpty())
+		RemoveEntry(key, cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::EnableSpillTier(const std::filesystem::path& filePath, const uint64_t capacityInBytes,
+	const std::chrono::microseconds minimumCreationCost)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	DisableSpillTier();
+
+	_spillFile = new SpillFile(filePath, capacityInBytes);
+	_minimumSpillCreationCost = minimumCreationCost;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::DisableSpillTier()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	if (!_spillFile)
+		return;
+
+	for (auto image = _images.begin(); image != _images.end();)
+	{
+		auto* cacheEntry = (image++)->second;
+		if (!cacheEntry->IsSourceSpilled())
+			continue;
+
+		ReleaseSpilledSource(cacheEntry);
+		if (cacheEntry->IsEmpty())
+			RemoveEntry(cacheEntry->Key, cacheEntry);
+	}
+
+	delete _spillFile;
+	_spillFile = nullptr;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TrySpillSource(ImageCacheEntry<TImage>* cacheEntry, const ImageCacheEntry<TImage>* excludedEntry)
+{
+	if (!_spillFile || !cacheEntry->SourceImage || cacheEntry->SourceCreationCost < _minimumSpillCreationCost)
+		return false;
+
+	const auto* pixels = cacheEntry->SourceImage->GetPixels();
+	const auto length = static_cast<uint64_t>(cacheEntry->SourceImage->GetSizeInBytes());
+	if (!pixels || length > _spillFile->GetCapacity())
+		return false;
+
+	uint64_t offset;
+	while (!_spillFile->TryWrite(pixels, length, offset))
+	{
+		//make room by dropping the spilled source with the lowest priority, which may not be enough if the free space is fragmented.
+		ImageCacheEntry<TImage>* lowestEntry = nullptr;
+		for (const auto& [priority, entry] : _spilledIndex)
+		{
+			if (entry != cacheEntry && entry != excludedEntry)
+			{
+				lowestEntry = entry;
+				break;
+			}
+		}
+
+		if (!lowestEntry)
+			return false;
+
+		ReleaseSpilledSource(lowestEntry);
+		if (lowestEntry->IsEmpty())
+			RemoveEntry(lowestEntry->Key, lowestEntry);
+	}
+
+	cacheEntry->SpilledSourceOffset = static_cast<int64_t>(offset);
+	cacheEntry->SpilledSourceLength = length;
+	ReindexEntry(cacheEntry);
+	return true;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::TryRestoreSpilledSource(ImageCacheEntry<TImage>* cacheEntry)
+{
+	const auto length = static_cast<int64_t>(cacheEntry->SpilledSourceLength);
+	auto* cacheNamespace = cacheEntry->Namespace;
+	if (!TryMakeRoomInNamespace(length, cacheEntry, cacheNamespace) || !TryMakeRoomForSource(length, cacheEntry, cacheNamespace)
+		|| !TryMakeRoom(length, cacheEntry, cacheNamespace))
+		return;
+
+	auto* pixels = static_cast<unsigned char*>(malloc(cacheEntry->SpilledSourceLength));
+	if (!pixels || !_spillFile->Read(cacheEntry->SpilledSourceOffset, cacheEntry->SpilledSourceLength, pixels))
+	{
+		free(pixels);
+		return;
+	}
+
+	ReleaseSpilledSource(cacheEntry);
+	cacheEntry->SourceImage = std::make_shared<ImageSource>(cacheEntry->GetImagePath(), cacheEntry->SourceWidth, cacheEntry->SourceHeight, pixels);
+	AccountEntryBytes(cacheEntry, length);
+	ReindexEntry(cacheEntry);
+
+	_currentMemoryUsage += length;
+	_sourceMemoryUsage += length;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::ReleaseSpilledSource(ImageCacheEntry<TImage>* cacheEntry)
+{
+	if (!cacheEntry->IsSourceSpilled())
+		return;
+
+	_spillFile->Free(cacheEntry->SpilledSourceOffset, cacheEntry->SpilledSourceLength);
+	cacheEntry->SpilledSourceOffset = -1;
+	cacheEntry->SpilledSourceLength = 0;
+	ReindexEntry(cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::KeepEncodedBytes(ImageCacheEntry<TImage>* cacheEntry,
+	std::shared_ptr<const std::vector<unsigned char>> encodedBytes)
+{
+	if (!encodedBytes || cacheEntry->EncodedBytes)
+		return;
+
+	const auto size = static_cast<int64_t>(encodedBytes->size());
+	if (size > _maxEncodedMemory || !TryMakeRoomInNamespace(size, cacheEntry, cacheEntry->Namespace)
+		|| !TryMakeRoom(size, cacheEntry, cacheEntry->Namespace))
+		return;
+
+	cacheEntry->EncodedBytes = std::move(encodedBytes);
+	AccountEntryBytes(cacheEntry, size);
+	ReindexEntry(cacheEntry);
+
+	_currentMemoryUsage += size;
+	_encodedMemoryUsage += size;
+
+	while (_encodedMemoryUsage > _maxEncodedMemory && TryDropLowestPriorityEncodedBytes(cacheEntry))
+	{
+	}
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryDropLowestPriorityEncodedBytes(const ImageCacheEntry<TImage>* excludedEntry, const int candidates,
+	const CacheNamespace* cacheNamespace)
+{
+	ImageCacheEntry<TImage>* lowestEntry = nullptr;
+	for (const auto& [priority, entry] : _encodedIndex)
+	{
+		if (entry != excludedEntry
+			&& IsEvictableForNamespace(entry->Namespace, static_cast<int64_t>(entry->EncodedBytes->size()), candidates, cacheNamespace))
+		{
+			lowestEntry = entry;
+			break;
+		}
+	}
+
+	if (!lowestEntry)
+		return false;
+
+	const auto size = static_cast<int64_t>(lowestEntry->EncodedBytes->size());
+	QueueRemoval(lowestEntry, lowestEntry->SourceWidth, lowestEntry->SourceHeight, CacheRemovalTier::EncodedBytes, size);
+	lowestEntry->EncodedBytes = nullptr;
+	AccountEntryBytes(lowestEntry, -size);
+	ReindexEntry(lowestEntry);
+
+	_currentMemoryUsage -= size;
+	_encodedMemoryUsage -= size;
+
+	if (lowestEntry->IsEmpty())
+		RemoveEntry(lowestEntry->Key, lowestEntry);
+
+	return true;
+}
+
+template<typename TImage>
+int64_t ImageCache<TImage>::TrimIdleEntries(size_t maxEntries)
+{
+	const RemovalNotificationScope removalScope(*this, CacheRemovalReason::Expired);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	if (_idleTimeout.count() == 0 || _images.empty())
+		return 0;
+
+	const auto memoryUsage = _currentMemoryUsage;
+	const auto expiryTime = std::chrono::steady_clock::now() - _idleTimeout;
+	maxEntries = std::min(maxEntries, _images.size());
+	for (size_t visited = 0; visited < maxEntries; visited++)
+	{
+		auto image = _images.lower_bound(_trimCursor);
+		if (image == _images.end())
+			image = _images.begin();
+
+		//the cursor is a key rather than an iterator, expiring an entry may remove other entries, e.g. by spilling its source.
+		const auto key = image->first;
+		auto* cacheEntry = image->second;
+		const auto next = std::next(image);
+		_trimCursor = next != _images.end() ? next->first : std::string();
+
+		FoldThreadLocalHits(key, cacheEntry);
+		if (cacheEntry->LastAccessTime < expiryTime)
+			ExpireEntry(key, cacheEntry);
+	}
+
+	return memoryUsage - _currentMemoryUsage;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::ExpireEntry(const std::string& key, ImageCacheEntry<TImage>* cacheEntry)
+{
+	for (auto resized = cacheEntry->ResizedImages.begin(); resized != cacheEntry->ResizedImages.end();)
+	{
+		if (resized->second->IsRetained() && !resized->second->IsPinned)
+			ReleaseResizedImageItem(cacheEntry, resized++);
+		else
+			++resized;
+	}
+
+	if (cacheEntry->EncodedBytes)
+	{
+		const auto size = static_cast<int64_t>(cacheEntry->EncodedBytes->size());
+		QueueRemoval(cacheEntry, cacheEntry->SourceWidth, cacheEntry->SourceHeight, CacheRemovalTier::EncodedBytes, size);
+		cacheEntry->EncodedBytes = nullptr;
+		AccountEntryBytes(cacheEntry, -size);
+		ReindexEntry(cacheEntry);
+
+		_currentMemoryUsage -= size;
+		_encodedMemoryUsage -= size;
+	}
+
+	if (cacheEntry->SourceImage && !cacheEntry->IsSourcePinned)
+		EvictSourceImage(key, cacheEntry);
+	else if (cacheEntry->IsEmpty())
+		RemoveEntry(key, cacheEntry);
+}
+
+template<typename TImage>
+void ImageCache<TImage>::RemoveEntry(const std::string& key, ImageCacheEntry<TImage>* cacheEntry)
+{
+	ReleaseSpilledSource(cacheEntry);
+	if (cacheEntry->SourceImage)
+	{
+		QueueRemoval(cacheEntry, cacheEntry->SourceWidth, cacheEntry->SourceHeight, CacheRemovalTier::SourceImage,
+			cacheEntry->GetSourceSizeInBytes());
+	}
+
+	if (cacheEntry->EncodedBytes)
+	{
+		const auto size = static_cast<int64_t>(cacheEntry->EncodedBytes->size());
+		QueueRemoval(cacheEntry, cacheEntry->SourceWidth, cacheEntry->SourceHeight, CacheRemovalTier::EncodedBytes, size);
+		_encodedMemoryUsage -= size;
+	}
+
+	_currentMemoryUsage -= cacheEntry->SizeInBytes;
+	_sourceMemoryUsage -= cacheEntry->GetSourceSizeInBytes();
+	_metadataMemoryUsage -= cacheEntry->MetadataSizeInBytes;
+	if (cacheEntry->InAdmissionWindow)
+		LeaveAdmissionWindow(cacheEntry);
+
+	if (cacheEntry->IsSourcePinned)
+		_pinnedMemoryUsage -= cacheEntry->GetSourceSizeInBytes();
+
+	//the entry's own bytes are accounted to its namespace, each resized image to the namespace that added it.
+	int64_t entryBytes = cacheEntry->SizeInBytes;
+	for (const auto& resized : cacheEntry->ResizedImages)
+	{
+		QueueRemoval(cacheEntry, resized.second->Width, resized.second->Height, CacheRemovalTier::ResizedImage, resized.second->SizeInBytes);
+		entryBytes -= resized.second->SizeInBytes;
+		if (resized.second->Namespace)
+			resized.second->Namespace->MemoryUsage -= resized.second->SizeInBytes;
+
+		_resizedMemoryUsage -= resized.second->SizeInBytes;
+		if (resized.second->IsPinned)
+			_pinnedMemoryUsage -= resized.second->SizeInBytes;
+		else if (resized.second->IsRetained())
+			_retainedMemoryUsage -= resized.second->SizeInBytes;
+	}
+
+	if (cacheEntry->Namespace)
+		cacheEntry->Namespace->MemoryUsage -= entryBytes;
+
+	if (cacheEntry->ContentHash != 0)
+		_contentKeys.erase(cacheEntry->ContentHash);
+
+	QueueEntryRemoval(cacheEntry->GetImagePath(), cacheEntry);
+	for (const auto& alias : cacheEntry->PathAliases)
+	{
+		QueueEntryRemoval(alias, cacheEntry);
+		_pathAliases.erase(alias);
+	}
+
+	//the file may be deleted once nothing is cached for it, and its inode reused by another file.
+	if (_canonicalizePaths)
+		_pathCanonicalizer.Release(key);
+
+	UnindexEntry(cacheEntry);
+	_images.erase(key);
+	delete cacheEntry;
+	ThreadLocalImageLookup<TImage>::Invalidate();
+}
+
+template<typename TImage>
+void ImageCache<TImage>::QueueRemoval(const ImageCacheEntry<TImage>* cacheEntry, const int width, const int height,
+	const CacheRemovalTier tier, const int64_t sizeInBytes)
+{
+	if (_removalSubscribers.empty())
+		return;
+
+	_pendingRemovals.push_back({ cacheEntry->GetImagePath(), width, height, tier, sizeInBytes, GetRemovalReason() });
+	_hasPendingRemovals = true;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::QueueEntryRemoval(const std::filesystem::path& imagePath, const ImageCacheEntry<TImage>* cacheEntry)
+{
+	if (_removalSubscribers.empty())
+		return;
+
+	_pendingRemovals.push_back({ imagePath, cacheEntry->SourceWidth, cacheEntry->SourceHeight, CacheRemovalTier::Entry, 0, GetRemovalReason() });
+	_hasPendingRemovals = true;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::NotifyRemovals()
+{
+	if (!_hasPendingRemovals)
+		return;
+
+	std::vector<CacheRemoval> removals;
+	std::vector<std::function<void(const std::vector<CacheRemoval>&)>> subscribers;
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		removals.swap(_pendingRemovals);
+		_hasPendingRemovals = false;
+		for (const auto& subscriber : _removalSubscribers)
+			subscribers.push_back(subscriber.second);
+	}
+
+	if (removals.empty())
+		return;
+
+	//the subscribers are copied, so that a callback can unsubscribe or subscribe without invalidating the iteration.
+	for (const auto& subscriber : subscribers)
+		subscriber(removals);
+}
+
+template<typename TImage>
+std::string ImageCache<TImage>::ResolveKey(const std::filesystem::path& imagePath, const std::string& pathString) const
+{
+	auto key = _canonicalizePaths ? _pathCanonicalizer.GetKey(imagePath) : pathString;
+	if (auto search = _pathAliases.find(key); search != _pathAliases.end())
+		return search->second;
+
+	return key;
+}
+
+template<typename TImage>
+void ImageCache<TImage>::AddPathAlias(const std::string& path, const std::string& key, ImageCacheEntry<TImage>* cacheEntry)
+{
+	if (path == key || _pathAliases.contains(path))
+		return;
+
+	_pathAliases[path] = key;
+	cacheEntry->PathAliases.push_back(path);
+	AccountMetadata(cacheEntry, GetAliasMetadataSize(path, key));
 }
 
 
@@ -18,29 +973,47 @@ template<typename TImage>
 ImageCaching::TryGetImageResult ImageCache<TImage>::TryGetImage(
 	const std::filesystem::path& imagePath,
 	std::shared_ptr<const TImage>& outImage,
-	const IImageSource*& outSourceImage)
+	std::shared_ptr<const IImageSource>& outSourceImage)
+{
+	return TryGetImage(imagePath, imagePath.string(), std::nullopt, outImage, outSourceImage);
+}
+
+template<typename TImage>
+ImageCaching::TryGetImageResult ImageCache<TImage>::TryGetImage(
+	const std::filesystem::path& imagePath,
+	const std::string& pathString,
+	const std::optional<ImageId> imageId,
+	std::shared_ptr<const TImage>& outImage,
+	std::shared_ptr<const IImageSource>& outSourceImage)
 {
 	using namespace ImageCaching;
+
+	const bool useThreadLocalLookup = imageId && _useThreadLocalLookup;
+	if (useThreadLocalLookup && TryGetThreadLocalImage(*imageId, 0, 0, outImage, outSourceImage))
+		return TryGetImageResult::FoundExactMatch;
+
+	const RemovalNotificationScope removalScope(*this);
 	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
 
-	const auto key = imagePath.string();
-	if (auto search = _images.find(key); search != _images.end())
+	//the image at the size it was loaded from path is stored as a resized image at the source dimensions.
+	const auto key = ResolveKey(imagePath, pathString);
+	if (auto search = _images.find(key); search != _images.end() && search->second->SourceWidth > 0)
 	{
-		ImageCacheEntry<TImage>* cacheEntry = search->second;
-		outSourceImage = cacheEntry->SourceImage;
-
-		ImageCacheItem<TImage>* resized = cacheEntry->TryGetResizedImageCacheItem(outImage->GetWidth(), outImage->GetHeight());
-		if (resized)
-		{
-			outImage = resized->GetImage();
-			return TryGetImageResult::FoundExactMatch;
-		}
+		auto* cacheEntry = search->second;
+		const auto result = TryGetImageAtSize(imagePath, pathString, imageId, cacheEntry->SourceWidth, cacheEntry->SourceHeight, outImage,
+			outSourceImage);
+		if (useThreadLocalLookup && result == TryGetImageResult::FoundExactMatch)
+			PutThreadLocalImage(cacheEntry, *imageId, 0, 0, outImage);
 
-		return TryGetImageResult::FoundSourceImageOfDifferentDimensions;
+		return result;
 	}
 
+	if (_admissionFilter)
+		_admissionFilter->RecordAccess(key);
+
 	outImage = nullptr;
-	return TryGetImageResult::NotFound;
+	outSourceImage = nullptr;
+	return TryGetStoredSourceImage(imagePath, outSourceImage);
 }
 
 template<typename TImage>
@@ -49,144 +1022,746 @@ ImageCaching::TryGetImageResult ImageCache<TImage>::TryGetImageAtSize(
 	unsigned int width, 
 	unsigned int height,
 	std::shared_ptr<const TImage>& outImage,
-	const IImageSource*& outSourceImage)
+	std::shared_ptr<const IImageSource>& outSourceImage)
+{
+	return TryGetImageAtSize(imagePath, imagePath.string(), std::nullopt, width, height, outImage, outSourceImage);
+}
+
+template<typename TImage>
+ImageCaching::TryGetImageResult ImageCache<TImage>::TryGetImageAtSize(
+	const std::filesystem::path& imagePath,
+	const std::string& pathString,
+	const std::optional<ImageId> imageId,
+	unsigned int width,
+	unsigned int height,
+	std::shared_ptr<const TImage>& outImage,
+	std::shared_ptr<const IImageSource>& outSourceImage)
 {
 	using namespace ImageCaching;
+
+	const bool useThreadLocalLookup = imageId && _useThreadLocalLookup;
+	if (useThreadLocalLookup && TryGetThreadLocalImage(*imageId, width, height, outImage, outSourceImage))
+		return TryGetImageResult::FoundExactMatch;
+
+	//restoring a spilled source can evict other images to make room for it.
+	const RemovalNotificationScope removalScope(*this);
 	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
 
 	//Check if the image is in the cache at its source size
-	const auto key = imagePath.string();
+	const auto key = ResolveKey(imagePath, pathString);
+	if (_admissionFilter)
+		_admissionFilter->RecordAccess(key);
+
+	outImage = nullptr;
+	outSourceImage = nullptr;
+
 	if (auto search = _images.find(key); search != _images.end())
 	{
 		ImageCacheEntry<TImage>* cacheEntry = search->second;
-		outSourceImage = cacheEntry->SourceImage;
+		OnEntryAccessed(cacheEntry);
 
 		auto* resized = cacheEntry->TryGetResizedImageCacheItem(width, height);
+		if (!cacheEntry->SourceImage && cacheEntry->IsSourceSpilled() && !resized)
+			TryRestoreSpilledSource(cacheEntry);
+
+		outSourceImage = cacheEntry->GetResizeSource(width, height);
+
 		if (resized)
 		{
+			++resized->AccessCount;
+			if (resized->IsRetained())
+			{
+				//hand the retained image back out, it is retained again when this new shared pointer is released.
+				if (!resized->IsPinned)
+					_retainedMemoryUsage -= resized->SizeInBytes;
+
+				outImage = resized->Reacquire([this](const TImage* image) { return make_shared_with_callback(image); });
+				ReindexItem(cacheEntry, resized);
+				if (useThreadLocalLookup)
+					PutThreadLocalImage(cacheEntry, *imageId, width, height, outImage);
+
+				return TryGetImageResult::FoundExactMatch;
+			}
+
+			//the image can expire between its last reference being released and the cache being informed of it.
 			outImage = resized->GetImage();
-			return TryGetImageResult::FoundExactMatch;
+			if (outImage)
+			{
+				if (useThreadLocalLookup)
+					PutThreadLocalImage(cacheEntry, *imageId, width, height, outImage);
+
+				return TryGetImageResult::FoundExactMatch;
+			}
+		}
+
+		if (_sizeTolerance > 0.0)
+		{
+			outImage = TryGetImageWithinTolerance(cacheEntry, width, height);
+			if (outImage)
+			{
+				if (useThreadLocalLookup)
+					PutThreadLocalImage(cacheEntry, *imageId, width, height, outImage);
+
+				return TryGetImageResult::FoundExactMatch;
+			}
 		}
 
+		if constexpr (PixelReadableImage<TImage>)
+		{
+			//a copy is only worth resizing from if it is smaller than the source or mipmap level that would be used otherwise.
+			const auto maxArea = outSourceImage
+				? static_cast<int64_t>(outSourceImage->GetWidth()) * outSourceImage->GetHeight()
+				: std::numeric_limits<int64_t>::max();
+
+			outImage = TryGetSmallestLargerImage(cacheEntry, width, height, maxArea);
+			if (outImage)
+				return TryGetImageResult::FoundLargerImageOfDifferentDimensions;
+		}
+
+		//the source was evicted, it has to be loaded from path again to create a copy at a new size.
+		if (!outSourceImage)
+			return TryGetStoredSourceImage(imagePath, outSourceImage);
+
 		return TryGetImageResult::FoundSourceImageOfDifferentDimensions;
 	}
 
+	return TryGetStoredSourceImage(imagePath, outSourceImage);
+}
+
+template<typename TImage>
+ImageCaching::TryGetImageResult ImageCache<TImage>::TryGetImageByContent(
+	const std::filesystem::path& imagePath,
+	const uint64_t contentHash,
+	const std::vector<unsigned char>& encodedBytes,
+	const unsigned int width,
+	const unsigned int height,
+	std::shared_ptr<const TImage>& outImage,
+	std::shared_ptr<const IImageSource>& outSourceImage)
+{
+	using namespace ImageCaching;
 	outImage = nullptr;
-	return TryGetImageResult::NotFound;
+	outSourceImage = nullptr;
+
+	if (contentHash == 0)
+		return TryGetImageResult::NotFound;
+
+	//different files can share a hash, so the contents of the entry are compared before the path becomes its alias.
+	std::string key;
+	std::filesystem::path candidatePath;
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		const auto contentSearch = _contentKeys.find(contentHash);
+		if (contentSearch == _contentKeys.end())
+			return TryGetImageResult::NotFound;
+
+		key = contentSearch->second;
+		const auto* cacheEntry = _images.at(key);
+		if (cacheEntry->ContentSize != 0 && cacheEntry->ContentSize != encodedBytes.size())
+			return TryGetImageResult::NotFound;
+
+		if (cacheEntry->EncodedBytes)
+		{
+			if (*cacheEntry->EncodedBytes != encodedBytes)
+				return TryGetImageResult::NotFound;
+		}
+		else
+			candidatePath = cacheEntry->GetImagePath();
+	}
+
+	//the file of the entry is read without holding the lock, which is still far cheaper than decoding the image again.
+	if (!candidatePath.empty() && !ContentHasher::IsFileContent(candidatePath, encodedBytes.data(), encodedBytes.size()))
+		return TryGetImageResult::NotFound;
+
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+
+	//the entry may have been removed while its file was compared.
+	const auto contentSearch = _contentKeys.find(contentHash);
+	if (contentSearch == _contentKeys.end() || contentSearch->second != key)
+		return TryGetImageResult::NotFound;
+
+	AddPathAlias(GetPathKey(imagePath), key, _images.at(key));
+
+	if (width == 0 && height == 0)
+		return TryGetImage(imagePath, outImage, outSourceImage);
+
+	return TryGetImageAtSize(imagePath, width, height, outImage, outSourceImage);
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryGetEncodedImage(const std::filesystem::path& imagePath,
+	std::shared_ptr<const std::vector<unsigned char>>& outEncodedBytes)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+
+	outEncodedBytes = nullptr;
+	const auto search = _images.find(ResolveKey(imagePath));
+	if (search == _images.end() || !search->second->EncodedBytes)
+		return false;
+
+	outEncodedBytes = search->second->EncodedBytes;
+	return true;
+}
+
+template<typename TImage>
+std::shared_ptr<const TImage> ImageCache<TImage>::TryGetImageWithinTolerance(ImageCacheEntry<TImage>* cacheEntry,
+	const unsigned int width, const unsigned int height)
+{
+	//the distance of a copy is the sum of its relative differences per axis, so that neither axis dominates for wide images.
+	double closestDistance = std::numeric_limits<double>::max();
+
+	ImageCacheItem<TImage>* closest = nullptr;
+	std::shared_ptr<const TImage> result;
+	for (const auto& resized : cacheEntry->ResizedImages)
+	{
+		auto* item = resized.second;
+		const auto widthDifference = std::abs(item->Width - static_cast<double>(width)) / std::max(width, 1u);
+		const auto heightDifference = std::abs(item->Height - static_cast<double>(height)) / std::max(height, 1u);
+		const auto distance = widthDifference + heightDifference;
+		if (widthDifference > _sizeTolerance || heightDifference > _sizeTolerance || distance >= closestDistance)
+			continue;
+
+		if (item->IsRetained())
+		{
+			closest = item;
+			result = nullptr;
+			closestDistance = distance;
+		}
+		else if (auto image = item->GetImage())
+		{
+			closest = item;
+			result = std::move(image);
+			closestDistance = distance;
+		}
+	}
+
+	if (closest)
+		++closest->AccessCount;
+
+	if (closest && closest->IsRetained())
+	{
+		if (!closest->IsPinned)
+			_retainedMemoryUsage -= closest->SizeInBytes;
+
+		result = closest->Reacquire([this](const TImage* image) { return make_shared_with_callback(image); });
+		ReindexItem(cacheEntry, closest);
+	}
+
+	return result;
+}
+
+template<typename TImage>
+std::shared_ptr<const TImage> ImageCache<TImage>::TryGetSmallestLargerImage(ImageCacheEntry<TImage>* cacheEntry,
+	const unsigned int width, const unsigned int height, const int64_t maxArea)
+{
+	int64_t smallestArea = maxArea;
+
+	ImageCacheItem<TImage>* smallest = nullptr;
+	std::shared_ptr<const TImage> result;
+	for (const auto& resized : cacheEntry->ResizedImages)
+	{
+		auto* item = resized.second;
+		const auto area = static_cast<int64_t>(item->Width) * item->Height;
+		if (item->Width < static_cast<int>(width) || item->Height < static_cast<int>(height) || area >= smallestArea)
+			continue;
+
+		if (item->IsRetained())
+		{
+			smallest = item;
+			result = nullptr;
+			smallestArea = area;
+		}
+		else if (auto image = item->GetImage())
+		{
+			smallest = item;
+			result = std::move(image);
+			smallestArea = area;
+		}
+	}
+
+	if (smallest && smallest->IsRetained())
+	{
+		if (!smallest->IsPinned)
+			_retainedMemoryUsage -= smallest->SizeInBytes;
+
+		result = smallest->Reacquire([this](const TImage* image) { return make_shared_with_callback(image); });
+		ReindexItem(cacheEntry, smallest);
+	}
+
+	return result;
+}
+
+template<typename TImage>
+std::vector<std::shared_ptr<const IImageSource>> ImageCache<TImage>::BuildMipLevels(const IImageSource& sourceImage)
+{
+	std::vector<std::shared_ptr<const IImageSource>> result;
+
+	const unsigned char* pixels = sourceImage.GetPixels();
+	int width = sourceImage.GetWidth();
+	int height = sourceImage.GetHeight();
+	while (width > 1 || height > 1)
+	{
+		int levelWidth, levelHeight;
+		const auto* levelPixels = ImageResampler::DownsampleByHalf(pixels, width, height, levelWidth, levelHeight);
+		result.push_back(std::make_shared<ImageSource>(sourceImage.GetImagePath(), levelWidth, levelHeight, levelPixels));
+
+		pixels = levelPixels;
+		width = levelWidth;
+		height = levelHeight;
+	}
+
+	return result;
 }
 
 template<typename TImage>
-ImageCaching::TryAddImageResult ImageCache<TImage>::TryAddSourceImage(const IImageSource* image)
+ImageCaching::TryAddImageResult ImageCache<TImage>::TryAddSourceImage(std::shared_ptr<const IImageSource> image,
+	const ImageCaching::CacheInsertInfo& insertInfo)
 {
 	using namespace ImageCaching;
 
 	if (!image)
 		return TryAddImageResult::NoChange;
 
+	//built before taking the lock so that other threads are not blocked while downsampling, even though the levels are discarded
+	//if the source image is not added.
+	std::vector<std::shared_ptr<const IImageSource>> mipLevels;
+	if (_generateMipmaps)
+		mipLevels = BuildMipLevels(*image);
+
+	const RemovalNotificationScope removalScope(*this);
 	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
 
-	const auto key = image->GetImagePath().string();
+	//with a shared store the pixels are held by the store, but the entry records the dimensions of the source, so that requests
+	//for the source size are served by the resized image that is added at that size.
+	if (_sourceImageStore)
+	{
+		const auto imagePath = image->GetImagePath();
+		const auto width = image->GetWidth();
+		const auto height = image->GetHeight();
+		const auto result = _sourceImageStore->TryAddSourceImage(std::move(image), insertInfo.CreationCost);
+		if (result == TryAddImageResult::Added || result == TryAddImageResult::NoChange)
+			RecordStoredSourceDimensions(imagePath, width, height, insertInfo.Namespace);
+
+		return result;
+	}
+
+	auto key = ResolveKey(image->GetImagePath());
+	auto imageSize = image->GetSizeInBytes();
+	for (const auto& mipLevel : mipLevels)
+		imageSize += mipLevel->GetSizeInBytes();
+
+	//a byte identical file under a different path is stored in the entry of the path that was added first. The contents are only
+	//known to be identical, rather than to share a hash, when both are held in memory.
+	if (insertInfo.ContentHash != 0 && insertInfo.EncodedBytes && !_images.contains(key))
+	{
+		if (auto contentSearch = _contentKeys.find(insertInfo.ContentHash); contentSearch != _contentKeys.end()
+			&& _images.at(contentSearch->second)->EncodedBytes && *_images.at(contentSearch->second)->EncodedBytes == *insertInfo.EncodedBytes)
+		{
+			AddPathAlias(key, contentSearch->second, _images.at(contentSearch->second));
+			key = contentSearch->second;
+		}
+	}
 
+	ImageCacheEntry<TImage>* existingEntry = nullptr;
 	if (auto search = _images.find(key); search != _images.end())
 	{
+		existingEntry = search->second;
+
 		//TODO: zoea 28/11/2024 implement an affordance to inform the caller that a source image already existed in the cache, but was
 		//not the same instance of source data. Facilitating either updating the source image and all instances at each size, or to delete the duplicate 
 		//load
-		return TryAddImageResult::NoChange;
+		if (existingEntry->SourceImage)
+			return TryAddImageResult::NoChange;
+	}
+
+	if (existingEntry)
+	{
+		auto* cacheNamespace = existingEntry->Namespace;
+		if (!TryMakeRoomInNamespace(imageSize, existingEntry, cacheNamespace) || !TryMakeRoomForSource(imageSize, existingEntry, cacheNamespace)
+			|| !TryMakeRoom(imageSize, existingEntry, cacheNamespace))
+			return TryAddImageResult::OutOfMemory;
+
+		//restore the evicted source of an entry which still holds resized images, or add the source to an entry created without one.
+		ReleaseSpilledSource(existingEntry);
+		existingEntry->SourceWidth = image->GetWidth();
+		existingEntry->SourceHeight = image->GetHeight();
+		existingEntry->SourceImage = std::move(image);
+		existingEntry->MipLevels = std::move(mipLevels);
+		existingEntry->SourceCreationCost = insertInfo.CreationCost;
+		AccountEntryBytes(existingEntry, imageSize);
+
+		_currentMemoryUsage += imageSize;
+		_sourceMemoryUsage += imageSize;
+		OnEntryAccessed(existingEntry);
+		KeepEncodedBytes(existingEntry, insertInfo.EncodedBytes);
+		return TryAddImageResult::Added;
 	}
 
-	const auto imageSize = image->GetSizeInBytes();
-	if (_currentMemoryUsage + imageSize > _maxAllowedMemory)
+	//the entry holds the handle of its path, which a path table with every slot in use has no room for.
+	auto& pathTable = ImagePathTable::GetShared();
+	ImageId imageId;
+	if (!pathTable.TryIntern(image->GetImagePath(), imageId))
+		return TryAddImageResult::OutOfMemory;
+
+	bool inAdmissionWindow;
+	if (!TryAdmit(key, nullptr, imageSize, inAdmissionWindow))
+	{
+		pathTable.Release(imageId);
+		return TryAddImageResult::NotAdmitted;
+	}
+
+	auto* cacheNamespace = FindNamespace(insertInfo.Namespace);
+	if (!TryMakeRoomInNamespace(imageSize, nullptr, cacheNamespace) || !TryMakeRoomForSource(imageSize, nullptr, cacheNamespace)
+		|| !TryMakeRoom(imageSize + GetEntryMetadataSize(key), nullptr, cacheNamespace))
 	{
+		if (inAdmissionWindow)
+			_admissionWindowMemoryUsage -= imageSize;
+
+		pathTable.Release(imageId);
 		return TryAddImageResult::OutOfMemory;
 	}
 
 	_currentMemoryUsage += imageSize;
-	auto* entry = new ImageCacheEntry<TImage>(image);
+	_sourceMemoryUsage += imageSize;
+	auto* entry = new ImageCacheEntry<TImage>(imageId, std::move(image));
+	entry->Key = key;
+	AccountMetadata(entry, GetEntryMetadataSize(key));
+	entry->InAdmissionWindow = inAdmissionWindow;
+	entry->SizeInBytes = imageSize;
+	entry->Namespace = cacheNamespace;
+	if (cacheNamespace)
+		cacheNamespace->MemoryUsage += imageSize;
+
+	entry->MipLevels = std::move(mipLevels);
+	entry->SourceCreationCost = insertInfo.CreationCost;
+	OnEntryAccessed(entry);
 	_images[key] = entry;
+
+	//the first entry with a hash owns it, so that removing a later entry with a colliding hash leaves the mapping in place.
+	if (insertInfo.ContentHash != 0 && _contentKeys.try_emplace(insertInfo.ContentHash, key).second)
+	{
+		entry->ContentHash = insertInfo.ContentHash;
+		entry->ContentSize = insertInfo.EncodedBytes ? insertInfo.EncodedBytes->size() : 0;
+		AccountMetadata(entry, GetContentKeyMetadataSize(key));
+	}
+
+	KeepEncodedBytes(entry, insertInfo.EncodedBytes);
 	return TryAddImageResult::Added;
 }
 
 template<typename TImage>
-ImageCaching::TryAddImageResult ImageCache<TImage>::TryAddImage(std::shared_ptr<const TImage> image, const TImage*& outImage)
+ImageCaching::TryAddImageResult ImageCache<TImage>::TryAddImage(std::shared_ptr<const TImage> image,
+	const ImageCaching::CacheInsertInfo& insertInfo, const TImage*& outImage)
 {
 	using namespace ImageCaching;
 	
+	const RemovalNotificationScope removalScope(*this);
 	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
 
 	outImage = nullptr;
-	const auto key = image->GetImagePath().string();
+	const auto key = ResolveKey(image->GetImagePath());
+
+	//an image created without decoding its source, e.g. read from a thumbnail store, starts an entry without a source.
+	bool isNewEntry = false;
+	auto search = _images.find(key);
+	if (search == _images.end())
+	{
+		ImageId imageId;
+		if (!ImagePathTable::GetShared().TryIntern(image->GetImagePath(), imageId))
+			return TryAddImageResult::OutOfMemory;
 
+		search = _images.emplace(key, new ImageCacheEntry<TImage>(imageId)).first;
+		search->second->Key = key;
+		AccountMetadata(search->second, GetEntryMetadataSize(key));
+		isNewEntry = true;
+	}
+
+	auto* cacheNamespace = FindNamespace(insertInfo.Namespace);
+	if (isNewEntry)
+		search->second->Namespace = cacheNamespace;
 
-	if (auto search = _images.find(key); search != _images.end())
 	{
 		ImageCacheEntry<TImage>* cacheEntry = search->second;
-		const IImageSource* sourceImage = cacheEntry->SourceImage;
-
 
 		const auto resizedImageKey = ResizedImageKey(image->GetWidth(), image->GetHeight()).ToStringKey();
 
 		//If there are copies of the image at different sizes, check for a match.
-		const auto& resizedImages = cacheEntry->ResizedImages;
+		bool isPinned = false;
+		auto& resizedImages = cacheEntry->ResizedImages;
 		if (auto resizedSearch = resizedImages.find(resizedImageKey); resizedSearch != resizedImages.end())
 		{
 			auto* resizedImageItem = resizedSearch->second;
-			const auto* resizedImage = resizedImageItem->GetImage().get();
+			const auto resizedImage = resizedImageItem->GetImage();
 
-			if (resizedImage == image.get())
+			if (resizedImage)
 			{
-				outImage = image.get();
+				outImage = resizedImage.get();
 				return TryAddImageResult::NoChange;
 			}
 
-			if (resizedImage->GetWidth() == image.get()->GetWidth() &&
-				resizedImage->GetHeight() == image.get()->GetHeight())
-			{
-				outImage = image.get();
-				return TryAddImageResult::NoChange;
-			}
+			//the cached instance has been released, or retained, after this image was requested. Replace it, keeping it pinned.
+			isPinned = resizedImageItem->IsPinned;
+			ReleaseResizedImageItem(cacheEntry, resizedSearch);
 		}
 
 		const auto imageSize = image->GetSizeInBytes();
-		if (_currentMemoryUsage + imageSize > _maxAllowedMemory)
+		bool inAdmissionWindow;
+		if (!TryAdmit(key, isNewEntry ? nullptr : cacheEntry, imageSize, inAdmissionWindow))
+		{
+			if (isNewEntry || cacheEntry->IsEmpty())
+				RemoveEntry(key, cacheEntry);
+
+			return TryAddImageResult::NotAdmitted;
+		}
+
+		if (isNewEntry)
+			cacheEntry->InAdmissionWindow = inAdmissionWindow;
+
+		if (!TryMakeRoomInNamespace(imageSize, cacheEntry, cacheNamespace) || !TryMakeRoomForResized(imageSize, cacheEntry, cacheNamespace)
+			|| !TryMakeRoom(imageSize + GetItemMetadataSize(resizedImageKey), cacheEntry, cacheNamespace))
 		{
+			if (inAdmissionWindow)
+				_admissionWindowMemoryUsage -= imageSize;
+
+			if (isNewEntry || cacheEntry->IsEmpty())
+				RemoveEntry(key, cacheEntry);
+
 			return TryAddImageResult::OutOfMemory;
 		}
 
 		//image is a resized version not in the cache, add it.
 		std::weak_ptr<const TImage> weakPtr = image;
-		cacheEntry->ResizedImages[resizedImageKey] = new ImageCacheItem<TImage>(weakPtr);
-		_currentMemoryUsage += image->GetSizeInBytes();
+		auto* item = new ImageCacheItem<TImage>(weakPtr, imageSize, insertInfo.CreationCost);
+		cacheEntry->ResizedImages[resizedImageKey] = item;
+		AccountMetadata(cacheEntry, GetItemMetadataSize(resizedImageKey));
+		cacheEntry->SizeInBytes += imageSize;
+		_currentMemoryUsage += imageSize;
+		_resizedMemoryUsage += imageSize;
+		item->Namespace = cacheNamespace;
+		if (cacheNamespace)
+			cacheNamespace->MemoryUsage += imageSize;
+
+		if (isPinned)
+		{
+			item->IsPinned = true;
+			_pinnedMemoryUsage += imageSize;
+		}
+
+		if constexpr (PixelReadableImage<TImage>)
+		{
+			//a copy that covers little of the source, e.g. a thumbnail, cannot serve the larger sizes the source still can.
+			const auto copyArea = static_cast<double>(image->GetWidth()) * image->GetHeight();
+			const auto sourceArea = static_cast<double>(cacheEntry->SourceWidth) * cacheEntry->SourceHeight;
+			if (_evictSourceOnceResized && cacheEntry->SourceImage && !cacheEntry->IsSourcePinned
+				&& copyArea >= sourceArea * _evictSourceMinimumCopyArea)
+				EvictSourceImage(key, cacheEntry);
+		}
+
+		if (isNewEntry)
+			OnEntryAccessed(cacheEntry);
+
+		return isNewEntry ? TryAddImageResult::Added : TryAddImageResult::AddedAsResizedImage;
+	}
+}
+
+template<typename TImage>
+void ImageCache<TImage>::RecordStoredSourceDimensions(const std::filesystem::path& imagePath, const int width, const int height,
+	const std::string& namespaceName)
+{
+	const auto key = ResolveKey(imagePath);
+	auto search = _images.find(key);
+	if (search == _images.end())
+	{
+		//the entry is filled by the resized image added from the stored source, and is removed if that image is not added. Without
+		//a handle for the path the entry is left to be created by that image instead.
+		ImageId imageId;
+		if (!ImagePathTable::GetShared().TryIntern(imagePath, imageId))
+			return;
+
+		search = _images.emplace(key, new ImageCacheEntry<TImage>(imageId)).first;
+		search->second->Key = key;
+		search->second->Namespace = FindNamespace(namespaceName);
+		AccountMetadata(search->second, GetEntryMetadataSize(key));
+		OnEntryAccessed(search->second);
+	}
+
+	search->second->SourceWidth = width;
+	search->second->SourceHeight = height;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::Pin(const std::filesystem::path& imagePath, const unsigned int width, const unsigned int height)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	const auto search = _images.find(ResolveKey(imagePath));
+	if (search == _images.end())
+		return false;
+
+	auto* cacheEntry = search->second;
+	if (width == 0 && height == 0)
+	{
+		if (cacheEntry->IsSourcePinned)
+			return true;
+
+		const auto sourceSize = cacheEntry->GetSourceSizeInBytes();
+		if (!cacheEntry->SourceImage || _pinnedMemoryUsage + sourceSize > _maxPinnedMemory)
+			return false;
+
+		cacheEntry->IsSourcePinned = true;
+		_pinnedMemoryUsage += sourceSize;
+		ReindexEntry(cacheEntry);
+		return true;
+	}
+
+	auto* item = cacheEntry->TryGetResizedImageCacheItem(width, height);
+	if (!item)
+		return false;
+
+	if (item->IsPinned)
+		return true;
+
+	if (_pinnedMemoryUsage + item->SizeInBytes > _maxPinnedMemory)
+		return false;
+
+	//a retained image moves from the retention budget to the pinned budget.
+	if (item->IsRetained())
+		_retainedMemoryUsage -= item->SizeInBytes;
+
+	item->IsPinned = true;
+	_pinnedMemoryUsage += item->SizeInBytes;
+	ReindexItem(cacheEntry, item);
+	return true;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::Unpin(const std::filesystem::path& imagePath, const unsigned int width, const unsigned int height)
+{
+	const RemovalNotificationScope removalScope(*this);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	const auto search = _images.find(ResolveKey(imagePath));
+	if (search == _images.end())
+		return false;
+
+	auto* cacheEntry = search->second;
+	if (width == 0 && height == 0)
+	{
+		if (!cacheEntry->IsSourcePinned)
+			return false;
+
+		cacheEntry->IsSourcePinned = false;
+		_pinnedMemoryUsage -= cacheEntry->GetSourceSizeInBytes();
+		ReindexEntry(cacheEntry);
+		return true;
+	}
+
+	auto* item = cacheEntry->TryGetResizedImageCacheItem(width, height);
+	if (!item || !item->IsPinned)
+		return false;
+
+	item->IsPinned = false;
+	_pinnedMemoryUsage -= item->SizeInBytes;
+	ReindexItem(cacheEntry, item);
+	if (item->IsRetained())
+	{
+		//this may evict the image that was just unpinned, if it has the lowest priority or the retention budget is 0.
+		_retainedMemoryUsage += item->SizeInBytes;
+		while (_retainedMemoryUsage > _maxRetainedMemory && TryEvictLowestPriority(nullptr, RetainedImages))
+		{
+		}
+	}
+
+	return true;
+}
+
+template<typename TImage>
+std::vector<CacheSnapshotEntry> ImageCache<TImage>::GetHotImages(const size_t maxCount)
+{
+	std::vector<CacheSnapshotEntry> result;
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+		for (const auto& image : _images)
+		{
+			FoldThreadLocalHits(image.first, image.second);
+			for (const auto& resized : image.second->ResizedImages)
+			{
+				const auto* item = resized.second;
+				result.push_back({ image.first, item->Width, item->Height, item->AccessCount });
+			}
+		}
+	}
+
+	CacheSnapshot::SortByAccessCount(result);
+	if (result.size() > maxCount)
+		result.resize(maxCount);
+
+	return result;
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::ContainsImage(const std::filesystem::path& imagePath)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	return _images.contains(ResolveKey(imagePath));
+}
+
+template<typename TImage>
+bool ImageCache<TImage>::TryInvalidateImage(const std::filesystem::path& imagePath)
+{
+	const RemovalNotificationScope removalScope(*this, CacheRemovalReason::Invalidated);
+	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
+	const auto path = GetPathKey(imagePath);
+	if (_sourceImageStore)
+		_sourceImageStore->TryRemoveSourceImage(imagePath);
+
+	//a replaced file has a new identity, the paths that linked to the old file are resolved again.
+	if (_canonicalizePaths)
+		_pathCanonicalizer.Invalidate(imagePath);
+
+	//the file no longer matches the content of the entry it was an alias of, the entry itself is still valid for its own path.
+	if (auto aliasSearch = _pathAliases.find(path); aliasSearch != _pathAliases.end())
+	{
+		auto* cacheEntry = _images.at(aliasSearch->second);
+		auto& aliases = cacheEntry->PathAliases;
+		aliases.erase(std::remove(aliases.begin(), aliases.end(), path), aliases.end());
+		AccountMetadata(cacheEntry, -GetAliasMetadataSize(path, aliasSearch->second));
+		QueueEntryRemoval(path, cacheEntry);
+		_pathAliases.erase(aliasSearch);
+		ThreadLocalImageLookup<TImage>::Invalidate();
+		return true;
+	}
 
-		return TryAddImageResult::AddedAsResizedImage;
+	//referenced images are orphaned, they no longer find an entry when they are released and are deleted then.
+	if (auto search = _images.find(path); search != _images.end())
+	{
+		RemoveEntry(path, search->second);
+		return true;
 	}
 
-	throw std::runtime_error("Cannot add image without first adding its imageSource");
-	return TryAddImageResult::NoChange;
+	return false;
 }
 
 template<typename TImage>
 bool ImageCache<TImage>::TryRemoveImage(const TImage* image)
 {
+	const RemovalNotificationScope removalScope(*this, CacheRemovalReason::Removed);
 	std::lock_guard<std::recursive_mutex> lockGuard(_cacheLock);
-	const auto key = image->GetImagePath().string();
+	const auto key = ResolveKey(image->GetImagePath());
 	bool removed = false;
 
 	if (auto search = _images.find(key); search != _images.end())
 	{
 		ImageCacheEntry<TImage>* cacheEntry = search->second;
 		const auto resizedImageKey = ResizedImageKey(image->GetWidth(), image->GetHeight()).ToStringKey();
-		const auto removedCount = cacheEntry->ResizedImages.erase(resizedImageKey);
-		_currentMemoryUsage -= image->GetSizeInBytes() * removedCount;
-		removed = removedCount > 0;
 
-		if (cacheEntry->ResizedImages.empty())
+		//only remove the item if it is this instance, an image which was not admitted may share the size of a cached one.
+		auto& resizedImages = cacheEntry->ResizedImages;
+		if (auto resizedSearch = resizedImages.find(resizedImageKey);
+			resizedSearch != resizedImages.end() && resizedSearch->second->IsInstance(image))
 		{
-			_currentMemoryUsage -= cacheEntry->SourceImage->GetSizeInBytes();
-			_images.erase(key);
-			delete cacheEntry;
+			RemoveResizedImage(key, cacheEntry, resizedImageKey);
+			removed = true;
 		}
 	} 
 
 	return removed;
-}
+}
\ No newline at end of file
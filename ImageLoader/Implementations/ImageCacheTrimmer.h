@@ -0,0 +1,99 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "ImageCache.h"
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Trims the idle entries of an <see cref="ImageCache"/> on a low priority background thread, see
+/// <see cref="ImageCache::SetIdleTimeout"/>. Each interval the trimmer visits every entry of the cache once, a small batch at a time
+/// with a pause between batches, so that the memory of the cache follows its working set without the cache being locked for long
+/// enough to delay requests.
+/// </summary>
+template<typename TImage>
+class ImageCacheTrimmer final
+{
+	ImageCache<TImage>& _cache;
+	const std::chrono::milliseconds _interval;
+	const size_t _batchSize;
+	const std::chrono::milliseconds _batchPause;
+	std::mutex _lock;
+	std::condition_variable _wake;
+	bool _stop = false;
+	std::thread _thread;
+
+	/// <summary>
+	/// Waits for the duration, or until the trimmer is stopped.
+	/// </summary>
+	/// <returns>False if the trimmer was stopped.</returns>
+	bool TryWait(const std::chrono::milliseconds duration)
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		return !_wake.wait_for(lock, duration, [this] { return _stop; });
+	}
+
+	void Run()
+	{
+#if defined(__linux__)
+		//on Linux the nice value of a thread id applies to that thread only.
+		setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+
+		while (TryWait(_interval))
+		{
+			const auto entryCount = _cache.GetCacheEntryCount();
+			for (size_t visited = 0; visited < entryCount; visited += _batchSize)
+			{
+				_cache.TrimIdleEntries(_batchSize);
+				if (!TryWait(_batchPause))
+					return;
+			}
+		}
+	}
+
+public:
+	/// <summary>
+	/// Starts trimming the cache, which must outlive the trimmer.
+	/// </summary>
+	/// <param name="cache">The cache to trim.</param>
+	/// <param name="interval">Time between passes over the entries of the cache.</param>
+	/// <param name="batchSize">Number of entries visited at a time.</param>
+	/// <param name="batchPause">Time between batches, during which the cache is not locked by the trimmer.</param>
+	ImageCacheTrimmer(ImageCache<TImage>& cache, const std::chrono::milliseconds interval, const size_t batchSize = 64,
+		const std::chrono::milliseconds batchPause = std::chrono::milliseconds(1))
+		: _cache(cache)
+		, _interval(interval)
+		, _batchSize(batchSize)
+		, _batchPause(batchPause)
+	{
+		if (batchSize == 0)
+			throw std::runtime_error("Batch size must be at least 1");
+
+		_thread = std::thread(&ImageCacheTrimmer::Run, this);
+	}
+
+	/// <summary>
+	/// Stops trimming, waiting for the batch being trimmed to complete.
+	/// </summary>
+	~ImageCacheTrimmer()
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(_lock);
+			_stop = true;
+		}
+
+		_wake.notify_all();
+		_thread.join();
+	}
+
+	ImageCacheTrimmer(const ImageCacheTrimmer&) = delete;
+	ImageCacheTrimmer& operator=(const ImageCacheTrimmer&) = delete;
+};
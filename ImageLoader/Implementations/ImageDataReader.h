@@ -3,7 +3,9 @@
 #include <future>
 #include <cassert>
 #include <filesystem>
+#include <vector>
 #include "Assert.h"
+#include "FileStatCache.h"
 
 
 /// <summary>
@@ -11,14 +13,50 @@
 /// </summary>
 class ImageDataReader final : public IImageDataReader
 {
+	mutable FileStatCache _fileStatCache;
+
 public:
 	/// <summary>
-	/// Reads the data for an image file from a path. Returns null if the file is not found.
+	/// Gets the cache of filesystem queries made by this reader. Paths which were recently found to be missing or undecodable are
+	/// read as null without touching the filesystem.
+	/// </summary>
+	FileStatCache& GetFileStatCache() {
+		return _fileStatCache;
+	}
+
+	/// <summary>
+	/// Gets the cache of filesystem queries made by this reader.
+	/// </summary>
+	const FileStatCache& GetFileStatCache() const {
+		return _fileStatCache;
+	}
+
+	/// <summary>
+	/// Reads the data for an image file from a path. Returns null if the file is not found, or could not be decoded.
 	/// </summary>
 	/// <param name="filePath">The absolute path to the file.</param>
 	/// <returns>Image data with dimensions.</returns>
 	[[nodiscard]]
 	virtual ImageData* ReadFile(const std::filesystem::path& filePath) const override;
+
+	/// <summary>
+	/// Reads the encoded contents of an image file from a path without decoding it. Returns false if the file is not found, or was
+	/// previously found to be undecodable and has not changed since.
+	/// </summary>
+	/// <param name="filePath">The absolute path to the file.</param>
+	/// <param name="outBytes">The contents of the file.</param>
+	/// <returns>True if the file was read.</returns>
+	[[nodiscard]]
+	virtual bool TryReadFileBytes(const std::filesystem::path& filePath, std::vector<unsigned char>& outBytes) const override;
+
+	/// <summary>
+	/// Decodes image data from the encoded contents of an image file. Returns null if the contents could not be decoded.
+	/// </summary>
+	/// <param name="bytes">The encoded contents of the file.</param>
+	/// <param name="size">Number of bytes of encoded contents.</param>
+	/// <returns>Image data with dimensions.</returns>
+	[[nodiscard]]
+	virtual ImageData* ReadMemory(const unsigned char* bytes, size_t size) const override;
 };
 
 
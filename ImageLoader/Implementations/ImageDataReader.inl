@@ -1,4 +1,5 @@
 #include "ImageDataReader.h"
+#include <fstream>
 
 //per documentation from stb, these defines and include should only occur in a single file
 #define STB_IMAGE_IMPLEMENTATION
@@ -17,7 +18,8 @@ inline ImageData* ImageDataReader::ReadFile(const std::filesystem::path& filePat
 {
 	const auto filePathStr = filePath.string();
 
-	if (!std::filesystem::exists(filePathStr))
+	FileStat fileStat;
+	if (!_fileStatCache.TryGetStat(filePath, fileStat))
 		return nullptr;
 
 	//For now, we'll force 4 channels for consistency.
@@ -25,6 +27,46 @@ inline ImageData* ImageDataReader::ReadFile(const std::filesystem::path& filePat
 	int requiredChannelCount = 4;
 	int width, height, channelCount;
 	unsigned char* image = stbi_load(filePathStr.c_str(), &width, &height, &channelCount, requiredChannelCount);
+	if (!image)
+	{
+		_fileStatCache.MarkUndecodable(filePath);
+		return nullptr;
+	}
+
+	auto result = new ImageData(width, height, image);
+	return result;
+}
+
+inline bool ImageDataReader::TryReadFileBytes(const std::filesystem::path& filePath, std::vector<unsigned char>& outBytes) const
+{
+	FileStat fileStat;
+	if (!_fileStatCache.TryGetStat(filePath, fileStat))
+		return false;
+
+	std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		_fileStatCache.Invalidate(filePath);
+		return false;
+	}
+
+	const auto size = static_cast<size_t>(file.tellg());
+	outBytes.resize(size);
+	file.seekg(0, std::ios::beg);
+	if (size > 0 && !file.read(reinterpret_cast<char*>(outBytes.data()), static_cast<std::streamsize>(size)))
+		return false;
+
+	return true;
+}
+
+inline ImageData* ImageDataReader::ReadMemory(const unsigned char* bytes, const size_t size) const
+{
+	//For now, we'll force 4 channels for consistency, matching ReadFile.
+	int requiredChannelCount = 4;
+	int width, height, channelCount;
+	unsigned char* image = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &channelCount, requiredChannelCount);
+	if (!image)
+		return nullptr;
 
 	auto result = new ImageData(width, height, image);
 	return result;
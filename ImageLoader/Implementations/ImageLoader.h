@@ -1,14 +1,23 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <deque>
 #include <functional>
 #include <future>
+#include <map>
 #include <mutex>
 #include <string>
 #include <utility>
 
 #include "../Assert.h"
 #include "../Image.h"
+#include "CacheSnapshot.h"
 #include "ImageCache.h"
+#include "ImageDataReader.h"
+#include "ImagePathTable.h"
+#include "FileWatcher.h"
+#include "RequestTrace.h"
+#include "ThumbnailStore.h"
 #include "../ImageFactory.h"
 #include "../ImageLoader.h"
 
@@ -26,7 +35,33 @@ private:
 
 	ImageCaching::IImageCache<TImage>* _imageCache;
 	IImageFactory<TImage>* _imageFactory;
+	ImageDataReader _imageDataReader;
+	FileWatcher* _fileWatcher = nullptr;
+	uint64_t _fileWatchSubscription = 0;
+
+	/// <summary>
+	/// Whether the cache holds the watch of a spelling of a file path, see <see cref="UpdateFileWatch"/>.
+	/// </summary>
+	struct FileWatchState
+	{
+		bool IsHeldByCache = false;
+
+		/// <summary>
+		/// Ticket of the latest update applied, an update that looked at the cache before it is stale and is not applied.
+		/// </summary>
+		uint64_t AppliedTicket = 0;
+
+		int PendingUpdateCount = 0;
+	};
+
+	std::mutex _fileWatchMutex;
+	std::map<const std::string, FileWatchState> _fileWatchStates;
+	uint64_t _fileWatchTicket = 0;
+	ThumbnailStore* _thumbnailStore = nullptr;
+	RequestTraceRecorder* _requestTraceRecorder = nullptr;
 	int _maxThreadCount = 1;
+	bool _deduplicateByContent = false;
+	unsigned int _sizeBucket = 0;
 
 	std::thread* _updateThread = nullptr;
 	bool _updateThreadAbort = false;
@@ -34,18 +69,38 @@ private:
 
 	std::atomic<int> _runningThreadsCount = 0;
 
+	/// <summary>
+	/// Identifies a queued task, so that a request for an image and size that is already queued is served by that task. Warm up
+	/// tasks are keyed apart from requests, so that a request for the same image is queued as usual and gets its callback.
+	/// </summary>
+	struct TaskKey
+	{
+		ImageId Id;
+		int Width;
+		int Height;
+		bool IsWarmUp;
+
+		auto operator<=>(const TaskKey&) const = default;
+	};
+
 	class LoadImageTask
 	{
 
 	public:
-		std::string Identifier;
+		const TaskKey Key;
 		std::mutex Mutex;
 		std::condition_variable Condition;
-		const std::filesystem::path FilePath;
+
+		/// <summary>
+		/// Handle of the path of the image, whose reference the task holds. The path is only looked up to read the file.
+		/// </summary>
+		const ImageId Id;
 		int Width;
 		int Height;
-		const IImageSource* SourceImage = nullptr;
+		std::shared_ptr<const IImageSource> SourceImage;
+		bool SourceImageIsCached = true;
 		std::shared_ptr<const TImage> LoadedImage;
+		std::shared_ptr<const TImage> ResizeBaseImage;
 		ImageCaching::IImageCache<TImage>* ImageCache;
 		ImageLoader<TImage>* Loader;
 		std::function<void(const ImageLoadTaskResult<TImage>)> ReturnedCallback;
@@ -53,29 +108,70 @@ private:
 
 		bool IsStarted = false;
 
-		LoadImageTask(std::string identifier,
-			std::filesystem::path filePath, const int width, const int height,
+		/// <summary>
+		/// True if the task was queued by <see cref="WarmUp"/> rather than requested, in which case it runs at the lowest priority.
+		/// </summary>
+		bool IsWarmUp = false;
+
+		/// <summary>
+		/// The cache namespace the loaded images are accounted to, see <see cref="ImageCaching::CacheInsertInfo::Namespace"/>.
+		/// </summary>
+		std::string Namespace;
+
+		/// <summary>
+		/// When the task was queued, and the measured time spent decoding and resizing, as recorded by the loader's request trace.
+		/// </summary>
+		const std::chrono::steady_clock::time_point RequestTime = std::chrono::steady_clock::now();
+		bool IsSourceDecoded = false;
+		std::chrono::microseconds DecodeCost{ 0 };
+		std::chrono::microseconds ResizeCost{ 0 };
+
+		/// <param name="key">Key of the task, whose reference to the handle of the path is taken over by the task.</param>
+		LoadImageTask(const TaskKey key,
 			ImageLoader<TImage>* imageLoader,
 			ImageCaching::IImageCache<TImage>* imageCache,
 			std::function<void(const ImageLoadTaskResult<TImage>)> returnedCallback)
-			: Identifier(std::move(identifier))
-			, FilePath(std::move(filePath))
-			, Width(width)
-			, Height(height)
+			: Key(key)
+			, Id(key.Id)
+			, Width(key.Width)
+			, Height(key.Height)
 			, ImageCache(imageCache)
 			, Loader(imageLoader)
 			, ReturnedCallback(std::move(returnedCallback))
 		{
 		}
 
+		~LoadImageTask()
+		{
+			ImagePathTable::GetShared().Release(Id);
+		}
+
 		void StartAndDelete();
 	private:
+		[[nodiscard]]
+		const std::filesystem::path& GetFilePath() const
+		{
+			return ImagePathTable::GetShared().GetPath(Id);
+		}
+
 		[[nodiscard]]
 		ImageLoadTaskResult<TImage> Resize();
+
+		/// <summary>
+		/// Loads the requested size of the image from the loader's thumbnail store into LoadedImage, and adds it to the cache.
+		/// </summary>
+		/// <returns>True if the image was loaded.</returns>
+		bool TryLoadStoredThumbnail();
 	};
 
 	std::recursive_mutex _taskQueueMutex;
-	std::map<std::string, LoadImageTask*> _taskQueue;
+	std::map<TaskKey, LoadImageTask*> _taskQueue;
+
+	/// <summary>
+	/// Images queued by <see cref="WarmUp"/> that have not been started, most frequently requested first. Guarded by the task queue mutex.
+	/// </summary>
+	std::deque<CacheSnapshotEntry> _warmUpQueue;
+	bool _isWarmingUp = false;
 
 	std::recursive_mutex _imageLocksMutex;
 	std::map<std::string, std::recursive_mutex*> _imageLocks;
@@ -100,6 +196,33 @@ private:
 	void SignalThreadStart(LoadImageTask* loadImageTask);
 	void SignalThreadCompleted(LoadImageTask* loadImageTask);
 
+	/// <summary>
+	/// Starts a task for the next image in the warm up queue, unless a warm up task is already running. Must be called with the task
+	/// queue mutex held.
+	/// </summary>
+	void TryStartWarmUpTask();
+
+	/// <summary>
+	/// Queues a task for the image at the size, unless one is already queued. Takes over the caller's reference to the handle of
+	/// the path.
+	/// </summary>
+	TryGetImageStatus QueueTask(ImageId imageId, unsigned int width, unsigned int height, const std::string& cacheNamespace,
+		std::function<void(ImageLoadTaskResult<TImage>)> imageLoadedCallback);
+
+	/// <summary>
+	/// Lowers the scheduling priority of the calling thread, where supported, so that it only uses CPU time that requests do not need.
+	/// </summary>
+	static void LowerCurrentThreadPriority();
+
+	/// <summary>
+	/// Makes the cache hold one watch of the path while anything is cached for it, and none once nothing is. Called after every change
+	/// that can add or remove what is cached for the path. Updates that looked at the cache before a concurrent update did are
+	/// dropped, so the last update to look at the cache decides.
+	/// </summary>
+	/// <param name="filePath">Path to the file, spelled as it was watched.</param>
+	/// <param name="releaseTaskWatch">True if the caller holds a watch of the path, which is handed to the cache or released.</param>
+	void UpdateFileWatch(const std::filesystem::path& filePath, bool releaseTaskWatch);
+
 
 
 public:
@@ -118,6 +241,12 @@ public:
 
 	~ImageLoader()
 	{
+		//stopped first, so that no change notification is delivered to a loader that is being destroyed.
+		if (_fileWatcher)
+			_imageCache->Unsubscribe(_fileWatchSubscription);
+
+		delete _fileWatcher;
+
 		_updateThreadAbort = true;
 
 		//the update thread gets lock on the task queue each pass, so we'll use the same mutex to wait for it to exit.
@@ -134,6 +263,128 @@ public:
 	/// </summary>
 	virtual void SetMaxThreadCount(int count) override;
 
+	/// <summary>
+	/// Sets how long the loader remembers the result of querying the filesystem for a path. Requests for a path that was found to
+	/// be missing or undecodable within this time fail immediately with <see cref="TryGetImageStatus::FileIsUnreadable"/>.
+	/// </summary>
+	void SetFileStatTimeToLive(const std::chrono::steady_clock::duration timeToLive)
+	{
+		_imageDataReader.GetFileStatCache().SetTimeToLive(timeToLive);
+	}
+
+	/// <summary>
+	/// Sets a persistent store of thumbnails on disk, or nullptr for none. Every image that is resized to a requested size is written
+	/// to the store, and requests for a size that is not in the cache are served from the store when possible, without decoding the
+	/// source or resizing. The store is not owned by the loader, and must outlive it.
+	/// </summary>
+	void SetThumbnailStore(ThumbnailStore* thumbnailStore)
+	{
+		_thumbnailStore = thumbnailStore;
+	}
+
+	/// <summary>
+	/// Sets a recorder that every served request is recorded to, or nullptr for none, so that the trace can be replayed by a
+	/// <see cref="CacheSimulator"/> to tune the cache's budget and eviction policy. Requests that fail and warm up tasks are not
+	/// recorded. The recorder is not owned by the loader, and must outlive it.
+	/// </summary>
+	void SetRequestTraceRecorder(RequestTraceRecorder* recorder)
+	{
+		_requestTraceRecorder = recorder;
+	}
+
+	/// <summary>
+	/// Watches each loaded image file for changes on a background thread, and invalidates everything cached for a file as soon as it
+	/// is changed, replaced or deleted, so that the next request loads the new contents. Only supported where
+	/// <see cref="FileWatcher::IsSupported"/> is true. Must be called before images are requested. A file stops being watched once
+	/// nothing is cached for it. Each load task watches its file before reading it, so that a change made while the file is being
+	/// loaded and cached is not missed.
+	/// </summary>
+	/// <returns>True if file watching is enabled.</returns>
+	bool EnableFileWatching()
+	{
+		if (!FileWatcher::IsSupported())
+			return false;
+
+		if (!_fileWatcher)
+		{
+			_fileWatcher = new FileWatcher([this](const std::filesystem::path& filePath)
+			{
+				_imageDataReader.GetFileStatCache().Invalidate(filePath);
+				_imageCache->TryInvalidateImage(filePath);
+				UpdateFileWatch(filePath, false);
+			});
+
+			_fileWatchSubscription = _imageCache->Subscribe([this](const std::vector<CacheRemoval>& removals)
+			{
+				for (const auto& removal : removals)
+				{
+					if (removal.Tier == CacheRemovalTier::Entry)
+						UpdateFileWatch(removal.ImagePath, false);
+				}
+			});
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Gets the number of files watched for changes, see <see cref="EnableFileWatching"/>.
+	/// </summary>
+	size_t GetWatchedFileCount() const {
+		return _fileWatcher ? _fileWatcher->GetWatchedFileCount() : 0;
+	}
+
+	/// <summary>
+	/// Sets whether image files are hashed before they are decoded, so that byte identical files under different paths share a
+	/// single cached source image and its resized copies instead of each being decoded and stored. Reading and hashing the file
+	/// adds a small cost to each image that is not already cached by path.
+	/// </summary>
+	void SetDeduplicateByContent(const bool enabled)
+	{
+		_deduplicateByContent = enabled;
+	}
+
+	/// <summary>
+	/// Sets the granularity in pixels to which requested widths and heights are rounded, to the nearest multiple, before they are
+	/// looked up in the cache or resized to. Near identical sizes, e.g. 255x143, 256x144 and 257x145 with a bucket of 8 pixels, then
+	/// share one queued task, one resize and one cached image, at the cost of images differing from the requested size by up to half
+	/// a bucket per axis. A request for the source size is never rounded.
+	/// </summary>
+	/// <param name="pixels">The bucket size in pixels, or 0 to load images at exactly the requested size.</param>
+	void SetSizeBucket(const unsigned int pixels)
+	{
+		std::lock_guard<std::recursive_mutex> taskQueueLock(_taskQueueMutex);
+		_sizeBucket = pixels;
+	}
+
+	/// <summary>
+	/// Loads the images of a cache snapshot in the background, most frequently requested first, so that a cache that starts cold is
+	/// re-populated with the images a previous run requested most. Warm up tasks only start when no requested image is waiting for a
+	/// thread, run one at a time, and run at the lowest thread priority, so that they do not delay requests. The loaded images are
+	/// released as soon as they are added to the cache, so the cache keeps them through its retention budget, spill tier or encoded
+	/// tier, or the loader's thumbnail store.
+	/// </summary>
+	/// <param name="entries">The images to load, e.g. read with <see cref="CacheSnapshot::TryLoad"/>.</param>
+	void WarmUp(std::vector<CacheSnapshotEntry> entries);
+
+	/// <summary>
+	/// Discards the images queued by <see cref="WarmUp"/> that have not been started.
+	/// </summary>
+	void CancelWarmUp()
+	{
+		std::lock_guard<std::recursive_mutex> taskQueueLock(_taskQueueMutex);
+		_warmUpQueue.clear();
+	}
+
+	/// <summary>
+	/// Gets the number of images queued by <see cref="WarmUp"/> that have not been started.
+	/// </summary>
+	size_t GetPendingWarmUpCount()
+	{
+		std::lock_guard<std::recursive_mutex> taskQueueLock(_taskQueueMutex);
+		return _warmUpQueue.size();
+	}
+
 	/// <summary>
 	/// Attempts to get the image at the specified path. Returns false if the image could not be obtained.
 	/// </summary>
@@ -158,6 +409,50 @@ public:
 		unsigned int height,
 		std::function<void(ImageLoadTaskResult<TImage>)> imageLoadedCallback) override;
 
+	/// <summary>
+	/// Attempts to get the image at the specified path and size, accounting the images loaded for it to a namespace of the cache so
+	/// that a subsystem sharing the cache stays within its own budget. If a task for the same image and size is already queued, the
+	/// images are accounted to the namespace of that task.
+	/// </summary>
+	/// <param name="filePath">Path to the image.</param>
+	/// <param name="width">The width in pixels of the image to be retrieved, or 0 for the source image.</returns>
+	/// <param name="height">The height in pixels of the image to be retrieved, or 0 for the source image.</returns>
+	/// <param name="cacheNamespace">The cache namespace, or an empty string for the default namespace.</param>
+	/// <param name="imageLoadedCallback">Callback that will be invoked completion, returning an ImageLoadTaskResult.</param>
+	/// <returns>Status of the operation.</returns>
+	TryGetImageStatus TryGetImage(
+		const std::filesystem::path& filePath,
+		unsigned int width,
+		unsigned int height,
+		const std::string& cacheNamespace,
+		std::function<void(ImageLoadTaskResult<TImage>)> imageLoadedCallback);
+
+	/// <summary>
+	/// Attempts to get the image identified by the handle of its interned path, see <see cref="ImagePathTable"/>, at the specified
+	/// size. Callers that request the same images repeatedly keep the handle, so that they need not keep the path.
+	/// </summary>
+	/// <param name="imageId">Handle of the path to the image.</param>
+	/// <param name="width">The width in pixels of the image to be retrieved, or 0 for the source image.</returns>
+	/// <param name="height">The height in pixels of the image to be retrieved, or 0 for the source image.</returns>
+	/// <param name="cacheNamespace">The cache namespace, or an empty string for the default namespace.</param>
+	/// <param name="imageLoadedCallback">Callback that will be invoked completion, returning an ImageLoadTaskResult.</param>
+	/// <returns>Status of the operation.</returns>
+	TryGetImageStatus TryGetImage(
+		ImageId imageId,
+		unsigned int width,
+		unsigned int height,
+		const std::string& cacheNamespace,
+		std::function<void(ImageLoadTaskResult<TImage>)> imageLoadedCallback);
+
+	TryGetImageStatus TryGetImage(
+		const ImageId imageId,
+		const unsigned int width,
+		const unsigned int height,
+		std::function<void(ImageLoadTaskResult<TImage>)> imageLoadedCallback)
+	{
+		return TryGetImage(imageId, width, height, std::string(), std::move(imageLoadedCallback));
+	}
+
 	/// <summary>
 	/// Unloads the image, freeing up it's memory and removing it from any caching mechanisms. This function also releases any instances of 
 	/// the image that have been resized.
@@ -0,0 +1,182 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Compact handle of an image path interned in the <see cref="ImagePathTable"/>.
+/// </summary>
+enum class ImageId : uint32_t {};
+
+/// <summary>
+/// Process wide table of interned image paths, which hands out a compact <see cref="ImageId"/> for each distinct path. Load tasks and
+/// cache entries hold the handle of their path instead of a copy of it, and callers that request the same images repeatedly keep the
+/// handle instead of the path. Each path is stored once, the index of handles refers to the stored path. Handles are reference
+/// counted, each <see cref="TryIntern"/> and <see cref="AddReference"/> is matched by a <see cref="Release"/>, and the slot of a path
+/// is reused once its last reference is released, so the table only holds the paths that are in use. Looking up the path of a
+/// handle takes no lock. This class is threadsafe.
+/// </summary>
+class ImagePathTable final
+{
+	static constexpr uint32_t ChunkSize = 4096;
+	static constexpr uint32_t MaxChunks = 1024;
+
+	struct Chunk
+	{
+		std::array<std::filesystem::path, ChunkSize> Paths;
+#if defined(_WIN32)
+		//the native path is a wide string on Windows, keys are narrow strings.
+		std::array<std::string, ChunkSize> Keys;
+#endif
+		std::array<uint32_t, ChunkSize> ReferenceCounts{};
+	};
+
+	//chunks are never moved or freed, so that references to interned paths stay valid and lookups need no lock.
+	std::array<std::atomic<Chunk*>, MaxChunks> _chunks{};
+	std::mutex _lock;
+	std::unordered_map<std::string_view, ImageId> _ids;
+
+	/// <summary>
+	/// Slots whose paths were released, which are reused before new slots.
+	/// </summary>
+	std::vector<uint32_t> _freeSlots;
+	uint32_t _count = 0;
+
+	Chunk& GetChunk(const uint32_t index) const {
+		return *_chunks[index / ChunkSize].load(std::memory_order_acquire);
+	}
+
+	ImagePathTable() = default;
+
+public:
+	ImagePathTable(const ImagePathTable&) = delete;
+	ImagePathTable& operator=(const ImagePathTable&) = delete;
+
+	/// <summary>
+	/// Gets the table shared by every cache and loader in the process.
+	/// </summary>
+	static ImagePathTable& GetShared()
+	{
+		static ImagePathTable table;
+		return table;
+	}
+
+	/// <summary>
+	/// Gets the handle of the path, interning it if it is not interned, and adds a reference to it. Paths that differ only in spelling,
+	/// e.g. relative and absolute paths to the same file, get different handles.
+	/// </summary>
+	/// <param name="imagePath">Path to the image.</param>
+	/// <param name="outId">The handle of the path, which is released with <see cref="Release"/>.</param>
+	/// <returns>False if the path is new and every slot of the table is in use, in which case no reference is added.</returns>
+	bool TryIntern(const std::filesystem::path& imagePath, ImageId& outId)
+	{
+		const auto key = imagePath.string();
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		if (const auto search = _ids.find(key); search != _ids.end())
+		{
+			outId = search->second;
+			++GetChunk(static_cast<uint32_t>(outId)).ReferenceCounts[static_cast<uint32_t>(outId) % ChunkSize];
+			return true;
+		}
+
+		uint32_t index;
+		if (!_freeSlots.empty())
+		{
+			index = _freeSlots.back();
+			_freeSlots.pop_back();
+		}
+		else
+		{
+			if (_count == ChunkSize * MaxChunks)
+				return false;
+
+			index = _count++;
+			if (!_chunks[index / ChunkSize].load(std::memory_order_relaxed))
+				_chunks[index / ChunkSize].store(new Chunk(), std::memory_order_release);
+		}
+
+		auto& chunk = GetChunk(index);
+		outId = static_cast<ImageId>(index);
+		chunk.Paths[index % ChunkSize] = imagePath;
+#if defined(_WIN32)
+		chunk.Keys[index % ChunkSize] = key;
+#endif
+		chunk.ReferenceCounts[index % ChunkSize] = 1;
+		_ids.emplace(GetKey(outId), outId);
+		return true;
+	}
+
+	/// <summary>
+	/// Adds a reference to the handle, e.g. for a copy of the handle that is released separately.
+	/// </summary>
+	/// <param name="id">A handle the caller holds a reference to.</param>
+	void AddReference(const ImageId id)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		++GetChunk(static_cast<uint32_t>(id)).ReferenceCounts[static_cast<uint32_t>(id) % ChunkSize];
+	}
+
+	/// <summary>
+	/// Releases a reference to the handle. The path is no longer interned once its last reference is released, and the handle may
+	/// then be handed out for another path.
+	/// </summary>
+	/// <param name="id">A handle the caller holds a reference to.</param>
+	void Release(const ImageId id)
+	{
+		const auto index = static_cast<uint32_t>(id);
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		auto& chunk = GetChunk(index);
+		if (--chunk.ReferenceCounts[index % ChunkSize] > 0)
+			return;
+
+		_ids.erase(GetKey(id));
+		chunk.Paths[index % ChunkSize].clear();
+#if defined(_WIN32)
+		chunk.Keys[index % ChunkSize].clear();
+#endif
+		_freeSlots.push_back(index);
+	}
+
+	/// <summary>
+	/// Gets the number of interned paths.
+	/// </summary>
+	size_t GetPathCount()
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _ids.size();
+	}
+
+	/// <summary>
+	/// Gets the interned path of the handle. The reference is valid while the caller holds a reference to the handle.
+	/// </summary>
+	/// <param name="id">A handle the caller holds a reference to.</param>
+	[[nodiscard]]
+	const std::filesystem::path& GetPath(const ImageId id) const
+	{
+		const auto index = static_cast<uint32_t>(id);
+		return GetChunk(index).Paths[index % ChunkSize];
+	}
+
+	/// <summary>
+	/// Gets the interned path of the handle as a string, as used for keys, without converting the path again.
+	/// </summary>
+	/// <param name="id">A handle the caller holds a reference to.</param>
+	[[nodiscard]]
+	const std::string& GetKey(const ImageId id) const
+	{
+#if defined(_WIN32)
+		const auto index = static_cast<uint32_t>(id);
+		return GetChunk(index).Keys[index % ChunkSize];
+#else
+		return GetPath(id).native();
+#endif
+	}
+};
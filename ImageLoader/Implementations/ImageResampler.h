@@ -0,0 +1,43 @@
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include "../Assert.h"
+
+/// <summary>
+/// Resamples 8 bit rgba pixel data to different dimensions.
+/// </summary>
+class ImageResampler final
+{
+public:
+	/// <summary>
+	/// Resizes 8 bit rgba pixel data to the specified dimensions.
+	/// </summary>
+	/// <param name="pixels">The pixel data to resize.</param>
+	/// <param name="width">Width in pixels of the pixel data.</param>
+	/// <param name="height">Height in pixels of the pixel data.</param>
+	/// <param name="resizedWidth">Width in pixels of the result.</param>
+	/// <param name="resizedHeight">Height in pixels of the result.</param>
+	/// <returns>The resized pixel data, allocated with new[] and owned by the caller.</returns>
+	[[nodiscard]]
+	static unsigned char* Resize(const unsigned char* pixels, int width, int height, int resizedWidth, int resizedHeight);
+
+	/// <summary>
+	/// Halves 8 bit rgba pixel data in each dimension with a 2x2 box filter, as used to build each level of a mipmap chain from the
+	/// previous level. Dimensions of 1 pixel are not reduced further.
+	/// </summary>
+	/// <param name="pixels">The pixel data to downsample.</param>
+	/// <param name="width">Width in pixels of the pixel data.</param>
+	/// <param name="height">Height in pixels of the pixel data.</param>
+	/// <param name="outWidth">Width in pixels of the result.</param>
+	/// <param name="outHeight">Height in pixels of the result.</param>
+	/// <returns>The downsampled pixel data, allocated with malloc and owned by the caller, matching the allocation of image data
+	/// loaded from file.</returns>
+	[[nodiscard]]
+	static unsigned char* DownsampleByHalf(const unsigned char* pixels, int width, int height, int& outWidth, int& outHeight);
+};
+
+
+#include "ImageResampler.inl"
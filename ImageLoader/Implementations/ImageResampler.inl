@@ -0,0 +1,71 @@
+#include "ImageResampler.h"
+
+//per documentation from stb, these defines and include should only occur in a single file
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "../stb/stb_image_resize2.h"
+
+
+inline unsigned char* ImageResampler::Resize(const unsigned char* pixels, const int width, const int height,
+	const int resizedWidth, const int resizedHeight)
+{
+	ASSERT_MSG(pixels, "pixels cannot be null");
+	ASSERT_MSG(resizedWidth >= 1 && resizedHeight >= 1, "Resized dimensions must be greater than 0");
+
+	constexpr int channelCount = 4;//rgba 8bits per color
+	const size_t resizedLength = static_cast<size_t>(resizedWidth) * resizedHeight * channelCount;
+	auto* result = new unsigned char[resizedLength];
+
+	if (width == resizedWidth && height == resizedHeight)
+	{
+		memcpy(result, pixels, resizedLength);
+		return result;
+	}
+
+	const auto* resized = stbir_resize_uint8_linear(pixels, width, height, width * channelCount,
+		result, resizedWidth, resizedHeight, resizedWidth * channelCount, STBIR_RGBA);
+
+	if (!resized)
+	{
+		delete[] result;
+		throw std::runtime_error("Failed to resize image.");
+	}
+
+	return result;
+}
+
+inline unsigned char* ImageResampler::DownsampleByHalf(const unsigned char* pixels, const int width, const int height,
+	int& outWidth, int& outHeight)
+{
+	ASSERT_MSG(pixels, "pixels cannot be null");
+
+	constexpr int channelCount = 4;//rgba 8bits per color
+	outWidth = width > 1 ? width / 2 : 1;
+	outHeight = height > 1 ? height / 2 : 1;
+
+	auto* result = static_cast<unsigned char*>(malloc(static_cast<size_t>(outWidth) * outHeight * channelCount));
+	if (!result)
+		throw std::bad_alloc();
+
+	for (int y = 0; y < outHeight; y++)
+	{
+		//clamp for dimensions of 1 pixel, where both samples come from the same row or column.
+		const int y0 = std::min(y * 2, height - 1);
+		const int y1 = std::min(y * 2 + 1, height - 1);
+		const unsigned char* row0 = pixels + static_cast<size_t>(y0) * width * channelCount;
+		const unsigned char* row1 = pixels + static_cast<size_t>(y1) * width * channelCount;
+		unsigned char* outRow = result + static_cast<size_t>(y) * outWidth * channelCount;
+
+		for (int x = 0; x < outWidth; x++)
+		{
+			const int x0 = std::min(x * 2, width - 1) * channelCount;
+			const int x1 = std::min(x * 2 + 1, width - 1) * channelCount;
+			for (int c = 0; c < channelCount; c++)
+			{
+				const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				outRow[x * channelCount + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+
+	return result;
+}
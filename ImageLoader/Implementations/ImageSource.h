@@ -52,7 +52,7 @@ public:
 	/// Gets the path from which image was originally loaded.
 	/// </summary>
 	[[nodiscard]]
-	virtual std::filesystem::path GetImagePath() const override {
+	virtual const std::filesystem::path& GetImagePath() const override {
 		return _sourcePath;
 	}
 
@@ -60,11 +60,11 @@ public:
 	/// Gets the size in bytes of the image.
 	/// </summary>
 	[[nodiscard]]
-	virtual unsigned int GetSizeInBytes() const override
+	virtual int64_t GetSizeInBytes() const override
 	{
 		//TODO: zoea 25/11/2024 make this properly handle images with channel count other than 4 and 
 		//pixels more than 8 bits per channel
-		return _width * _height * 4;
+		return static_cast<int64_t>(_width) * _height * 4;
 	}
 };
 
@@ -0,0 +1,225 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include "FileStatCache.h"
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+/// <summary>
+/// Maps the paths of image files to canonical keys, so that every path to the same file gets the same key. A path is first made
+/// absolute and lexically normal, which collapses relative paths and "a/../b.jpg". Paths to the same file through symbolic or hard
+/// links are then collapsed by the file's device and inode, to the first path that was seen for that file. The key of each path is
+/// cached, so that only the first request for a path queries the filesystem. Where device and inode numbers are not available,
+/// symbolic links are resolved by the filesystem instead. This class is threadsafe.
+/// </summary>
+class PathCanonicalizer final
+{
+	/// <summary>
+	/// Number of cached paths above which the cached paths are cleared, which only costs querying the filesystem again. The keys
+	/// of files are kept, so that a path gets the same key after it is queried again.
+	/// </summary>
+	static constexpr size_t MaxCachedPaths = 65536;
+
+	/// <summary>
+	/// Number of file keys above which they are cleared too, which only happens if most of them are of files that were never
+	/// cached, as the keys of files whose entries are removed are released.
+	/// </summary>
+	static constexpr size_t MaxFileKeys = 65536;
+
+	using FileIdentity = std::pair<uint64_t, uint64_t>;
+
+	/// <summary>
+	/// The key of a file, along with the size and modification time it had when the key was assigned. An inode can be reused by a
+	/// new file once the old one is deleted, whose paths must not get the old file's key.
+	/// </summary>
+	struct FileKey
+	{
+		std::string Key;
+		FileStat Stat;
+	};
+
+	std::mutex _lock;
+	std::map<const std::string, std::string> _keys;
+
+	/// <summary>
+	/// The cached paths of each key, so that the paths resolved to a key are discarded with it without scanning every cached path.
+	/// </summary>
+	std::map<const std::string, std::set<std::string>> _pathsByKey;
+	std::map<FileIdentity, FileKey> _fileKeys;
+	std::map<const std::string, FileIdentity> _fileIdentities;
+
+	/// <summary>
+	/// Gets the device and inode of the file at the path, and its size and modification time. Returns false if the file does not
+	/// exist or they are not available.
+	/// </summary>
+	static bool TryGetFileIdentity(const std::filesystem::path& path, FileIdentity& outIdentity, FileStat& outStat)
+	{
+#if defined(_WIN32)
+		return false;
+#else
+		struct stat fileStatus {};
+		if (stat(path.c_str(), &fileStatus) != 0)
+			return false;
+
+		outIdentity = { static_cast<uint64_t>(fileStatus.st_dev), static_cast<uint64_t>(fileStatus.st_ino) };
+		outStat.SizeInBytes = static_cast<uint64_t>(fileStatus.st_size);
+#if defined(__APPLE__)
+		outStat.ModifiedTime = static_cast<int64_t>(fileStatus.st_mtimespec.tv_sec) * 1000000000 + fileStatus.st_mtimespec.tv_nsec;
+#else
+		outStat.ModifiedTime = static_cast<int64_t>(fileStatus.st_mtim.tv_sec) * 1000000000 + fileStatus.st_mtim.tv_nsec;
+#endif
+		outStat.FileId = static_cast<uint64_t>(fileStatus.st_ino);
+		return true;
+#endif
+	}
+
+	/// <summary>
+	/// Gets the key of the file, assigning the key of the path if the file has none yet, or if the file it was assigned for has
+	/// since been replaced by another one with the same inode.
+	/// </summary>
+	const std::string& GetFileKey(const FileIdentity& identity, const FileStat& fileStat, const std::string& pathKey)
+	{
+		if (const auto search = _fileKeys.find(identity); search != _fileKeys.end())
+		{
+			if (search->second.Stat == fileStat)
+				return search->second.Key;
+
+			_fileIdentities.erase(search->second.Key);
+			_fileKeys.erase(search);
+		}
+
+		if (_fileKeys.size() >= MaxFileKeys)
+		{
+			_fileKeys.clear();
+			_fileIdentities.clear();
+		}
+
+		//a path keeps one file key, a previous file that had the same path no longer resolves to it.
+		if (const auto search = _fileIdentities.find(pathKey); search != _fileIdentities.end())
+		{
+			_fileKeys.erase(search->second);
+			_fileIdentities.erase(search);
+		}
+
+		_fileIdentities.emplace(pathKey, identity);
+		return _fileKeys.emplace(identity, FileKey{ pathKey, fileStat }).first->second.Key;
+	}
+
+public:
+	/// <summary>
+	/// Gets the canonical key of the path.
+	/// </summary>
+	/// <param name="imagePath">Path to the file.</param>
+	std::string GetKey(const std::filesystem::path& imagePath)
+	{
+		const auto path = imagePath.string();
+		{
+			std::lock_guard<std::mutex> lockGuard(_lock);
+			if (const auto search = _keys.find(path); search != _keys.end())
+				return search->second;
+		}
+
+		//the filesystem is queried outside of this lock, so that a slow filesystem does not block other caches sharing the
+		//canonicalizer. Callers that hold a lock of their own while resolving a key still block on it.
+		std::error_code errorCode;
+		auto normalPath = std::filesystem::absolute(imagePath, errorCode).lexically_normal();
+		if (errorCode)
+			normalPath = imagePath.lexically_normal();
+
+		FileIdentity identity;
+		FileStat fileStat;
+		const bool hasIdentity = TryGetFileIdentity(normalPath, identity, fileStat);
+#if defined(_WIN32)
+		if (auto canonicalPath = std::filesystem::weakly_canonical(normalPath, errorCode); !errorCode)
+			normalPath = std::move(canonicalPath);
+#endif
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		if (_keys.size() >= MaxCachedPaths)
+		{
+			_keys.clear();
+			_pathsByKey.clear();
+		}
+
+		auto key = normalPath.string();
+		if (hasIdentity)
+			key = GetFileKey(identity, fileStat, key);
+
+		//another thread may have resolved the path meanwhile, to a key that is replaced here.
+		if (const auto search = _keys.find(path); search != _keys.end())
+			ErasePathOfKey(search->second, path);
+
+		_keys[path] = key;
+		_pathsByKey[key].insert(path);
+		return key;
+	}
+
+	/// <summary>
+	/// Discards the cached keys of every path to the same file as the path, e.g. because the file was replaced, in which case the
+	/// paths that linked to it may no longer be the same file.
+	/// </summary>
+	/// <param name="imagePath">Path to the file.</param>
+	void Invalidate(const std::filesystem::path& imagePath)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		const auto search = _keys.find(imagePath.string());
+		if (search == _keys.end())
+			return;
+
+		const auto key = search->second;
+		ReleaseKey(key);
+	}
+
+	/// <summary>
+	/// Discards the key, e.g. because nothing is cached for it any longer, so that the table of file keys only grows with the files
+	/// that are cached. The cached keys of the paths resolved to it are discarded too, so that they are resolved again, and do not
+	/// keep a key that a later path to the same file no longer gets.
+	/// </summary>
+	/// <param name="key">A key returned by <see cref="GetKey"/>.</param>
+	void Release(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		ReleaseKey(key);
+	}
+
+private:
+	void ErasePathOfKey(const std::string& key, const std::string& path)
+	{
+		const auto search = _pathsByKey.find(key);
+		if (search == _pathsByKey.end())
+			return;
+
+		search->second.erase(path);
+		if (search->second.empty())
+			_pathsByKey.erase(search);
+	}
+
+	void ReleaseKey(const std::string& key)
+	{
+		if (const auto search = _pathsByKey.find(key); search != _pathsByKey.end())
+		{
+			for (const auto& path : search->second)
+				_keys.erase(path);
+
+			_pathsByKey.erase(search);
+		}
+
+		ReleaseFileKey(key);
+	}
+
+	void ReleaseFileKey(const std::string& key)
+	{
+		const auto search = _fileIdentities.find(key);
+		if (search == _fileIdentities.end())
+			return;
+
+		_fileKeys.erase(search->second);
+		_fileIdentities.erase(search);
+	}
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// An image served by an <see cref="ImageLoader"/>, with what it cost to serve. Only metadata is recorded, never pixels.
+/// </summary>
+struct RequestTraceEntry
+{
+	/// <summary>
+	/// Time the image was requested, in microseconds since the recording started.
+	/// </summary>
+	int64_t TimestampMicroseconds = 0;
+
+	std::string ImagePath;
+
+	/// <summary>
+	/// Dimensions of the image that was served.
+	/// </summary>
+	int Width = 0;
+	int Height = 0;
+
+	/// <summary>
+	/// Dimensions of the source image if it was decoded to serve the request, otherwise 0.
+	/// </summary>
+	int SourceWidth = 0;
+	int SourceHeight = 0;
+
+	/// <summary>
+	/// Measured time spent decoding the source image and resizing it to serve the request, 0 for work that was not needed.
+	/// </summary>
+	int64_t DecodeCostMicroseconds = 0;
+	int64_t ResizeCostMicroseconds = 0;
+};
+
+/// <summary>
+/// Records the requests served by an <see cref="ImageLoader"/> to a trace file, see <see cref="ImageLoader::SetRequestTraceRecorder"/>,
+/// to be replayed by a <see cref="CacheSimulator"/> to choose a cache budget and eviction policy offline. Entries are appended as
+/// requests complete, and are cheap enough to record in production. This class is threadsafe.
+/// </summary>
+class RequestTraceRecorder final
+{
+	static constexpr uint32_t FileMagic = 0x52544C49;//"ILTR"
+	static constexpr uint32_t FileVersion = 1;
+
+	std::mutex _lock;
+	std::ofstream _file;
+	const std::chrono::steady_clock::time_point _startTime = std::chrono::steady_clock::now();
+
+	template<typename T>
+	static void WriteValue(std::ostream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool ReadValue(std::istream& stream, T& outValue)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&outValue), sizeof(T)));
+	}
+
+public:
+	/// <summary>
+	/// Starts recording to a trace file, replacing any existing trace.
+	/// </summary>
+	/// <param name="filePath">Path of the trace file.</param>
+	RequestTraceRecorder(const std::filesystem::path& filePath)
+		: _file(filePath, std::ios::binary | std::ios::trunc)
+	{
+		WriteValue(_file, FileMagic);
+		WriteValue(_file, FileVersion);
+		if (!_file)
+			throw std::runtime_error("Failed to create the request trace file.");
+	}
+
+	RequestTraceRecorder(const RequestTraceRecorder&) = delete;
+	RequestTraceRecorder& operator=(const RequestTraceRecorder&) = delete;
+
+	/// <summary>
+	/// Appends an entry to the trace.
+	/// </summary>
+	/// <param name="requestTime">Time the image was requested, which sets the timestamp of the entry.</param>
+	/// <param name="entry">The entry to record.</param>
+	void Record(const std::chrono::steady_clock::time_point requestTime, const RequestTraceEntry& entry)
+	{
+		const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(requestTime - _startTime).count();
+
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		WriteValue(_file, static_cast<int64_t>(timestamp));
+		WriteValue(_file, static_cast<uint32_t>(entry.ImagePath.size()));
+		_file.write(entry.ImagePath.data(), static_cast<std::streamsize>(entry.ImagePath.size()));
+		WriteValue(_file, entry.Width);
+		WriteValue(_file, entry.Height);
+		WriteValue(_file, entry.SourceWidth);
+		WriteValue(_file, entry.SourceHeight);
+		WriteValue(_file, entry.DecodeCostMicroseconds);
+		WriteValue(_file, entry.ResizeCostMicroseconds);
+	}
+
+	/// <summary>
+	/// Writes the recorded entries through to the file.
+	/// </summary>
+	void Flush()
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		_file.flush();
+	}
+
+	/// <summary>
+	/// Reads the entries of a trace file, ordered by timestamp. A trace whose last entry was cut short, e.g. because the process was
+	/// terminated while recording, is read up to that entry.
+	/// </summary>
+	/// <param name="filePath">Path of the trace file.</param>
+	/// <param name="outEntries">The entries of the trace.</param>
+	/// <returns>False if the trace is missing or is not a trace file.</returns>
+	static bool TryLoad(const std::filesystem::path& filePath, std::vector<RequestTraceEntry>& outEntries)
+	{
+		outEntries.clear();
+
+		std::ifstream file(filePath, std::ios::binary);
+		uint32_t magic, version;
+		if (!file || !ReadValue(file, magic) || !ReadValue(file, version) || magic != FileMagic || version != FileVersion)
+			return false;
+
+		RequestTraceEntry entry;
+		uint32_t pathLength;
+		while (ReadValue(file, entry.TimestampMicroseconds) && ReadValue(file, pathLength))
+		{
+			entry.ImagePath.resize(pathLength);
+			if (!file.read(entry.ImagePath.data(), pathLength) || !ReadValue(file, entry.Width) || !ReadValue(file, entry.Height)
+				|| !ReadValue(file, entry.SourceWidth) || !ReadValue(file, entry.SourceHeight)
+				|| !ReadValue(file, entry.DecodeCostMicroseconds) || !ReadValue(file, entry.ResizeCostMicroseconds))
+				break;
+
+			outEntries.push_back(entry);
+		}
+
+		//entries are recorded as requests complete, which is not the order they were made in.
+		std::stable_sort(outEntries.begin(), outEntries.end(), [](const RequestTraceEntry& a, const RequestTraceEntry& b)
+		{
+			return a.TimestampMicroseconds < b.TimestampMicroseconds;
+		});
+
+		return true;
+	}
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include "../SourceImageStore.h"
+#include "EvictionPolicy.h"
+#include "SourceBudget.h"
+
+/// <summary>
+/// An <see cref="ImageCaching::ISourceImageStore"/> that keeps source images in memory up to one budget, evicting them by an
+/// <see cref="EvictionPolicy"/> when memory is needed for a new source. Evicting a source only drops the store's reference to it,
+/// so a resize in progress keeps its source alive. This class is threadsafe, and a single instance is intended to be shared by every
+/// cache of the process.
+/// </summary>
+class SharedImageSourceStore final : public ImageCaching::ISourceImageStore
+{
+	mutable std::mutex _lock;
+	SourceBudget<std::shared_ptr<const IImageSource>> _sources;
+
+public:
+	/// <summary>
+	/// Constructs an empty store.
+	/// </summary>
+	/// <param name="maximumMemoryInBytes">The maximum memory of the stored source images.</param>
+	/// <param name="policy">The policy used to evict source images, <see cref="EvictionPolicy::NeverEvict"/> fails to add sources
+	/// that exceed the maximum memory instead.</param>
+	SharedImageSourceStore(int64_t maximumMemoryInBytes, EvictionPolicy policy = EvictionPolicy::LeastRecentlyUsed);
+
+	SharedImageSourceStore(const SharedImageSourceStore&) = delete;
+	SharedImageSourceStore& operator=(const SharedImageSourceStore&) = delete;
+
+	void SetMaxMemory(int64_t maximumMemoryInBytes) override;
+
+	int64_t GetMaxMemory() const override
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _sources.GetMaxMemory();
+	}
+
+	/// <summary>
+	/// Gets the memory in bytes of the stored source images.
+	/// </summary>
+	int64_t GetCurrentMemoryUsage() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _sources.GetCurrentMemoryUsage();
+	}
+
+	/// <summary>
+	/// Gets the number of stored source images.
+	/// </summary>
+	size_t GetSourceImageCount() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _sources.GetCount();
+	}
+
+	bool TryGetSourceImage(const std::filesystem::path& imagePath, std::shared_ptr<const IImageSource>& outSourceImage) override;
+
+	ImageCaching::TryAddImageResult TryAddSourceImage(std::shared_ptr<const IImageSource> image, std::chrono::microseconds creationCost) override;
+
+	bool TryRemoveSourceImage(const std::filesystem::path& imagePath) override;
+};
+
+#include "SharedImageSourceStore.inl"
@@ -0,0 +1,41 @@
+#include "SharedImageSourceStore.h"
+
+
+inline SharedImageSourceStore::SharedImageSourceStore(const int64_t maximumMemoryInBytes, const EvictionPolicy policy)
+	: _sources(maximumMemoryInBytes, policy)
+{
+}
+
+inline void SharedImageSourceStore::SetMaxMemory(const int64_t maximumMemoryInBytes)
+{
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	_sources.SetMaxMemory(maximumMemoryInBytes);
+}
+
+inline bool SharedImageSourceStore::TryGetSourceImage(const std::filesystem::path& imagePath,
+	std::shared_ptr<const IImageSource>& outSourceImage)
+{
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	const auto* source = _sources.TryGet(imagePath.string());
+	outSourceImage = source ? *source : nullptr;
+	return source != nullptr;
+}
+
+inline ImageCaching::TryAddImageResult SharedImageSourceStore::TryAddSourceImage(std::shared_ptr<const IImageSource> image,
+	const std::chrono::microseconds creationCost)
+{
+	if (!image)
+		return ImageCaching::TryAddImageResult::NoChange;
+
+	const auto size = image->GetSizeInBytes();
+	auto key = image->GetImagePath().string();
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	return _sources.TryAdd(std::move(key), std::move(image), size, creationCost);
+}
+
+inline bool SharedImageSourceStore::TryRemoveSourceImage(const std::filesystem::path& imagePath)
+{
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	return _sources.TryRemove(imagePath.string());
+}
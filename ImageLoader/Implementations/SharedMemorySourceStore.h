@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "../SourceImageStore.h"
+#include "SourceImageDaemon.h"
+
+/// <summary>
+/// A source image whose pixels are a read-only mapping of a shared memory segment of a <see cref="SourceImageDaemon"/>. The mapping
+/// is released when the image is destroyed, and stays valid if the daemon evicts the segment meanwhile.
+/// </summary>
+class SharedMemoryImageSource final : public IImageSource
+{
+	const std::filesystem::path _sourcePath;
+	const int _width;
+	const int _height;
+	const unsigned char* _mapping;
+
+public:
+	SharedMemoryImageSource(const std::filesystem::path& sourcePath, const int width, const int height, const unsigned char* mapping)
+		: _sourcePath(sourcePath)
+		, _width(width)
+		, _height(height)
+		, _mapping(mapping)
+	{
+	}
+
+	~SharedMemoryImageSource() override
+	{
+#if defined(__linux__)
+		munmap(const_cast<unsigned char*>(_mapping), static_cast<size_t>(GetSizeInBytes()));
+#endif
+	}
+
+	[[nodiscard]]
+	int GetWidth() const override {
+		return _width;
+	}
+
+	[[nodiscard]]
+	int GetHeight() const override {
+		return _height;
+	}
+
+	[[nodiscard]]
+	const unsigned char* GetPixels() const override {
+		return _mapping;
+	}
+
+	[[nodiscard]]
+	const std::filesystem::path& GetImagePath() const override {
+		return _sourcePath;
+	}
+
+	[[nodiscard]]
+	int64_t GetSizeInBytes() const override {
+		return static_cast<int64_t>(_width) * _height * 4;
+	}
+};
+
+/// <summary>
+/// An <see cref="ImageCaching::ISourceImageStore"/> that stores source images in the shared memory of a <see cref="SourceImageDaemon"/>,
+/// so that every process on the host that uses the same daemon shares one decoded copy of each image. Source images are found as
+/// zero-copy, read-only mappings. Adding a source image copies its pixels into a new segment once, which the daemon then owns. The
+/// budget and eviction policy are the daemon's. If the daemon cannot be reached, sources are neither found nor added, and callers
+/// decode images themselves as without a store. A store that is not connected, e.g. because the daemon was restarted, connects again
+/// on a later request. This class is threadsafe.
+/// </summary>
+class SharedMemorySourceStore final : public ImageCaching::ISourceImageStore
+{
+	/// <summary>
+	/// How long a store waits after a failed connection before connecting again, so that requests made while the daemon is not running
+	/// do not each try to connect.
+	/// </summary>
+	static constexpr std::chrono::seconds ReconnectInterval{ 1 };
+
+	const std::filesystem::path _socketPath;
+	mutable int _socketFd = -1;
+	mutable std::chrono::steady_clock::time_point _nextConnectTime{};
+	mutable std::mutex _lock;
+
+	/// <summary>
+	/// Maps a segment of the daemon read-only.
+	/// </summary>
+	/// <returns>The mapped source image, or nullptr if the segment no longer exists.</returns>
+	static std::shared_ptr<const IImageSource> TryMapSegment(const std::filesystem::path& imagePath, const std::string& segmentName,
+		int width, int height);
+
+	/// <summary>
+	/// Copies the pixels of a source image into a new segment.
+	/// </summary>
+	/// <returns>False if the segment could not be created.</returns>
+	bool TryWriteSegment(const IImageSource& image, std::string& outSegmentName);
+
+	/// <summary>
+	/// Connects to the daemon if the store is not connected, unless the last attempt failed within <see cref="ReconnectInterval"/>.
+	/// Must be called with the lock held.
+	/// </summary>
+	/// <returns>True if the store is connected.</returns>
+	bool TryConnect() const;
+
+	/// <summary>
+	/// Closes the connection after a failed request, as the rest of the stream can no longer be parsed.
+	/// </summary>
+	void Disconnect() const;
+
+public:
+	/// <summary>
+	/// Connects to the daemon listening on the socket at the path.
+	/// </summary>
+	/// <param name="socketPath">Path of the daemon's socket.</param>
+	SharedMemorySourceStore(const std::filesystem::path& socketPath);
+
+	~SharedMemorySourceStore();
+
+	SharedMemorySourceStore(const SharedMemorySourceStore&) = delete;
+	SharedMemorySourceStore& operator=(const SharedMemorySourceStore&) = delete;
+
+	/// <summary>
+	/// Gets whether the store is connected to its daemon. A store that is not connected connects again on a later request.
+	/// </summary>
+	bool IsConnected() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _socketFd >= 0;
+	}
+
+	/// <summary>
+	/// Sets the maximum memory of the daemon, which applies to every process using it.
+	/// </summary>
+	void SetMaxMemory(int64_t maximumMemoryInBytes) override;
+
+	int64_t GetMaxMemory() const override;
+
+	bool TryGetSourceImage(const std::filesystem::path& imagePath, std::shared_ptr<const IImageSource>& outSourceImage) override;
+
+	ImageCaching::TryAddImageResult TryAddSourceImage(std::shared_ptr<const IImageSource> image, std::chrono::microseconds creationCost) override;
+
+	bool TryRemoveSourceImage(const std::filesystem::path& imagePath) override;
+};
+
+#include "SharedMemorySourceStore.inl"
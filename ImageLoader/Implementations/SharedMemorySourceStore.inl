@@ -0,0 +1,269 @@
+#include "SharedMemorySourceStore.h"
+#include <cstring>
+
+
+inline SharedMemorySourceStore::SharedMemorySourceStore(const std::filesystem::path& socketPath)
+	: _socketPath(socketPath)
+{
+	TryConnect();
+}
+
+inline SharedMemorySourceStore::~SharedMemorySourceStore()
+{
+	Disconnect();
+}
+
+inline bool SharedMemorySourceStore::TryConnect() const
+{
+#if defined(__linux__)
+	if (_socketFd >= 0)
+		return true;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now < _nextConnectTime)
+		return false;
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const auto path = _socketPath.string();
+	if (path.size() < sizeof(address.sun_path))
+	{
+		path.copy(address.sun_path, path.size());
+		_socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (_socketFd >= 0 && connect(_socketFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+			Disconnect();
+	}
+
+	if (_socketFd < 0)
+		_nextConnectTime = now + ReconnectInterval;
+
+	return _socketFd >= 0;
+#else
+	return false;
+#endif
+}
+
+inline void SharedMemorySourceStore::Disconnect() const
+{
+#if defined(__linux__)
+	if (_socketFd >= 0)
+		close(_socketFd);
+#endif
+	_socketFd = -1;
+}
+
+inline void SharedMemorySourceStore::SetMaxMemory(const int64_t maximumMemoryInBytes)
+{
+	if (maximumMemoryInBytes < 0)
+		throw std::runtime_error("Max memory must be positive");
+
+#if defined(__linux__)
+	using Protocol = SourceImageProtocol;
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	uint8_t response;
+	if (TryConnect() && (!Protocol::TryWriteValue(_socketFd, static_cast<uint8_t>(Protocol::SetMaxMemory))
+		|| !Protocol::TryWriteValue(_socketFd, maximumMemoryInBytes) || !Protocol::TryReadValue(_socketFd, response)))
+		Disconnect();
+#endif
+}
+
+inline int64_t SharedMemorySourceStore::GetMaxMemory() const
+{
+#if defined(__linux__)
+	using Protocol = SourceImageProtocol;
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	uint8_t response;
+	int64_t maximumMemoryInBytes = 0;
+	if (TryConnect() && (!Protocol::TryWriteValue(_socketFd, static_cast<uint8_t>(Protocol::GetMaxMemory))
+		|| !Protocol::TryReadValue(_socketFd, response) || !Protocol::TryReadValue(_socketFd, maximumMemoryInBytes)))
+		Disconnect();
+
+	return maximumMemoryInBytes;
+#else
+	return 0;
+#endif
+}
+
+inline bool SharedMemorySourceStore::TryGetSourceImage(const std::filesystem::path& imagePath,
+	std::shared_ptr<const IImageSource>& outSourceImage)
+{
+	outSourceImage = nullptr;
+
+#if defined(__linux__)
+	using Protocol = SourceImageProtocol;
+
+	std::string segmentName;
+	int32_t width, height;
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		if (!TryConnect())
+			return false;
+
+		uint8_t response;
+		if (!Protocol::TryWriteValue(_socketFd, static_cast<uint8_t>(Protocol::Get)) || !Protocol::TryWriteString(_socketFd, imagePath.string())
+			|| !Protocol::TryReadValue(_socketFd, response))
+		{
+			Disconnect();
+			return false;
+		}
+
+		if (response != Protocol::Found)
+			return false;
+
+		if (!Protocol::TryReadString(_socketFd, segmentName) || !Protocol::TryReadValue(_socketFd, width)
+			|| !Protocol::TryReadValue(_socketFd, height))
+		{
+			Disconnect();
+			return false;
+		}
+	}
+
+	//the daemon may have evicted the segment since answering, in which case the image is not found.
+	outSourceImage = TryMapSegment(imagePath, segmentName, width, height);
+	return outSourceImage != nullptr;
+#else
+	return false;
+#endif
+}
+
+inline ImageCaching::TryAddImageResult SharedMemorySourceStore::TryAddSourceImage(std::shared_ptr<const IImageSource> image,
+	const std::chrono::microseconds creationCost)
+{
+	using namespace ImageCaching;
+
+	if (!image)
+		return TryAddImageResult::NoChange;
+
+#if defined(__linux__)
+	using Protocol = SourceImageProtocol;
+
+	//the pixels are only copied into a segment if the daemon can be reached.
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		if (!TryConnect())
+			return TryAddImageResult::OutOfMemory;
+	}
+
+	std::string segmentName;
+	if (!TryWriteSegment(*image, segmentName))
+		return TryAddImageResult::OutOfMemory;
+
+	uint8_t response = Protocol::OutOfMemory;
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		if (!TryConnect() || !Protocol::TryWriteValue(_socketFd, static_cast<uint8_t>(Protocol::Put))
+			|| !Protocol::TryWriteString(_socketFd, image->GetImagePath().string()) || !Protocol::TryWriteString(_socketFd, segmentName)
+			|| !Protocol::TryWriteValue(_socketFd, static_cast<int32_t>(image->GetWidth()))
+			|| !Protocol::TryWriteValue(_socketFd, static_cast<int32_t>(image->GetHeight()))
+			|| !Protocol::TryWriteValue(_socketFd, static_cast<int64_t>(creationCost.count()))
+			|| !Protocol::TryReadValue(_socketFd, response))
+		{
+			Disconnect();
+			response = Protocol::OutOfMemory;
+		}
+	}
+
+	//the daemon owns the segment once it has been added, otherwise it is not referenced by anything.
+	if (response != Protocol::Added)
+		shm_unlink(segmentName.c_str());
+
+	switch (response)
+	{
+	case Protocol::Added:
+		return TryAddImageResult::Added;
+
+	case Protocol::NoChange:
+		return TryAddImageResult::NoChange;
+
+	default:
+		return TryAddImageResult::OutOfMemory;
+	}
+#else
+	return TryAddImageResult::OutOfMemory;
+#endif
+}
+
+inline bool SharedMemorySourceStore::TryRemoveSourceImage(const std::filesystem::path& imagePath)
+{
+#if defined(__linux__)
+	using Protocol = SourceImageProtocol;
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	uint8_t response;
+	if (!TryConnect())
+		return false;
+
+	if (!Protocol::TryWriteValue(_socketFd, static_cast<uint8_t>(Protocol::Remove)) || !Protocol::TryWriteString(_socketFd, imagePath.string())
+		|| !Protocol::TryReadValue(_socketFd, response))
+	{
+		Disconnect();
+		return false;
+	}
+
+	return response == Protocol::Removed;
+#else
+	return false;
+#endif
+}
+
+inline std::shared_ptr<const IImageSource> SharedMemorySourceStore::TryMapSegment(const std::filesystem::path& imagePath,
+	const std::string& segmentName, const int width, const int height)
+{
+#if defined(__linux__)
+	if (width <= 0 || height <= 0)
+		return nullptr;
+
+	const auto size = static_cast<size_t>(width) * height * 4;
+	const int segmentFd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+	if (segmentFd < 0)
+		return nullptr;
+
+	//reading beyond the end of a segment that is smaller than the mapping raises SIGBUS, rather than failing the read.
+	struct stat segmentStat {};
+	if (fstat(segmentFd, &segmentStat) != 0 || static_cast<size_t>(segmentStat.st_size) < size)
+	{
+		close(segmentFd);
+		return nullptr;
+	}
+
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, segmentFd, 0);
+	close(segmentFd);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	return std::make_shared<SharedMemoryImageSource>(imagePath, width, height, static_cast<const unsigned char*>(mapping));
+#else
+	return nullptr;
+#endif
+}
+
+inline bool SharedMemorySourceStore::TryWriteSegment(const IImageSource& image, std::string& outSegmentName)
+{
+#if defined(__linux__)
+	//segment names only need to be unique on the host, the process id and a counter shared by every store of the process make them so.
+	static std::atomic<uint64_t> nextSegmentId = 0;
+	outSegmentName = std::string(SourceImageProtocol::SegmentNamePrefix) + std::to_string(getpid()) + "." + std::to_string(nextSegmentId++);
+	const auto size = static_cast<size_t>(image.GetSizeInBytes());
+
+	const int segmentFd = shm_open(outSegmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (segmentFd < 0)
+		return false;
+
+	void* mapping = MAP_FAILED;
+	if (ftruncate(segmentFd, static_cast<off_t>(size)) == 0)
+		mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFd, 0);
+
+	close(segmentFd);
+	if (mapping == MAP_FAILED)
+	{
+		shm_unlink(outSegmentName.c_str());
+		return false;
+	}
+
+	memcpy(mapping, image.GetPixels(), size);
+	munmap(mapping, size);
+	return true;
+#else
+	return false;
+#endif
+}
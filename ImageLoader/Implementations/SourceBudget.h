@@ -0,0 +1,182 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "../ImageCache.h"
+#include "EvictionPolicy.h"
+
+/// <summary>
+/// Source images by path up to one memory budget, evicting them by an <see cref="EvictionPolicy"/> when memory is needed for a new
+/// source. Shared by the stores that keep source images for several caches, which differ only in what they keep for each source.
+/// This class is not threadsafe, its owner holds its own lock around every call.
+/// </summary>
+/// <typeparam name="TSource">What is kept for each source, e.g. the image itself or the name of its shared memory segment.</typeparam>
+template<typename TSource>
+class SourceBudget final
+{
+public:
+	struct Entry
+	{
+		TSource Source;
+		int64_t SizeInBytes = 0;
+		std::chrono::microseconds CreationCost{ 0 };
+		uint32_t AccessCount = 1;
+		double EvictionPriority = 0.0;
+	};
+
+private:
+	int64_t _maxAllowedMemory = 0;
+	int64_t _currentMemoryUsage = 0;
+	std::map<const std::string, Entry> _entries;
+
+	/// <summary>
+	/// The entries ordered by eviction priority, so that an eviction takes the lowest from the front instead of scanning every
+	/// entry. Points to the keys of <see cref="_entries"/>.
+	/// </summary>
+	std::set<std::pair<double, const std::string*>> _entriesByPriority;
+	EvictionPriorityCalculator _evictionPriority;
+	std::function<void(const TSource&)> _onEvicted;
+
+	/// <summary>
+	/// Evicts the source with the lowest eviction priority. Returns false if there are no sources.
+	/// </summary>
+	bool TryEvictLowestPriority()
+	{
+		if (_entriesByPriority.empty())
+			return false;
+
+		const auto lowest = _entries.find(*_entriesByPriority.begin()->second);
+		if (_onEvicted)
+			_onEvicted(lowest->second.Source);
+
+		_evictionPriority.OnEvicted(lowest->second.EvictionPriority);
+		_currentMemoryUsage -= lowest->second.SizeInBytes;
+		_entriesByPriority.erase(_entriesByPriority.begin());
+		_entries.erase(lowest);
+		return true;
+	}
+
+public:
+	/// <param name="maximumMemoryInBytes">The maximum memory of the sources.</param>
+	/// <param name="policy">The policy used to evict sources, <see cref="EvictionPolicy::NeverEvict"/> fails to add sources that
+	/// exceed the maximum memory instead.</param>
+	/// <param name="onEvicted">Invoked with each source that is evicted, but not with sources that are removed.</param>
+	SourceBudget(const int64_t maximumMemoryInBytes, const EvictionPolicy policy,
+		std::function<void(const TSource&)> onEvicted = nullptr)
+		: _evictionPriority(policy)
+		, _onEvicted(std::move(onEvicted))
+	{
+		SetMaxMemory(maximumMemoryInBytes);
+	}
+
+	SourceBudget(const SourceBudget&) = delete;
+	SourceBudget& operator=(const SourceBudget&) = delete;
+
+	/// <summary>
+	/// Sets the maximum memory, evicting sources until they fit unless the policy never evicts.
+	/// </summary>
+	void SetMaxMemory(const int64_t maximumMemoryInBytes)
+	{
+		if (maximumMemoryInBytes < 0)
+			throw std::runtime_error("Max memory must be positive");
+
+		_maxAllowedMemory = maximumMemoryInBytes;
+		if (_evictionPriority.GetPolicy() == EvictionPolicy::NeverEvict)
+			return;
+
+		while (_currentMemoryUsage > _maxAllowedMemory && TryEvictLowestPriority())
+		{
+		}
+	}
+
+	int64_t GetMaxMemory() const {
+		return _maxAllowedMemory;
+	}
+
+	int64_t GetCurrentMemoryUsage() const {
+		return _currentMemoryUsage;
+	}
+
+	size_t GetCount() const {
+		return _entries.size();
+	}
+
+	const std::map<const std::string, Entry>& GetEntries() const {
+		return _entries;
+	}
+
+	/// <summary>
+	/// Gets the source at the path, and counts the request towards its eviction priority.
+	/// </summary>
+	/// <returns>The source, or null if there is none. Valid until the source is evicted or removed.</returns>
+	const TSource* TryGet(const std::string& path)
+	{
+		const auto search = _entries.find(path);
+		if (search == _entries.end())
+			return nullptr;
+
+		auto& entry = search->second;
+		++entry.AccessCount;
+		_entriesByPriority.erase({ entry.EvictionPriority, &search->first });
+		entry.EvictionPriority = _evictionPriority.OnAccess(entry.AccessCount, entry.CreationCost, entry.SizeInBytes);
+		_entriesByPriority.emplace(entry.EvictionPriority, &search->first);
+		return &entry.Source;
+	}
+
+	/// <summary>
+	/// Adds the source at the path, evicting the sources with the lowest priority until it fits.
+	/// </summary>
+	/// <returns>NoChange if there is a source at the path already, and OutOfMemory if the source does not fit.</returns>
+	ImageCaching::TryAddImageResult TryAdd(std::string path, TSource source, const int64_t sizeInBytes,
+		const std::chrono::microseconds creationCost)
+	{
+		using namespace ImageCaching;
+
+		if (_entries.contains(path))
+			return TryAddImageResult::NoChange;
+
+		if (sizeInBytes > _maxAllowedMemory)
+			return TryAddImageResult::OutOfMemory;
+
+		while (_currentMemoryUsage + sizeInBytes > _maxAllowedMemory)
+		{
+			if (_evictionPriority.GetPolicy() == EvictionPolicy::NeverEvict || !TryEvictLowestPriority())
+				return TryAddImageResult::OutOfMemory;
+		}
+
+		Entry entry;
+		entry.Source = std::move(source);
+		entry.SizeInBytes = sizeInBytes;
+		entry.CreationCost = creationCost;
+		entry.EvictionPriority = _evictionPriority.OnAccess(entry.AccessCount, creationCost, sizeInBytes);
+		const auto added = _entries.emplace(std::move(path), std::move(entry)).first;
+		_entriesByPriority.emplace(added->second.EvictionPriority, &added->first);
+		_currentMemoryUsage += sizeInBytes;
+		return TryAddImageResult::Added;
+	}
+
+	/// <summary>
+	/// Removes the source at the path.
+	/// </summary>
+	/// <param name="outSource">Receives the removed source, if not null.</param>
+	/// <returns>False if there is no source at the path.</returns>
+	bool TryRemove(const std::string& path, TSource* outSource = nullptr)
+	{
+		const auto search = _entries.find(path);
+		if (search == _entries.end())
+			return false;
+
+		if (outSource)
+			*outSource = std::move(search->second.Source);
+
+		_currentMemoryUsage -= search->second.SizeInBytes;
+		_entriesByPriority.erase({ search->second.EvictionPriority, &search->first });
+		_entries.erase(search);
+		return true;
+	}
+};
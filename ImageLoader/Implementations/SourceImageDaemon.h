@@ -0,0 +1,267 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "EvictionPolicy.h"
+#include "SourceBudget.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// The messages exchanged between a <see cref="SourceImageDaemon"/> and its clients over a Unix domain socket. A request is an
+/// operation byte followed by its fields, and is answered by a response byte followed by its fields. Strings are sent as a 32 bit
+/// length followed by their bytes.
+/// </summary>
+struct SourceImageProtocol final
+{
+	enum Operation : uint8_t
+	{
+		/// <summary>
+		/// Path. Answered by Found with the segment name, width and height, or NotFound.
+		/// </summary>
+		Get = 1,
+
+		/// <summary>
+		/// Path, segment name, width, height and creation cost in microseconds. The daemon takes ownership of the shared memory segment
+		/// if it answers Added, otherwise the client unlinks it.
+		/// </summary>
+		Put = 2,
+
+		/// <summary>
+		/// Path. Answered by Removed or NotFound.
+		/// </summary>
+		Remove = 3,
+
+		/// <summary>
+		/// Maximum memory in bytes. Answered by Done.
+		/// </summary>
+		SetMaxMemory = 4,
+
+		/// <summary>
+		/// Answered by Done with the maximum memory in bytes.
+		/// </summary>
+		GetMaxMemory = 5
+	};
+
+	/// <summary>
+	/// Prefix of the names of the shared memory segments of source images. The daemon refuses segments named otherwise, so that a
+	/// client cannot make it take ownership of, and later unlink, an unrelated segment.
+	/// </summary>
+	static constexpr std::string_view SegmentNamePrefix = "/ImageLoader.";
+
+	enum Response : uint8_t
+	{
+		NotFound = 0,
+		Found = 1,
+		Added = 2,
+		NoChange = 3,
+		OutOfMemory = 4,
+		Removed = 5,
+		Done = 6
+	};
+
+#if defined(__linux__)
+	static bool TryWrite(const int socketFd, const void* data, size_t length)
+	{
+		const auto* bytes = static_cast<const char*>(data);
+		while (length > 0)
+		{
+			const auto written = send(socketFd, bytes, length, MSG_NOSIGNAL);
+			if (written <= 0)
+				return false;
+
+			bytes += written;
+			length -= static_cast<size_t>(written);
+		}
+
+		return true;
+	}
+
+	static bool TryRead(const int socketFd, void* data, size_t length)
+	{
+		auto* bytes = static_cast<char*>(data);
+		while (length > 0)
+		{
+			const auto received = recv(socketFd, bytes, length, 0);
+			if (received <= 0)
+				return false;
+
+			bytes += received;
+			length -= static_cast<size_t>(received);
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	static bool TryWriteValue(const int socketFd, const T& value)
+	{
+		return TryWrite(socketFd, &value, sizeof(T));
+	}
+
+	template<typename T>
+	static bool TryReadValue(const int socketFd, T& outValue)
+	{
+		return TryRead(socketFd, &outValue, sizeof(T));
+	}
+
+	static bool TryWriteString(const int socketFd, const std::string& value)
+	{
+		return TryWriteValue(socketFd, static_cast<uint32_t>(value.size())) && TryWrite(socketFd, value.data(), value.size());
+	}
+
+	static bool TryReadString(const int socketFd, std::string& outValue)
+	{
+		//paths and segment names are short, a longer string means the stream is corrupt.
+		uint32_t length;
+		if (!TryReadValue(socketFd, length) || length > 64 * 1024)
+			return false;
+
+		outValue.resize(length);
+		return TryRead(socketFd, outValue.data(), length);
+	}
+#endif
+};
+
+/// <summary>
+/// A small local daemon that keeps decoded source images in POSIX shared memory for every process on the host, so that each image is
+/// decoded once per host rather than once per process. Clients connect with <see cref="SharedMemorySourceStore"/> over a Unix domain
+/// socket. A client that decodes an image writes it to a shared memory segment and hands the segment to the daemon, and other
+/// clients map the segment read-only without copying it. The daemon owns the segments, and unlinks them when they are evicted to stay
+/// within its budget. A segment that is unlinked stays valid for the clients that have it mapped, so evicting a source never
+/// invalidates an image in use. The daemon serves its clients on a background thread, and can run in a dedicated process or in any
+/// process of the host. On platforms other than Linux <see cref="IsSupported"/> is false and the daemon does nothing.
+/// </summary>
+class SourceImageDaemon final
+{
+	struct SharedSource
+	{
+		std::string SegmentName;
+		int Width = 0;
+		int Height = 0;
+	};
+
+	const std::filesystem::path _socketPath;
+	mutable std::mutex _lock;
+
+	/// <summary>
+	/// The sources by path. A source that is evicted has its segment unlinked.
+	/// </summary>
+	SourceBudget<SharedSource> _sources;
+
+#if defined(__linux__)
+	/// <summary>
+	/// How long a client may take to send the rest of a request once it has started one, or to receive the response, before it is
+	/// disconnected.
+	/// </summary>
+	static constexpr int RequestTimeoutInSeconds = 5;
+
+	/// <summary>
+	/// A connected client, served on its own thread so that a client which stalls part way through a request only blocks itself.
+	/// </summary>
+	struct ClientConnection
+	{
+		std::thread Thread;
+		std::atomic<bool> IsFinished = false;
+	};
+
+	int _listenFd = -1;
+	int _wakeFd = -1;
+	std::atomic<bool> _stop = false;
+	std::thread _thread;
+
+	/// <summary>
+	/// The connected clients, only accessed by the thread that accepts them.
+	/// </summary>
+	std::list<ClientConnection> _clients;
+
+	void Run();
+
+	/// <summary>
+	/// Accepts a client if it runs as the same user as the daemon, and starts serving it.
+	/// </summary>
+	void AcceptClient();
+
+	void ServeClient(int clientFd, uid_t clientUid, ClientConnection& connection);
+
+	/// <summary>
+	/// Reads and answers one request of a client. Returns false if the client disconnected, sent a malformed request, or did not
+	/// complete it within <see cref="RequestTimeoutInSeconds"/>.
+	/// </summary>
+	bool TryHandleRequest(int clientFd, uid_t clientUid);
+
+	/// <summary>
+	/// Takes ownership of the segment of a source image added by a client. Segments that are not named with the
+	/// <see cref="SourceImageProtocol::SegmentNamePrefix"/>, are not owned by the client's user, or are smaller than the image are
+	/// refused.
+	/// </summary>
+	SourceImageProtocol::Response AddSource(const std::string& path, const std::string& segmentName, int width, int height,
+		std::chrono::microseconds creationCost, uid_t clientUid);
+#endif
+
+public:
+	/// <summary>
+	/// Starts the daemon, listening on a Unix domain socket at the path, which is replaced if it exists. Only processes of the same
+	/// user can connect to the socket, and the daemon disconnects any other peer.
+	/// </summary>
+	/// <param name="socketPath">Path of the socket, at most 107 bytes long.</param>
+	/// <param name="maximumMemoryInBytes">The maximum memory of the shared source images.</param>
+	/// <param name="policy">The policy used to evict source images.</param>
+	SourceImageDaemon(const std::filesystem::path& socketPath, int64_t maximumMemoryInBytes,
+		EvictionPolicy policy = EvictionPolicy::LeastRecentlyUsed);
+
+	/// <summary>
+	/// Stops the daemon, and unlinks its socket and every segment it owns.
+	/// </summary>
+	~SourceImageDaemon();
+
+	SourceImageDaemon(const SourceImageDaemon&) = delete;
+	SourceImageDaemon& operator=(const SourceImageDaemon&) = delete;
+
+	/// <summary>
+	/// Gets whether shared memory and Unix domain sockets are supported on this platform.
+	/// </summary>
+	static constexpr bool IsSupported()
+	{
+#if defined(__linux__)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/// <summary>
+	/// Gets the memory in bytes of the shared source images.
+	/// </summary>
+	int64_t GetCurrentMemoryUsage() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _sources.GetCurrentMemoryUsage();
+	}
+
+	/// <summary>
+	/// Gets the number of shared source images.
+	/// </summary>
+	size_t GetSourceImageCount() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _sources.GetCount();
+	}
+};
+
+#include "SourceImageDaemon.inl"
@@ -0,0 +1,281 @@
+#include "SourceImageDaemon.h"
+#include <stdexcept>
+
+
+inline SourceImageDaemon::SourceImageDaemon(const std::filesystem::path& socketPath, const int64_t maximumMemoryInBytes,
+	const EvictionPolicy policy)
+	: _socketPath(socketPath)
+	, _sources(maximumMemoryInBytes, policy, [](const SharedSource& source)
+	{
+#if defined(__linux__)
+		//clients that have the segment mapped keep their mapping, the memory is released once the last of them unmaps it.
+		shm_unlink(source.SegmentName.c_str());
+#endif
+	})
+{
+
+#if defined(__linux__)
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const auto path = socketPath.string();
+	if (path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("The socket path of the source image daemon is too long.");
+
+	path.copy(address.sun_path, path.size());
+	unlink(path.c_str());
+
+	_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (_listenFd < 0)
+		throw std::runtime_error("Failed to create the source image daemon socket.");
+
+	//only the owner may connect, the permissions are set before listening so that no other user can connect in between.
+	if (bind(_listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || chmod(path.c_str(), 0600) != 0
+		|| listen(_listenFd, 16) != 0)
+	{
+		close(_listenFd);
+		unlink(path.c_str());
+		throw std::runtime_error("Failed to listen on the source image daemon socket.");
+	}
+
+	_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_wakeFd < 0)
+	{
+		close(_listenFd);
+		unlink(path.c_str());
+		throw std::runtime_error("Failed to create the source image daemon wake event.");
+	}
+
+	_thread = std::thread(&SourceImageDaemon::Run, this);
+#endif
+}
+
+inline SourceImageDaemon::~SourceImageDaemon()
+{
+#if defined(__linux__)
+	_stop = true;
+	const uint64_t wake = 1;
+	[[maybe_unused]] const auto written = write(_wakeFd, &wake, sizeof(wake));
+	_thread.join();
+
+	close(_wakeFd);
+	close(_listenFd);
+	unlink(_socketPath.string().c_str());
+
+	for (const auto& source : _sources.GetEntries())
+		shm_unlink(source.second.Source.SegmentName.c_str());
+#endif
+}
+
+#if defined(__linux__)
+
+inline void SourceImageDaemon::Run()
+{
+	pollfd pollFds[2] = { { _wakeFd, POLLIN, 0 }, { _listenFd, POLLIN, 0 } };
+	while (!_stop)
+	{
+		if (poll(pollFds, 2, -1) < 0)
+			continue;
+
+		if (pollFds[0].revents & POLLIN)
+			break;
+
+		if (pollFds[1].revents & POLLIN)
+			AcceptClient();
+	}
+
+	//the wake event is never read, so it also wakes every client thread.
+	for (auto& client : _clients)
+		client.Thread.join();
+
+	_clients.clear();
+}
+
+inline void SourceImageDaemon::AcceptClient()
+{
+	for (auto client = _clients.begin(); client != _clients.end();)
+	{
+		if (client->IsFinished)
+		{
+			client->Thread.join();
+			client = _clients.erase(client);
+		}
+		else
+			++client;
+	}
+
+	const int clientFd = accept4(_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+	if (clientFd < 0)
+		return;
+
+	ucred credentials{};
+	socklen_t credentialsLength = sizeof(credentials);
+	if (getsockopt(clientFd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLength) != 0 || credentials.uid != geteuid())
+	{
+		close(clientFd);
+		return;
+	}
+
+	const timeval timeout{ RequestTimeoutInSeconds, 0 };
+	setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	auto& connection = _clients.emplace_back();
+	connection.Thread = std::thread(&SourceImageDaemon::ServeClient, this, clientFd, credentials.uid, std::ref(connection));
+}
+
+inline void SourceImageDaemon::ServeClient(const int clientFd, const uid_t clientUid, ClientConnection& connection)
+{
+	//an idle client waits here without a timeout, the timeout only applies once it has started a request.
+	pollfd pollFds[2] = { { _wakeFd, POLLIN, 0 }, { clientFd, POLLIN, 0 } };
+	while (!_stop)
+	{
+		if (poll(pollFds, 2, -1) < 0)
+			continue;
+
+		if ((pollFds[0].revents & POLLIN)
+			|| ((pollFds[1].revents & (POLLIN | POLLHUP | POLLERR)) && !TryHandleRequest(clientFd, clientUid)))
+			break;
+	}
+
+	close(clientFd);
+	connection.IsFinished = true;
+}
+
+inline bool SourceImageDaemon::TryHandleRequest(const int clientFd, const uid_t clientUid)
+{
+	using Protocol = SourceImageProtocol;
+
+	uint8_t operation;
+	if (!Protocol::TryReadValue(clientFd, operation))
+		return false;
+
+	switch (operation)
+	{
+	case Protocol::Get:
+	{
+		std::string path;
+		if (!Protocol::TryReadString(clientFd, path))
+			return false;
+
+		std::unique_lock<std::mutex> lockGuard(_lock);
+		const auto* source = _sources.TryGet(path);
+		if (!source)
+		{
+			lockGuard.unlock();
+			return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(Protocol::NotFound));
+		}
+
+		const auto segmentName = source->SegmentName;
+		const auto width = source->Width;
+		const auto height = source->Height;
+		lockGuard.unlock();
+
+		return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(Protocol::Found)) && Protocol::TryWriteString(clientFd, segmentName)
+			&& Protocol::TryWriteValue(clientFd, width) && Protocol::TryWriteValue(clientFd, height);
+	}
+
+	case Protocol::Put:
+	{
+		std::string path, segmentName;
+		int32_t width, height;
+		int64_t creationCost;
+		if (!Protocol::TryReadString(clientFd, path) || !Protocol::TryReadString(clientFd, segmentName)
+			|| !Protocol::TryReadValue(clientFd, width) || !Protocol::TryReadValue(clientFd, height)
+			|| !Protocol::TryReadValue(clientFd, creationCost))
+			return false;
+
+		const auto response = AddSource(path, segmentName, width, height, std::chrono::microseconds(creationCost), clientUid);
+		return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(response));
+	}
+
+	case Protocol::Remove:
+	{
+		std::string path;
+		if (!Protocol::TryReadString(clientFd, path))
+			return false;
+
+		std::unique_lock<std::mutex> lockGuard(_lock);
+		auto response = Protocol::NotFound;
+		if (SharedSource source; _sources.TryRemove(path, &source))
+		{
+			shm_unlink(source.SegmentName.c_str());
+			response = Protocol::Removed;
+		}
+
+		lockGuard.unlock();
+		return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(response));
+	}
+
+	case Protocol::SetMaxMemory:
+	{
+		int64_t maximumMemoryInBytes;
+		if (!Protocol::TryReadValue(clientFd, maximumMemoryInBytes) || maximumMemoryInBytes < 0)
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lockGuard(_lock);
+			_sources.SetMaxMemory(maximumMemoryInBytes);
+		}
+
+		return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(Protocol::Done));
+	}
+
+	case Protocol::GetMaxMemory:
+	{
+		std::unique_lock<std::mutex> lockGuard(_lock);
+		const auto maximumMemoryInBytes = _sources.GetMaxMemory();
+		lockGuard.unlock();
+
+		return Protocol::TryWriteValue(clientFd, static_cast<uint8_t>(Protocol::Done))
+			&& Protocol::TryWriteValue(clientFd, maximumMemoryInBytes);
+	}
+
+	default:
+		return false;
+	}
+}
+
+inline SourceImageProtocol::Response SourceImageDaemon::AddSource(const std::string& path, const std::string& segmentName,
+	const int width, const int height, const std::chrono::microseconds creationCost, const uid_t clientUid)
+{
+	using Protocol = SourceImageProtocol;
+
+	if (width <= 0 || height <= 0)
+		return Protocol::OutOfMemory;
+
+	//the daemon unlinks the segments it owns, so it only takes segments of source images that the client itself created.
+	if (!segmentName.starts_with(Protocol::SegmentNamePrefix) || segmentName.find('/', 1) != std::string::npos)
+		return Protocol::OutOfMemory;
+
+	//the segment is checked to hold the whole image, so that a client never maps fewer bytes than the dimensions imply.
+	const auto size = static_cast<int64_t>(width) * height * 4;
+	const int segmentFd = shm_open(segmentName.c_str(), O_RDONLY | O_NOFOLLOW, 0);
+	if (segmentFd < 0)
+		return Protocol::OutOfMemory;
+
+	struct stat segmentStat {};
+	const bool isValid = fstat(segmentFd, &segmentStat) == 0 && segmentStat.st_uid == clientUid && segmentStat.st_size >= size;
+	close(segmentFd);
+	if (!isValid)
+		return Protocol::OutOfMemory;
+
+	SharedSource source;
+	source.SegmentName = segmentName;
+	source.Width = width;
+	source.Height = height;
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	switch (_sources.TryAdd(path, std::move(source), size, creationCost))
+	{
+	case ImageCaching::TryAddImageResult::Added:
+		return Protocol::Added;
+
+	case ImageCaching::TryAddImageResult::NoChange:
+		return Protocol::NoChange;
+
+	default:
+		return Protocol::OutOfMemory;
+	}
+}
+
+#endif
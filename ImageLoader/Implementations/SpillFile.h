@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include "../Assert.h"
+
+/// <summary>
+/// A preallocated scratch file that holds raw pixel buffers evicted from memory, so that they can be read back instead of being
+/// decoded again. Space in the file is managed with a free list of extents, which are coalesced when freed. The file is memory mapped
+/// where supported, and is deleted when the spill file is destroyed. This class is threadsafe.
+/// </summary>
+class SpillFile final
+{
+	/// <summary>
+	/// Allocations are rounded up to this many bytes, so that buffers start on a cache line.
+	/// </summary>
+	static constexpr uint64_t Alignment = 64;
+
+	const std::filesystem::path _filePath;
+	const uint64_t _capacityInBytes;
+	uint64_t _usedSizeInBytes = 0;
+
+	std::mutex _lock;
+
+	/// <summary>
+	/// Free extents of the file, as length by offset.
+	/// </summary>
+	std::map<uint64_t, uint64_t> _freeExtents;
+
+#if defined(_WIN32)
+	std::fstream _file;
+#else
+	unsigned char* _mapping = nullptr;
+#endif
+
+public:
+	/// <summary>
+	/// Creates and preallocates the spill file, replacing any existing file at the path.
+	/// </summary>
+	/// <param name="filePath">Path of the spill file.</param>
+	/// <param name="capacityInBytes">Size of the spill file.</param>
+	SpillFile(const std::filesystem::path& filePath, uint64_t capacityInBytes);
+
+	~SpillFile();
+
+	SpillFile(const SpillFile&) = delete;
+	SpillFile& operator=(const SpillFile&) = delete;
+
+	/// <summary>
+	/// Writes a buffer into a free extent of the file.
+	/// </summary>
+	/// <param name="data">The buffer to write.</param>
+	/// <param name="length">Length in bytes of the buffer.</param>
+	/// <param name="outOffset">Offset of the extent the buffer was written to.</param>
+	/// <returns>False if no free extent is large enough.</returns>
+	bool TryWrite(const unsigned char* data, uint64_t length, uint64_t& outOffset);
+
+	/// <summary>
+	/// Reads a buffer written with <see cref="TryWrite"/>.
+	/// </summary>
+	/// <returns>False if the buffer could not be read.</returns>
+	bool Read(uint64_t offset, uint64_t length, unsigned char* destination);
+
+	/// <summary>
+	/// Returns the extent of a buffer written with <see cref="TryWrite"/> to the free list.
+	/// </summary>
+	void Free(uint64_t offset, uint64_t length);
+
+	uint64_t GetCapacity() const {
+		return _capacityInBytes;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of the file that are allocated to buffers.
+	/// </summary>
+	uint64_t GetUsedSizeInBytes() const {
+		return _usedSizeInBytes;
+	}
+
+private:
+	static uint64_t Align(const uint64_t length)
+	{
+		return (length + Alignment - 1) / Alignment * Alignment;
+	}
+};
+
+
+#include "SpillFile.inl"
@@ -0,0 +1,158 @@
+#include "SpillFile.h"
+#include <cstring>
+#include <stdexcept>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+inline SpillFile::SpillFile(const std::filesystem::path& filePath, const uint64_t capacityInBytes)
+	: _filePath(filePath)
+	, _capacityInBytes(Align(capacityInBytes))
+{
+	if (capacityInBytes == 0)
+		throw std::runtime_error("The capacity of a spill file must be greater than 0.");
+
+#if defined(_WIN32)
+	_file.open(filePath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!_file)
+		throw std::runtime_error("Failed to create the spill file " + filePath.string());
+
+	std::error_code errorCode;
+	std::filesystem::resize_file(filePath, _capacityInBytes, errorCode);
+	if (errorCode)
+		throw std::runtime_error("Failed to allocate the spill file " + filePath.string() + ": " + errorCode.message());
+#else
+	const int fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fileDescriptor < 0)
+		throw std::runtime_error("Failed to create the spill file " + filePath.string());
+
+	//the disk space is reserved up front, so that spilling cannot fail part way through a write because the disk is full. A sparse
+	//file is not an acceptable fallback, as writing to an unbacked page of the mapping raises SIGBUS once the disk is full.
+	if (const int error = posix_fallocate(fileDescriptor, 0, static_cast<off_t>(_capacityInBytes)); error != 0)
+	{
+		close(fileDescriptor);
+		unlink(filePath.c_str());
+		throw std::runtime_error("Failed to reserve disk space for the spill file " + filePath.string() + ": " + strerror(error));
+	}
+
+	void* mapping = mmap(nullptr, _capacityInBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	close(fileDescriptor);
+
+	//the mapping keeps the file alive, unlinking it now means that it is cleaned up even if the process does not exit normally.
+	unlink(filePath.c_str());
+	if (mapping == MAP_FAILED)
+		throw std::runtime_error("Failed to map the spill file " + filePath.string());
+
+	_mapping = static_cast<unsigned char*>(mapping);
+#endif
+
+	_freeExtents[0] = _capacityInBytes;
+}
+
+inline SpillFile::~SpillFile()
+{
+#if defined(_WIN32)
+	_file.close();
+	std::error_code errorCode;
+	std::filesystem::remove(_filePath, errorCode);
+#else
+	munmap(_mapping, _capacityInBytes);
+#endif
+}
+
+inline bool SpillFile::TryWrite(const unsigned char* data, const uint64_t length, uint64_t& outOffset)
+{
+	const auto alignedLength = Align(length);
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+
+	//first fit, the extents at the start of the file are reused before the end of the file is touched.
+	auto extent = _freeExtents.begin();
+	while (extent != _freeExtents.end() && extent->second < alignedLength)
+		++extent;
+
+	if (extent == _freeExtents.end())
+		return false;
+
+	outOffset = extent->first;
+	const auto extentLength = extent->second;
+	const auto remainingLength = extentLength - alignedLength;
+	_freeExtents.erase(extent);
+	if (remainingLength > 0)
+		_freeExtents[outOffset + alignedLength] = remainingLength;
+
+	_usedSizeInBytes += alignedLength;
+
+#if defined(_WIN32)
+	_file.seekp(static_cast<std::streamoff>(outOffset));
+	_file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(length));
+	if (!_file)
+	{
+		//the extent is restored as it was before this write.
+		_file.clear();
+		_freeExtents.erase(outOffset + alignedLength);
+		_freeExtents[outOffset] = extentLength;
+		_usedSizeInBytes -= alignedLength;
+		return false;
+	}
+#else
+	memcpy(_mapping + outOffset, data, length);
+#endif
+
+	return true;
+}
+
+inline bool SpillFile::Read(const uint64_t offset, const uint64_t length, unsigned char* destination)
+{
+	if (offset + length > _capacityInBytes)
+		return false;
+
+#if defined(_WIN32)
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	_file.seekg(static_cast<std::streamoff>(offset));
+	if (!_file.read(reinterpret_cast<char*>(destination), static_cast<std::streamsize>(length)))
+	{
+		_file.clear();
+		return false;
+	}
+#else
+	memcpy(destination, _mapping + offset, length);
+#endif
+
+	return true;
+}
+
+inline void SpillFile::Free(const uint64_t offset, const uint64_t length)
+{
+	auto alignedLength = Align(length);
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	_usedSizeInBytes -= alignedLength;
+
+	auto freedOffset = offset;
+	auto next = _freeExtents.lower_bound(offset);
+
+	//coalesce with the free extent before this one, if they are adjacent.
+	if (next != _freeExtents.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			freedOffset = previous->first;
+			alignedLength += previous->second;
+			_freeExtents.erase(previous);
+		}
+	}
+
+	//and with the free extent after it.
+	if (next != _freeExtents.end() && offset + Align(length) == next->first)
+	{
+		alignedLength += next->second;
+		_freeExtents.erase(next);
+	}
+
+	_freeExtents[freedOffset] = alignedLength;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include "ImagePathTable.h"
+
+/// <summary>
+/// Requests for an image answered by a <see cref="ThreadLocalImageLookup"/> since the cache last folded them into its own
+/// bookkeeping. Hits are recorded with relaxed atomics, so that they cost no lock and the cache still sees the image as being used.
+/// </summary>
+struct ThreadLocalHitCounter
+{
+	std::atomic<uint32_t> HitCount = 0;
+
+	/// <summary>
+	/// Time of the last hit, as a count of steady clock ticks.
+	/// </summary>
+	std::atomic<std::chrono::steady_clock::rep> LastHitTime = 0;
+};
+
+/// <summary>
+/// A small direct-mapped table per thread of weak references to images recently found in a cache, keyed by the handle of their
+/// interned path, see <see cref="ImagePathTable"/>, and their size. Repeated lookups of the same images, e.g. by a UI thread every
+/// frame, are answered from the calling thread's table without taking the cache's lock, hashing or comparing a path. Each slot
+/// holds a reference to its handle, so that the handle is not reused for another path while the slot refers to it. Every slot records the epoch it was filled in. A cache bumps the global epoch whenever it removes or invalidates an
+/// image, which invalidates every table at the cost of one atomic increment. Hits are counted on the image's
+/// <see cref="ThreadLocalHitCounter"/>, which the cache folds into its access counts.
+/// </summary>
+template<typename TImage>
+class ThreadLocalImageLookup final
+{
+	static constexpr size_t SlotCount = 256;
+
+	struct Slot
+	{
+		const void* Owner = nullptr;
+		uint64_t Epoch = 0;
+		ImageId Id{};
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		std::weak_ptr<const TImage> Image;
+		std::shared_ptr<ThreadLocalHitCounter> Hits;
+	};
+
+	struct Table
+	{
+		std::array<Slot, SlotCount> Slots;
+		uint64_t HitCount = 0;
+
+		~Table()
+		{
+			for (const auto& slot : Slots)
+			{
+				if (slot.Owner)
+					ImagePathTable::GetShared().Release(slot.Id);
+			}
+		}
+	};
+
+	static inline std::atomic<uint64_t> _epoch = 1;
+
+	static Table& GetTable()
+	{
+		thread_local Table table;
+		return table;
+	}
+
+	static size_t GetSlotIndex(const ImageId imageId, const unsigned int width, const unsigned int height)
+	{
+		const auto id = static_cast<uint32_t>(imageId);
+		return (id * 0x9E3779B1u ^ width * 0x85EBCA6Bu ^ height * 0xC2B2AE35u) >> 24;
+	}
+
+public:
+	/// <summary>
+	/// Invalidates the tables of every thread.
+	/// </summary>
+	static void Invalidate()
+	{
+		_epoch.fetch_add(1, std::memory_order_release);
+	}
+
+	/// <summary>
+	/// Gets an image from the calling thread's table.
+	/// </summary>
+	/// <param name="owner">The cache the image was found in.</param>
+	/// <returns>The image, or nullptr if it is not in the table, has been released, or was invalidated.</returns>
+	static std::shared_ptr<const TImage> TryGet(const void* owner, const ImageId imageId, const unsigned int width,
+		const unsigned int height)
+	{
+		auto& table = GetTable();
+		const auto& slot = table.Slots[GetSlotIndex(imageId, width, height)];
+		if (slot.Owner != owner || slot.Epoch != _epoch.load(std::memory_order_acquire) || slot.Id != imageId
+			|| slot.Width != width || slot.Height != height)
+			return nullptr;
+
+		auto image = slot.Image.lock();
+		if (image)
+		{
+			++table.HitCount;
+			slot.Hits->HitCount.fetch_add(1, std::memory_order_relaxed);
+			slot.Hits->LastHitTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		}
+
+		return image;
+	}
+
+	/// <summary>
+	/// Places an image in the calling thread's table, replacing whichever image occupied its slot.
+	/// </summary>
+	/// <param name="owner">The cache the image was found in.</param>
+	/// <param name="imageId">Handle the image was requested by, which the caller holds a reference to.</param>
+	/// <param name="hits">The counter the cache reads the image's hits from.</param>
+	static void Put(const void* owner, const ImageId imageId, const unsigned int width, const unsigned int height,
+		const std::shared_ptr<const TImage>& image, std::shared_ptr<ThreadLocalHitCounter> hits)
+	{
+		auto& pathTable = ImagePathTable::GetShared();
+		auto& slot = GetTable().Slots[GetSlotIndex(imageId, width, height)];
+		pathTable.AddReference(imageId);
+		if (slot.Owner)
+			pathTable.Release(slot.Id);
+
+		slot.Owner = owner;
+		slot.Epoch = _epoch.load(std::memory_order_acquire);
+		slot.Id = imageId;
+		slot.Width = width;
+		slot.Height = height;
+		slot.Image = image;
+		slot.Hits = std::move(hits);
+	}
+
+	/// <summary>
+	/// Gets the number of lookups answered from the calling thread's table.
+	/// </summary>
+	static uint64_t GetHitCount()
+	{
+		return GetTable().HitCount;
+	}
+};
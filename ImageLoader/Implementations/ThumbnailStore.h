@@ -0,0 +1,190 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include "../Assert.h"
+#include "FileStatCache.h"
+
+/// <summary>
+/// A persistent store of resized rgba pixel data on disk, which outlives the process so that thumbnails created by an earlier run can
+/// be served on a cold start without decoding or resizing. Pixel data is appended to a single data file, which is memory mapped for
+/// reading where supported, and located through an index that is loaded on construction and saved on destruction. Each thumbnail is
+/// keyed by the path of its source file and its dimensions, and is only returned while the source file's <see cref="FileStat"/> is
+/// unchanged. The least recently used thumbnails are removed when the store exceeds its maximum size. This class is threadsafe.
+/// </summary>
+class ThumbnailStore final
+{
+	struct Record
+	{
+		FileStat SourceStat;
+		int Width = 0;
+		int Height = 0;
+		uint64_t Offset = 0;
+		uint64_t Length = 0;
+		uint64_t LastAccess = 0;
+	};
+
+	static constexpr uint32_t FileMagic = 0x53544C49;//"ILTS"
+	static constexpr uint32_t FileVersion = 1;
+	static constexpr uint64_t DataHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+
+	const std::filesystem::path _indexPath;
+	const std::filesystem::path _dataPath;
+	int64_t _maxSizeInBytes;
+
+	mutable std::mutex _lock;
+	std::map<const std::string, Record> _records;
+
+	/// <summary>
+	/// The records ordered by last access, so that trimming removes the least recently used without scanning every record. Points
+	/// to the keys of <see cref="_records"/>.
+	/// </summary>
+	std::set<std::pair<uint64_t, const std::string*>> _recordsByAccess;
+	uint64_t _accessTick = 0;
+
+	/// <summary>
+	/// Identifies the data file that the index describes, so that an index saved for a data file that has since been replaced is
+	/// not trusted.
+	/// </summary>
+	uint64_t _generation = 0;
+	uint64_t _dataFileSize = 0;
+	int64_t _liveSizeInBytes = 0;
+	bool _indexChanged = false;
+
+	/// <summary>
+	/// Whether thumbnails were written to the data file since it was last flushed. The data file is flushed before it is mapped and
+	/// before the index is saved, rather than on every write.
+	/// </summary>
+	bool _hasUnflushedData = false;
+
+	std::fstream _dataFile;
+#if !defined(_WIN32)
+	const unsigned char* _mapping = nullptr;
+	size_t _mappingSize = 0;
+#endif
+
+public:
+	/// <summary>
+	/// Opens the store in the provided directory, creating it if it does not exist.
+	/// </summary>
+	/// <param name="directory">Directory in which the index and data files are kept.</param>
+	/// <param name="maxSizeInBytes">Maximum number of bytes of pixel data kept in the store.</param>
+	ThumbnailStore(const std::filesystem::path& directory, int64_t maxSizeInBytes);
+
+	~ThumbnailStore();
+
+	ThumbnailStore(const ThumbnailStore&) = delete;
+	ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+	/// <summary>
+	/// Reads the pixel data of a stored thumbnail.
+	/// </summary>
+	/// <param name="sourcePath">Path of the file the thumbnail was created from.</param>
+	/// <param name="sourceStat">The current stat of the source file. A thumbnail stored for a different stat is stale, and is removed.</param>
+	/// <param name="width">Width in pixels of the thumbnail.</param>
+	/// <param name="height">Height in pixels of the thumbnail.</param>
+	/// <param name="outPixels">The rgba pixel data, allocated with new[] and owned by the caller.</param>
+	/// <returns>True if the thumbnail was found.</returns>
+	bool TryRead(const std::filesystem::path& sourcePath, const FileStat& sourceStat, int width, int height, unsigned char*& outPixels);
+
+	/// <summary>
+	/// Stores the pixel data of a thumbnail, replacing any thumbnail stored for the same path and dimensions.
+	/// </summary>
+	/// <param name="sourcePath">Path of the file the thumbnail was created from.</param>
+	/// <param name="sourceStat">The stat of the source file the thumbnail was created from.</param>
+	/// <param name="width">Width in pixels of the thumbnail.</param>
+	/// <param name="height">Height in pixels of the thumbnail.</param>
+	/// <param name="pixels">The rgba pixel data.</param>
+	/// <returns>True if the thumbnail was stored.</returns>
+	bool TryWrite(const std::filesystem::path& sourcePath, const FileStat& sourceStat, int width, int height, const unsigned char* pixels);
+
+	/// <summary>
+	/// Writes the index to disk, if it has changed since it was last written. Thumbnails written since the index was last saved are
+	/// lost if the process exits without saving it.
+	/// </summary>
+	void SaveIndex();
+
+	/// <summary>
+	/// Sets the maximum number of bytes of pixel data kept in the store, removing the least recently used thumbnails if it is exceeded.
+	/// </summary>
+	void SetMaxSize(int64_t maxSizeInBytes);
+
+	int64_t GetMaxSize() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _maxSizeInBytes;
+	}
+
+	/// <summary>
+	/// Gets the number of bytes of pixel data of the thumbnails in the store.
+	/// </summary>
+	int64_t GetSizeInBytes() const
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _liveSizeInBytes;
+	}
+
+	size_t GetThumbnailCount()
+	{
+		std::lock_guard<std::mutex> lockGuard(_lock);
+		return _records.size();
+	}
+
+private:
+	template<typename T>
+	static void WriteValue(std::ostream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool ReadValue(std::istream& stream, T& outValue)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&outValue), sizeof(T)));
+	}
+
+	static std::string MakeKey(const std::filesystem::path& sourcePath, int width, int height);
+
+	/// <summary>
+	/// Loads the index, discarding the store if the index is missing, corrupt, or does not describe the data file.
+	/// </summary>
+	void Open();
+
+	/// <summary>
+	/// Creates an empty data file with a new generation, replacing any existing one.
+	/// </summary>
+	/// <returns>The generation of the new data file.</returns>
+	static uint64_t CreateDataFile(const std::filesystem::path& path);
+
+	bool TryLoadIndex();
+
+	void AddRecord(const std::string& key, const Record& record);
+
+	void RemoveRecord(std::map<const std::string, Record>::iterator record);
+
+	void TouchRecord(std::map<const std::string, Record>::iterator record);
+
+	/// <summary>
+	/// Writes thumbnails buffered by the data file stream to disk. Returns false if they could not be written.
+	/// </summary>
+	bool FlushData();
+
+	/// <summary>
+	/// Removes the least recently used thumbnails until the store is within its maximum size, and rewrites the data file without the
+	/// space of removed thumbnails once that space outweighs the thumbnails that remain.
+	/// </summary>
+	void Trim();
+
+	void Compact();
+
+	bool ReadData(uint64_t offset, uint64_t length, unsigned char* destination);
+
+	void Unmap();
+};
+
+
+#include "ThumbnailStore.inl"
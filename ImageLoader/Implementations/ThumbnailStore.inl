@@ -0,0 +1,389 @@
+#include "ThumbnailStore.h"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+inline ThumbnailStore::ThumbnailStore(const std::filesystem::path& directory, const int64_t maxSizeInBytes)
+	: _indexPath(directory / "thumbnails.idx")
+	, _dataPath(directory / "thumbnails.dat")
+	, _maxSizeInBytes(maxSizeInBytes)
+{
+	std::error_code errorCode;
+	std::filesystem::create_directories(directory, errorCode);
+	if (errorCode)
+		throw std::runtime_error("Failed to create the thumbnail store directory " + directory.string() + ": " + errorCode.message());
+
+	Open();
+}
+
+inline ThumbnailStore::~ThumbnailStore()
+{
+	SaveIndex();
+	Unmap();
+}
+
+inline std::string ThumbnailStore::MakeKey(const std::filesystem::path& sourcePath, const int width, const int height)
+{
+	return sourcePath.string() + ":" + std::to_string(width) + ":" + std::to_string(height);
+}
+
+inline void ThumbnailStore::Open()
+{
+	if (!TryLoadIndex())
+	{
+		_records.clear();
+		_recordsByAccess.clear();
+		_liveSizeInBytes = 0;
+		_accessTick = 0;
+		_generation = CreateDataFile(_dataPath);
+		_dataFileSize = DataHeaderSize;
+		_indexChanged = true;
+	}
+
+	_dataFile.open(_dataPath, std::ios::in | std::ios::out | std::ios::binary);
+	if (!_dataFile)
+		throw std::runtime_error("Failed to open the thumbnail store data file " + _dataPath.string());
+
+	Trim();
+}
+
+inline uint64_t ThumbnailStore::CreateDataFile(const std::filesystem::path& path)
+{
+	const auto generation = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+
+	std::ofstream dataFile(path, std::ios::binary | std::ios::trunc);
+	WriteValue(dataFile, FileMagic);
+	WriteValue(dataFile, FileVersion);
+	WriteValue(dataFile, generation);
+	if (!dataFile)
+		throw std::runtime_error("Failed to create the thumbnail store data file " + path.string());
+
+	return generation;
+}
+
+inline bool ThumbnailStore::TryLoadIndex()
+{
+	std::ifstream index(_indexPath, std::ios::binary);
+	std::ifstream data(_dataPath, std::ios::binary | std::ios::ate);
+	if (!index || !data)
+		return false;
+
+	const auto actualDataFileSize = static_cast<uint64_t>(data.tellg());
+	data.seekg(0, std::ios::beg);
+
+	uint32_t magic, version, dataMagic, dataVersion;
+	uint64_t dataGeneration, recordCount;
+	if (!ReadValue(index, magic) || !ReadValue(index, version) || !ReadValue(index, _generation)
+		|| !ReadValue(index, _dataFileSize) || !ReadValue(index, _accessTick) || !ReadValue(index, recordCount)
+		|| magic != FileMagic || version != FileVersion)
+		return false;
+
+	if (!ReadValue(data, dataMagic) || !ReadValue(data, dataVersion) || !ReadValue(data, dataGeneration)
+		|| dataMagic != FileMagic || dataVersion != FileVersion || dataGeneration != _generation
+		|| _dataFileSize < DataHeaderSize || _dataFileSize > actualDataFileSize)
+		return false;
+
+	for (uint64_t i = 0; i < recordCount; i++)
+	{
+		uint32_t keyLength;
+		if (!ReadValue(index, keyLength))
+			return false;
+
+		std::string key(keyLength, '\0');
+		Record record;
+		if (!index.read(key.data(), keyLength)
+			|| !ReadValue(index, record.SourceStat.SizeInBytes) || !ReadValue(index, record.SourceStat.ModifiedTime)
+			|| !ReadValue(index, record.SourceStat.FileId) || !ReadValue(index, record.Width) || !ReadValue(index, record.Height)
+			|| !ReadValue(index, record.Offset) || !ReadValue(index, record.Length) || !ReadValue(index, record.LastAccess))
+			return false;
+
+		if (record.Width <= 0 || record.Height <= 0 || record.Length != static_cast<uint64_t>(record.Width) * record.Height * 4
+			|| record.Offset < DataHeaderSize || record.Offset + record.Length > _dataFileSize)
+			return false;
+
+		if (_records.contains(key))
+			return false;
+
+		AddRecord(key, record);
+	}
+
+	return true;
+}
+
+inline void ThumbnailStore::SaveIndex()
+{
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	if (!_indexChanged)
+		return;
+
+	//the index must not describe thumbnails that are not in the data file.
+	if (!FlushData())
+		return;
+
+	//written beside the index and then renamed over it, so that a crash while saving leaves the previous index intact.
+	auto temporaryPath = _indexPath;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream index(temporaryPath, std::ios::binary | std::ios::trunc);
+		WriteValue(index, FileMagic);
+		WriteValue(index, FileVersion);
+		WriteValue(index, _generation);
+		WriteValue(index, _dataFileSize);
+		WriteValue(index, _accessTick);
+		WriteValue(index, static_cast<uint64_t>(_records.size()));
+
+		for (const auto& [key, record] : _records)
+		{
+			WriteValue(index, static_cast<uint32_t>(key.size()));
+			index.write(key.data(), static_cast<std::streamsize>(key.size()));
+			WriteValue(index, record.SourceStat.SizeInBytes);
+			WriteValue(index, record.SourceStat.ModifiedTime);
+			WriteValue(index, record.SourceStat.FileId);
+			WriteValue(index, record.Width);
+			WriteValue(index, record.Height);
+			WriteValue(index, record.Offset);
+			WriteValue(index, record.Length);
+			WriteValue(index, record.LastAccess);
+		}
+
+		if (!index)
+			return;
+	}
+
+	std::error_code errorCode;
+	std::filesystem::rename(temporaryPath, _indexPath, errorCode);
+	if (!errorCode)
+		_indexChanged = false;
+}
+
+inline void ThumbnailStore::SetMaxSize(const int64_t maxSizeInBytes)
+{
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	_maxSizeInBytes = maxSizeInBytes;
+	Trim();
+}
+
+inline bool ThumbnailStore::TryRead(const std::filesystem::path& sourcePath, const FileStat& sourceStat,
+	const int width, const int height, unsigned char*& outPixels)
+{
+	outPixels = nullptr;
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	const auto search = _records.find(MakeKey(sourcePath, width, height));
+	if (search == _records.end())
+		return false;
+
+	auto& record = search->second;
+	if (!(record.SourceStat == sourceStat))
+	{
+		//the source file has changed since the thumbnail was created.
+		RemoveRecord(search);
+		return false;
+	}
+
+	auto* pixels = new unsigned char[record.Length];
+	if (!ReadData(record.Offset, record.Length, pixels))
+	{
+		delete[] pixels;
+		RemoveRecord(search);
+		return false;
+	}
+
+	TouchRecord(search);
+	outPixels = pixels;
+	return true;
+}
+
+inline bool ThumbnailStore::TryWrite(const std::filesystem::path& sourcePath, const FileStat& sourceStat,
+	const int width, const int height, const unsigned char* pixels)
+{
+	const auto length = static_cast<uint64_t>(width) * height * 4;
+	if (width <= 0 || height <= 0 || !pixels)
+		return false;
+
+	std::lock_guard<std::mutex> lockGuard(_lock);
+	if (static_cast<int64_t>(length) > _maxSizeInBytes)
+		return false;
+
+	const auto key = MakeKey(sourcePath, width, height);
+	if (auto search = _records.find(key); search != _records.end())
+		RemoveRecord(search);
+
+	_dataFile.seekp(static_cast<std::streamoff>(_dataFileSize));
+	_dataFile.write(reinterpret_cast<const char*>(pixels), static_cast<std::streamsize>(length));
+	if (!_dataFile)
+	{
+		_dataFile.clear();
+		return false;
+	}
+
+	Record record;
+	record.SourceStat = sourceStat;
+	record.Width = width;
+	record.Height = height;
+	record.Offset = _dataFileSize;
+	record.Length = length;
+	record.LastAccess = ++_accessTick;
+	AddRecord(key, record);
+
+	_dataFileSize += length;
+	_hasUnflushedData = true;
+	_indexChanged = true;
+
+	Trim();
+	return true;
+}
+
+inline void ThumbnailStore::AddRecord(const std::string& key, const Record& record)
+{
+	const auto added = _records.emplace(key, record).first;
+	_recordsByAccess.emplace(record.LastAccess, &added->first);
+	_liveSizeInBytes += static_cast<int64_t>(record.Length);
+}
+
+inline void ThumbnailStore::RemoveRecord(const std::map<const std::string, Record>::iterator record)
+{
+	_liveSizeInBytes -= static_cast<int64_t>(record->second.Length);
+	_recordsByAccess.erase({ record->second.LastAccess, &record->first });
+	_records.erase(record);
+	_indexChanged = true;
+}
+
+inline void ThumbnailStore::TouchRecord(const std::map<const std::string, Record>::iterator record)
+{
+	_recordsByAccess.erase({ record->second.LastAccess, &record->first });
+	record->second.LastAccess = ++_accessTick;
+	_recordsByAccess.emplace(record->second.LastAccess, &record->first);
+	_indexChanged = true;
+}
+
+inline bool ThumbnailStore::FlushData()
+{
+	if (!_hasUnflushedData)
+		return true;
+
+	if (!_dataFile.flush())
+	{
+		_dataFile.clear();
+		return false;
+	}
+
+	_hasUnflushedData = false;
+	return true;
+}
+
+inline void ThumbnailStore::Trim()
+{
+	while (_liveSizeInBytes > _maxSizeInBytes && !_recordsByAccess.empty())
+		RemoveRecord(_records.find(*_recordsByAccess.begin()->second));
+
+	const auto deadSizeInBytes = static_cast<int64_t>(_dataFileSize - DataHeaderSize) - _liveSizeInBytes;
+	if (deadSizeInBytes > _liveSizeInBytes)
+		Compact();
+}
+
+inline void ThumbnailStore::Compact()
+{
+	auto temporaryPath = _dataPath;
+	temporaryPath += ".tmp";
+
+	const auto generation = CreateDataFile(temporaryPath);
+	std::ofstream compacted(temporaryPath, std::ios::binary | std::ios::app);
+
+	//records are copied in offset order, so that thumbnails which were stored together remain together.
+	std::multimap<uint64_t, Record*> recordsByOffset;
+	for (auto& record : _records)
+		recordsByOffset.emplace(record.second.Offset, &record.second);
+
+	std::map<Record*, uint64_t> newOffsets;
+	uint64_t offset = DataHeaderSize;
+	std::vector<unsigned char> buffer;
+	for (const auto& [oldOffset, record] : recordsByOffset)
+	{
+		buffer.resize(record->Length);
+		if (!ReadData(oldOffset, record->Length, buffer.data()))
+			return;
+
+		compacted.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(record->Length));
+		newOffsets[record] = offset;
+		offset += record->Length;
+	}
+
+	compacted.close();
+	if (!compacted)
+		return;
+
+	Unmap();
+	_dataFile.close();
+	_hasUnflushedData = false;
+
+	std::error_code errorCode;
+	std::filesystem::rename(temporaryPath, _dataPath, errorCode);
+	_dataFile.open(_dataPath, std::ios::in | std::ios::out | std::ios::binary);
+	if (errorCode)
+		return;
+
+	for (const auto& [record, newOffset] : newOffsets)
+		record->Offset = newOffset;
+
+	_generation = generation;
+	_dataFileSize = offset;
+	_indexChanged = true;
+}
+
+inline bool ThumbnailStore::ReadData(const uint64_t offset, const uint64_t length, unsigned char* destination)
+{
+#if defined(_WIN32)
+	_dataFile.seekg(static_cast<std::streamoff>(offset));
+	if (!_dataFile.read(reinterpret_cast<char*>(destination), static_cast<std::streamsize>(length)))
+	{
+		_dataFile.clear();
+		return false;
+	}
+
+	return true;
+#else
+	//the data file only grows between compactions, it is flushed and mapped again once a read falls beyond the current mapping.
+	if (offset + length > _mappingSize)
+	{
+		Unmap();
+		if (!FlushData())
+			return false;
+
+		const int fileDescriptor = open(_dataPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fileDescriptor < 0)
+			return false;
+
+		void* mapping = mmap(nullptr, _dataFileSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+		close(fileDescriptor);
+		if (mapping == MAP_FAILED)
+			return false;
+
+		_mapping = static_cast<const unsigned char*>(mapping);
+		_mappingSize = _dataFileSize;
+		if (offset + length > _mappingSize)
+			return false;
+	}
+
+	memcpy(destination, _mapping + offset, length);
+	return true;
+#endif
+}
+
+inline void ThumbnailStore::Unmap()
+{
+#if !defined(_WIN32)
+	if (_mapping)
+		munmap(const_cast<unsigned char*>(_mapping), _mappingSize);
+
+	_mapping = nullptr;
+	_mappingSize = 0;
+#endif
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "FrequencySketch.h"
+
+/// <summary>
+/// Settings for <see cref="TinyLfuAdmissionFilter"/>.
+/// </summary>
+struct AdmissionFilterSettings
+{
+	/// <summary>
+	/// Fraction of the cache's maximum memory reserved as the admission window. Every new image is admitted into the window, so
+	/// that newly requested images get a chance to build up frequency before they have to compete for the main region.
+	/// </summary>
+	double WindowFraction = 0.01;
+
+	/// <summary>
+	/// The approximate number of distinct images expected to be requested, used to size the frequency sketch.
+	/// </summary>
+	size_t ExpectedEntryCount = 4096;
+};
+
+/// <summary>
+/// Window TinyLFU style admission filter. Requests for each key are counted in a <see cref="FrequencySketch"/>; newly requested
+/// images are admitted into a small window, and an image leaving the window only displaces an image of the rest of the cache if it
+/// was requested more often. This prevents a single pass over a large set of images from displacing the images which are actually
+/// requested repeatedly. The owning cache places the images, this class only counts requests and sizes the window. This class is
+/// not threadsafe, the owning cache is responsible for synchronization.
+/// </summary>
+class TinyLfuAdmissionFilter final
+{
+	AdmissionFilterSettings _settings;
+	FrequencySketch _sketch;
+
+public:
+	TinyLfuAdmissionFilter(const AdmissionFilterSettings& settings)
+		: _settings(settings)
+		, _sketch(settings.ExpectedEntryCount)
+	{
+		if (settings.WindowFraction < 0.0 || settings.WindowFraction > 1.0)
+			throw std::runtime_error("Admission window fraction must be between 0 and 1");
+	}
+
+	/// <summary>
+	/// Records a request for the image identified by the key.
+	/// </summary>
+	void RecordAccess(const std::string& key)
+	{
+		_sketch.Increment(std::hash<std::string>{}(key));
+	}
+
+	/// <summary>
+	/// Gets the estimated number of recent requests for the image identified by the key.
+	/// </summary>
+	[[nodiscard]]
+	uint32_t EstimateFrequency(const std::string& key) const
+	{
+		return _sketch.EstimateFrequency(std::hash<std::string>{}(key));
+	}
+
+	/// <summary>
+	/// Gets the number of bytes reserved for the admission window, for a cache with the provided maximum memory.
+	/// </summary>
+	[[nodiscard]]
+	int64_t GetWindowSizeInBytes(const int64_t maxMemory) const
+	{
+		return static_cast<int64_t>(static_cast<double>(maxMemory) * _settings.WindowFraction);
+	}
+};
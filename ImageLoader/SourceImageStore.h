@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Image.h"
+#include "ImageCache.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace ImageCaching
+{
+	/// <summary>
+	/// Stores decoded source images independently of the image type of any cache, so that several caches, and the loaders using them,
+	/// can share one decoded copy of each file under one memory budget.
+	/// </summary>
+	struct ISourceImageStore
+	{
+	protected:
+		~ISourceImageStore() = default;
+
+	public:
+		/// <summary>
+		/// Sets the maximum memory in bytes of the source images held by the store.
+		/// </summary>
+		virtual void SetMaxMemory(int64_t maximumMemoryInBytes) = 0;
+
+		virtual int64_t GetMaxMemory() const = 0;
+
+		/// <summary>
+		/// Gets the source image decoded from the file at the path.
+		/// </summary>
+		/// <param name="imagePath">Path to the image file.</param>
+		/// <param name="outSourceImage">The source image, or nullptr if it is not stored.</param>
+		/// <returns>True if the source image was found.</returns>
+		virtual bool TryGetSourceImage(const std::filesystem::path& imagePath, std::shared_ptr<const IImageSource>& outSourceImage) = 0;
+
+		/// <summary>
+		/// Stores a source image, under the path it was loaded from.
+		/// </summary>
+		/// <param name="image">The source image.</param>
+		/// <param name="creationCost">The measured time it took to decode the image.</param>
+		/// <returns>Added, NoChange if a source image is already stored for the path, or OutOfMemory.</returns>
+		virtual TryAddImageResult TryAddSourceImage(std::shared_ptr<const IImageSource> image, std::chrono::microseconds creationCost) = 0;
+
+		/// <summary>
+		/// Removes the source image stored for the path, e.g. because the file changed. Callers holding the source image keep it alive
+		/// until they release it.
+		/// </summary>
+		/// <returns>True if a source image was removed.</returns>
+		virtual bool TryRemoveSourceImage(const std::filesystem::path& imagePath) = 0;
+	};
+}
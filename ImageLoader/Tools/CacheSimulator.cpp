@@ -0,0 +1,63 @@
+// CacheSimulator.cpp : Replays a request trace recorded by ImageLoader::SetRequestTraceRecorder through simulated caches, to choose
+// a cache budget and eviction policy offline.
+//
+// Usage: CacheSimulator <trace file> [lru|gdsf] [budget in MiB]...
+
+#include "../Implementations/CacheSimulator.h"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: CacheSimulator <trace file> [lru|gdsf] [budget in MiB]..." << "\n";
+		return 1;
+	}
+
+	std::vector<RequestTraceEntry> trace;
+	if (!RequestTraceRecorder::TryLoad(argv[1], trace))
+	{
+		std::cout << "Failed to read the request trace " << argv[1] << "\n";
+		return 1;
+	}
+
+	CacheSimulationSettings settings;
+	int budgetArgument = 2;
+	if (argc > 2 && (std::string(argv[2]) == "lru" || std::string(argv[2]) == "gdsf"))
+	{
+		const auto policy = std::string(argv[2]) == "gdsf" ? EvictionPolicy::GreedyDualSizeFrequency : EvictionPolicy::LeastRecentlyUsed;
+		settings.SourcePolicy = policy;
+		settings.ResizedPolicy = policy;
+		budgetArgument = 3;
+	}
+
+	constexpr int64_t bytesPerMiB = 1024 * 1024;
+	std::vector<int64_t> budgets;
+	for (int i = budgetArgument; i < argc; i++)
+		budgets.push_back(std::atoll(argv[i]) * bytesPerMiB);
+
+	//without budgets, a doubling series covers everything from a small cache to one that holds most traces entirely.
+	if (budgets.empty())
+	{
+		for (int64_t budget = 16 * bytesPerMiB; budget <= 4096 * bytesPerMiB; budget *= 2)
+			budgets.push_back(budget);
+	}
+
+	std::cout << trace.size() << " requests" << "\n";
+	std::cout << "budget MiB\thit rate\tbyte hit rate\trecompute ms" << "\n";
+
+	const CacheSimulator simulator(std::move(trace));
+	for (const auto& result : simulator.SimulateBudgets(budgets, settings))
+	{
+		std::cout << result.MaxMemory / bytesPerMiB << "\t"
+			<< std::fixed << std::setprecision(3) << result.GetHitRate() << "\t"
+			<< result.GetByteHitRate() << "\t"
+			<< result.RecomputeCost.count() / 1000 << "\n";
+	}
+
+	return 0;
+}
@@ -1,10 +1,1153 @@
 #pragma once
+#include "UnitTestsSetup.h"
+#include "TestImplementations.h"
+#include "../Implementations/CacheSimulator.h"
+#include "../Implementations/ImageCache.h"
+#include "../Implementations/ImageLoader.h"
+#include "../Implementations/ImageSource.h"
+#include "../Implementations/SharedImageSourceStore.h"
+#include "../Implementations/SharedMemorySourceStore.h"
+#include "../Implementations/ThumbnailStore.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Assert.h"
 
 
 namespace UnitTests
 {
 	class ImageCacheTests
 	{
+		/// <summary>
+		/// Room in a cache's budget for the bookkeeping of the few entries a test adds, which is less than one 64 by 64 image.
+		/// </summary>
+		static constexpr int64_t MetadataAllowance = 4096;
 
+		/// <summary>
+		/// Constructs a source image with uninitialized pixel data, for tests that only depend on image dimensions.
+		/// </summary>
+		static std::shared_ptr<const IImageSource> MakeSourceImage(const std::string& fileName, const int width, const int height)
+		{
+			auto* pixels = static_cast<unsigned char*>(malloc(static_cast<size_t>(width) * height * 4));
+			return std::make_shared<ImageSource>(std::filesystem::path(fileName), width, height, pixels);
+		}
+
+		static ImageCaching::CacheInsertInfo MakeInsertInfo(const int64_t creationCostInMicroseconds)
+		{
+			ImageCaching::CacheInsertInfo result;
+			result.CreationCost = std::chrono::microseconds(creationCostInMicroseconds);
+			return result;
+		}
+
+	public:
+		void AdmissionFilterRejectsOneHitImages(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 16 * 16 * 4;
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			{
+				//while the cache has room every image is admitted, including those larger than the window.
+				ImageCache<TestImage> cache(imageSize * 100);
+				cache.EnableAdmissionFilter(AdmissionFilterSettings());
+				ASSERT(cache.TryAddSourceImage(MakeSourceImage("large.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+				for (int i = 0; i < 10; i++)
+				{
+					const auto fileName = "once_" + std::to_string(i) + ".png";
+					ASSERT(cache.TryAddSourceImage(MakeSourceImage(fileName, 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+				}
+
+				ASSERT(cache.GetCacheEntryCount() == 11);
+			}
+
+			ImageCache<TestImage> cache(imageSize * 100);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			for (int i = 0; i < 3; i++)
+			{
+				const auto fileName = "hot_" + std::to_string(i) + ".png";
+				cache.TryGetImage(fileName, image, source);
+				cache.TryGetImage(fileName, image, source);
+				ASSERT(cache.TryAddSourceImage(MakeSourceImage(fileName, 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			}
+
+			cache.TryGetImage("one_0.png", image, source);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("one_0.png", 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			//the cache is now full, with a window that has room for one image.
+			cache.SetMaxMemory(cache.GetTotalMemoryUsage());
+			AdmissionFilterSettings settings;
+			settings.WindowFraction = 0.3;
+			cache.EnableAdmissionFilter(settings);
+			for (int i = 0; i < 3; i++)
+			{
+				cache.TryGetImage("hot_" + std::to_string(i) + ".png", image, source);
+				cache.TryGetImage("hot_" + std::to_string(i) + ".png", image, source);
+			}
+
+			//a one-off image pushes the previous one out of the window, which is evicted rather than a more frequent image.
+			cache.TryGetImage("one_1.png", image, source);
+			cache.TryGetImage("one_2.png", image, source);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("one_1.png", 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("one_2.png", 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 4);
+			ASSERT(cache.TryGetImage("one_1.png", image, source) == TryGetImageResult::NotFound);
+
+			//an image that was requested more often than the next victim of the main region displaces it when it leaves the window.
+			for (int i = 0; i < 4; i++)
+				cache.TryGetImage("one_2.png", image, source);
+
+			cache.TryGetImage("one_3.png", image, source);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("one_3.png", 16, 16), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 4);
+			ASSERT(cache.TryGetImage("hot_0.png", image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache.TryGetImage("one_2.png", image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(cache.TryGetImage("hot_1.png", image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			outMessage = "test: AdmissionFilterRejectsOneHitImages passed";
+		}
+
+		void CostAwareEvictionKeepsExpensiveImages(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize * 2 + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::GreedyDualSizeFrequency);
+
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("expensive.jpg", 64, 64), MakeInsertInfo(10000)) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("cheap.bmp", 64, 64), MakeInsertInfo(10)) == TryAddImageResult::Added);
+
+			//the cache is full, the cheapest image to re-create is evicted to make room.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("new.jpg", 64, 64), MakeInsertInfo(100)) == TryAddImageResult::Added);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize * 2);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImage("cheap.bmp", image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache.TryGetImage("expensive.jpg", image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			outMessage = "test: CostAwareEvictionKeepsExpensiveImages passed";
+		}
+
+		void BulkEvictionFollowsAccessOrder(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize * 8 + MetadataAllowance * 2);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			for (int i = 0; i < 8; i++)
+				ASSERT(cache.TryAddSourceImage(MakeSourceImage(std::to_string(i) + ".png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			//requesting the odd images moves them to the back of the eviction order, so shrinking the cache evicts the even ones.
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			for (int i = 7; i >= 1; i -= 2)
+				ASSERT(cache.TryGetImage(std::to_string(i) + ".png", image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			source = nullptr;
+			cache.SetMaxMemory(imageSize * 4 + MetadataAllowance);
+			ASSERT(cache.GetCacheEntryCount() == 4);
+			for (int i = 0; i < 8; i++)
+			{
+				const auto expected = i % 2 == 1 ? TryGetImageResult::FoundSourceImageOfDifferentDimensions : TryGetImageResult::NotFound;
+				ASSERT(cache.TryGetImage(std::to_string(i) + ".png", image, source) == expected);
+			}
+
+			outMessage = "test: BulkEvictionFollowsAccessOrder passed";
+		}
+
+		void ReleasedImagesAreRetainedWithinBudget(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 16 * 16 * 4;
+			ImageCache<TestImage> cache(imageSize * 10);
+			cache.SetMaxRetainedMemory(imageSize);
+
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("retained.png", 32, 32), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto image = cache.MakeSharedPtr(new TestImage(16, 16, "retained.png", nullptr));
+			const auto* imageInstance = image.get();
+			ASSERT(cache.TryAddImage(image, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+
+			//releasing the last reference keeps the image in the cache.
+			image = nullptr;
+			ASSERT(cache.GetRetainedMemoryUsage() == imageSize);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("retained.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image.get() == imageInstance);
+			ASSERT(cache.GetRetainedMemoryUsage() == 0);
+
+			//an image larger than the retention budget is deleted when released, which removes the entry.
+			auto largeImage = cache.MakeSharedPtr(new TestImage(32, 32, "retained.png", nullptr));
+			ASSERT(cache.TryAddImage(largeImage, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			largeImage = nullptr;
+			ASSERT(cache.GetRetainedMemoryUsage() == 0);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize * 5);
+
+			image = nullptr;
+			cache.SetMaxRetainedMemory(0);
+			ASSERT(cache.GetCacheEntryCount() == 0);
+			ASSERT(cache.GetCurrentMemoryUsage() == 0);
+			ASSERT(cache.GetMetadataMemoryUsage() == 0);
+
+			outMessage = "test: ReleasedImagesAreRetainedWithinBudget passed";
+		}
+
+		void SmallestLargerCopyIsUsedForResizing(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			cache.SetEvictSourceOnceResized(true);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("variants.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			//a thumbnail alone covers too little of the source to evict it.
+			const TestImage* existingImage = nullptr;
+			auto thumbnail = cache.MakeSharedPtr(new TestImage(8, 8, "variants.png", new unsigned char[8 * 8 * 4]));
+			ASSERT(cache.TryAddImage(thumbnail, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.GetSourceMemoryUsage() == 64 * 64 * 4);
+
+			auto large = cache.MakeSharedPtr(new TestImage(48, 48, "variants.png", new unsigned char[48 * 48 * 4]));
+			auto medium = cache.MakeSharedPtr(new TestImage(32, 32, "variants.png", new unsigned char[32 * 32 * 4]));
+			ASSERT(cache.TryAddImage(large, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.TryAddImage(medium, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("variants.png", 16, 16, image, source) == TryGetImageResult::FoundLargerImageOfDifferentDimensions);
+			ASSERT(image == medium);
+			ASSERT(!source);
+
+			ASSERT(cache.TryGetImageAtSize("variants.png", 40, 32, image, source) == TryGetImageResult::FoundLargerImageOfDifferentDimensions);
+			ASSERT(image == large);
+
+			//no copy is large enough, and the source was evicted once the copies were added.
+			ASSERT(cache.TryGetImageAtSize("variants.png", 56, 56, image, source) == TryGetImageResult::NotFound);
+
+			outMessage = "test: SmallestLargerCopyIsUsedForResizing passed";
+		}
+
+		void MipmapLevelIsUsedForResizing(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 2);
+			cache.SetGenerateMipmaps(true);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("mipmapped.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			//levels of 32x32, 16x16, 8x8, 4x4, 2x2 and 1x1 pixels.
+			ASSERT(cache.GetCurrentMemoryUsage() == (64 * 64 + 1365) * 4);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("mipmapped.png", 20, 12, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(source->GetWidth() == 32 && source->GetHeight() == 32);
+
+			ASSERT(cache.TryGetImageAtSize("mipmapped.png", 40, 8, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(source->GetWidth() == 64 && source->GetHeight() == 64);
+
+			outMessage = "test: MipmapLevelIsUsedForResizing passed";
+		}
+
+		void IdenticalFilesShareOneEntry(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			cache.SetMaxEncodedMemory(1024);
+
+			const auto contents = std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char>{ 1, 2, 3, 4 });
+			const std::vector<unsigned char> otherContents{ 1, 2, 3, 5 };
+			auto insertInfo = MakeInsertInfo(0);
+			insertInfo.ContentHash = 42;
+			insertInfo.EncodedBytes = contents;
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("original.png", 32, 32), insertInfo) == TryAddImageResult::Added);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageByContent("copy.png", 7, *contents, 16, 16, image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache.TryGetImageByContent("copy.png", 42, otherContents, 16, 16, image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache.TryGetImageByContent("copy.png", 42, *contents, 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(source->GetImagePath() == "original.png");
+
+			//an image created for the alias is added to the shared entry, and is found under either path.
+			const TestImage* existingImage = nullptr;
+			auto resized = cache.MakeSharedPtr(new TestImage(16, 16, "copy.png", nullptr));
+			ASSERT(cache.TryAddImage(resized, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.TryGetImageAtSize("original.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image == resized);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+
+			//a third copy that was decoded before its content was recognized is merged into the same entry.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("another_copy.png", 32, 32), insertInfo) == TryAddImageResult::NoChange);
+			ASSERT(cache.TryGetImageAtSize("another_copy.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+
+			//the bookkeeping of the aliases is released along with them.
+			const auto metadataWithAliases = cache.GetMetadataMemoryUsage();
+			ASSERT(cache.TryInvalidateImage("another_copy.png"));
+			ASSERT(cache.GetMetadataMemoryUsage() < metadataWithAliases);
+
+			//a different file whose hash collides gets its own entry, and removing it leaves the hash to the first file.
+			auto collidingInfo = insertInfo;
+			collidingInfo.EncodedBytes = std::make_shared<const std::vector<unsigned char>>(otherContents);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("colliding.png", 32, 32), collidingInfo) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 2);
+			ASSERT(cache.TryInvalidateImage("colliding.png"));
+			ASSERT(cache.TryGetImageByContent("third_copy.png", 42, *contents, 0, 0, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			//without kept contents, the file of the entry is compared instead.
+			const auto directory = std::filesystem::temp_directory_path() / "ImageCacheTests.content";
+			std::filesystem::create_directories(directory);
+			std::ofstream(directory / "original.png", std::ios::binary).write(reinterpret_cast<const char*>(contents->data()), 4);
+			ImageCache<TestImage> uncachedContentsCache(64 * 64 * 4 * 4);
+			ASSERT(uncachedContentsCache.TryAddSourceImage(MakeSourceImage((directory / "original.png").string(), 32, 32), insertInfo) == TryAddImageResult::Added);
+			ASSERT(uncachedContentsCache.TryGetImageByContent(directory / "copy.png", 42, otherContents, 0, 0, image, source) == TryGetImageResult::NotFound);
+			ASSERT(uncachedContentsCache.TryGetImageByContent(directory / "copy.png", 42, *contents, 0, 0, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			std::filesystem::remove_all(directory);
+
+			outMessage = "test: IdenticalFilesShareOneEntry passed";
+		}
+
+		void EvictedSourceIsSpilledAndRestored(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			cache.EnableSpillTier(std::filesystem::temp_directory_path() / "ImageCacheTests.spill", imageSize * 4);
+
+			auto spilled = MakeSourceImage("spilled.png", 64, 64);
+			memset(const_cast<unsigned char*>(spilled->GetPixels()), 7, imageSize);
+			ASSERT(cache.TryAddSourceImage(spilled, MakeInsertInfo(5000)) == TryAddImageResult::Added);
+			spilled = nullptr;
+
+			//adding a second source evicts the first one to the spill file instead of dropping it.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("other.png", 64, 64), MakeInsertInfo(5000)) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 2);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize);
+			ASSERT(cache.GetSpillUsage() == imageSize);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("spilled.png", 8, 8, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(source->GetWidth() == 64 && source->GetPixels()[imageSize - 1] == 7);
+
+			//restoring it evicted the other source to the spill file in turn.
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize);
+			ASSERT(cache.GetSpillUsage() == imageSize);
+
+			cache.DisableSpillTier();
+			ASSERT(cache.GetCacheEntryCount() == 1);
+
+			outMessage = "test: EvictedSourceIsSpilledAndRestored passed";
+		}
+
+		void EncodedBytesOutliveEvictedSource(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			const int encodedSize = 100;
+			ImageCache<TestImage> cache(imageSize + encodedSize * 2 + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			cache.SetMaxEncodedMemory(encodedSize * 4);
+
+			auto insertInfo = MakeInsertInfo(5000);
+			insertInfo.EncodedBytes = std::make_shared<std::vector<unsigned char>>(encodedSize, 7);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("encoded.png", 64, 64), insertInfo) == TryAddImageResult::Added);
+
+			//adding a second source evicts the decoded pixels of the first one, but not its encoded bytes.
+			insertInfo.EncodedBytes = std::make_shared<std::vector<unsigned char>>(encodedSize, 8);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("other.png", 64, 64), insertInfo) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 2);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize + encodedSize * 2);
+			ASSERT(cache.GetEncodedMemoryUsage() == encodedSize * 2);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			std::shared_ptr<const std::vector<unsigned char>> encodedBytes;
+			ASSERT(cache.TryGetImageAtSize("encoded.png", 8, 8, image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache.TryGetEncodedImage("encoded.png", encodedBytes));
+			ASSERT(encodedBytes->size() == encodedSize && encodedBytes->front() == 7);
+
+			//an entry holding nothing but encoded bytes is removed once they are dropped.
+			cache.SetMaxEncodedMemory(0);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize);
+			ASSERT(!cache.TryGetEncodedImage("other.png", encodedBytes));
+
+			outMessage = "test: EncodedBytesOutliveEvictedSource passed";
+		}
+
+		void PinnedImagesAreNeverEvicted(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize * 2 + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			cache.SetMaxPinnedMemory(imageSize * 2);
+
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("pinned.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.Pin("pinned.png", 0, 0));
+
+			const TestImage* existingImage = nullptr;
+			auto image = cache.MakeSharedPtr(new TestImage(32, 32, "pinned.png", nullptr));
+			const auto* imageInstance = image.get();
+			ASSERT(cache.TryAddImage(image, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.Pin("pinned.png", 32, 32));
+			ASSERT(!cache.Pin("missing.png", 8, 8));
+
+			//a pinned image is kept when released, even without a retention budget.
+			image = nullptr;
+			ASSERT(cache.GetPinnedMemoryUsage() == imageSize + imageSize / 4);
+			ASSERT(cache.GetRetainedMemoryUsage() == 0);
+
+			//nothing can be evicted to make room for another source.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("other.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::OutOfMemory);
+
+			ASSERT(cache.Unpin("pinned.png", 0, 0));
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("other.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("pinned.png", 32, 32, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image.get() == imageInstance);
+			image = nullptr;
+
+			//once unpinned, the released image does not fit the retention budget and is evicted along with its entry.
+			ASSERT(cache.Unpin("pinned.png", 32, 32));
+			ASSERT(cache.GetPinnedMemoryUsage() == 0);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+			ASSERT(cache.GetCurrentMemoryUsage() == imageSize);
+
+			outMessage = "test: PinnedImagesAreNeverEvicted passed";
+		}
+
+		void SnapshotRoundTripsHotImages(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("hot.png", 32, 32), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto cold = cache.MakeSharedPtr(new TestImage(8, 8, "hot.png", nullptr));
+			auto hot = cache.MakeSharedPtr(new TestImage(16, 16, "hot.png", nullptr));
+			ASSERT(cache.TryAddImage(cold, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.TryAddImage(hot, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("hot.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+
+			const auto snapshotPath = std::filesystem::temp_directory_path() / "ImageCacheTests.snapshot";
+			ASSERT(cache.SaveSnapshot(snapshotPath, 1));
+
+			std::vector<CacheSnapshotEntry> entries;
+			ASSERT(CacheSnapshot::TryLoad(snapshotPath, entries));
+			ASSERT(entries.size() == 1);
+			ASSERT(entries[0].ImagePath == "hot.png" && entries[0].Width == 16 && entries[0].AccessCount == 2);
+
+			std::filesystem::remove(snapshotPath);
+			outMessage = "test: SnapshotRoundTripsHotImages passed";
+		}
+
+		void TiersHaveSeparateBudgets(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize * 8 + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed, EvictionPolicy::GreedyDualSizeFrequency);
+			cache.SetMaxSourceMemory(imageSize);
+			cache.SetMaxResizedMemory(imageSize / 2);
+			cache.SetMaxRetainedMemory(imageSize);
+			ASSERT(cache.GetResizedEvictionPolicy() == EvictionPolicy::GreedyDualSizeFrequency);
+
+			//a second source exceeds the source budget, and evicts the first even though the cache has room.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("first.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("second.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+			ASSERT(cache.GetSourceMemoryUsage() == imageSize);
+
+			//referenced resized images fill the resized budget, so another cannot be added.
+			const TestImage* existingImage = nullptr;
+			auto released = cache.MakeSharedPtr(new TestImage(32, 32, "released.png", nullptr));
+			auto referenced = cache.MakeSharedPtr(new TestImage(32, 32, "referenced.png", nullptr));
+			auto added = cache.MakeSharedPtr(new TestImage(32, 32, "added.png", nullptr));
+			ASSERT(cache.TryAddImage(released, MakeInsertInfo(0), existingImage) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddImage(referenced, MakeInsertInfo(0), existingImage) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddImage(added, MakeInsertInfo(0), existingImage) == TryAddImageResult::OutOfMemory);
+
+			//once an image is released and retained, it is evicted to make room in the resized tier, leaving the source tier alone.
+			released = nullptr;
+			ASSERT(cache.GetRetainedMemoryUsage() == imageSize / 4);
+			ASSERT(cache.TryAddImage(added, MakeInsertInfo(0), existingImage) == TryAddImageResult::Added);
+			ASSERT(cache.GetRetainedMemoryUsage() == 0);
+			ASSERT(cache.GetResizedMemoryUsage() == imageSize / 2);
+			ASSERT(cache.GetSourceMemoryUsage() == imageSize);
+			ASSERT(cache.GetCacheEntryCount() == 3);
+
+			outMessage = "test: TiersHaveSeparateBudgets passed";
+		}
+
+		void NamespaceBudgetsIsolateConsumers(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			ImageCache<TestImage> cache(imageSize * 4 + MetadataAllowance);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			cache.SetNamespaceBudget("ui", imageSize * 2, imageSize * 2);
+			cache.SetNamespaceBudget("export", 0, imageSize * 2);
+
+			auto uiInfo = MakeInsertInfo(0);
+			uiInfo.Namespace = "ui";
+			auto exportInfo = MakeInsertInfo(0);
+			exportInfo.Namespace = "export";
+
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("ui_0.png", 64, 64), uiInfo) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("ui_1.png", 64, 64), uiInfo) == TryAddImageResult::Added);
+
+			//beyond its maximum, a namespace only evicts its own images, even though the cache has room.
+			for (int i = 0; i < 3; i++)
+				ASSERT(cache.TryAddSourceImage(MakeSourceImage("export_" + std::to_string(i) + ".png", 64, 64), exportInfo) == TryAddImageResult::Added);
+
+			ASSERT(cache.GetNamespaceMemoryUsage("export") == imageSize * 2);
+			ASSERT(cache.GetNamespaceMemoryUsage("ui") == imageSize * 2);
+
+			//under memory pressure, the images of a namespace within its guaranteed minimum are not evicted for others.
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("default.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.GetNamespaceMemoryUsage("ui") == imageSize * 2);
+			ASSERT(cache.GetNamespaceMemoryUsage("export") == imageSize);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImage("ui_0.png", image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(cache.TryGetImage("export_1.png", image, source) == TryGetImageResult::NotFound);
+
+			outMessage = "test: NamespaceBudgetsIsolateConsumers passed";
+		}
+
+		void CachesShareStoredSourceImages(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 64 * 64 * 4;
+			SharedImageSourceStore store(imageSize * 2);
+			ImageCache<TestImage> firstCache(imageSize * 2);
+			ImageCache<TestImage> secondCache(imageSize);
+			firstCache.SetSourceImageStore(&store);
+			secondCache.SetSourceImageStore(&store);
+
+			//a source added through one cache is held by the store, not by the cache.
+			ASSERT(firstCache.TryAddSourceImage(MakeSourceImage("shared.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(firstCache.GetCurrentMemoryUsage() == 0);
+			ASSERT(store.GetCurrentMemoryUsage() == imageSize);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+
+			//the entry records the dimensions of the stored source, so that a copy at the source size serves requests for the source.
+			{
+				const TestImage* existingImage = nullptr;
+				auto fullSize = firstCache.MakeSharedPtr(new TestImage(64, 64, "shared.png", nullptr));
+				ASSERT(firstCache.TryAddImage(fullSize, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+				ASSERT(firstCache.TryGetImage("shared.png", image, source) == TryGetImageResult::FoundExactMatch);
+				ASSERT(image == fullSize);
+				image = nullptr;
+			}
+			ASSERT(secondCache.TryGetImageAtSize("shared.png", 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(source && source->GetWidth() == 64);
+			ASSERT(secondCache.TryAddSourceImage(MakeSourceImage("shared.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::NoChange);
+
+			//evicting from the store only drops its reference, a source that is in use stays valid.
+			ASSERT(secondCache.TryAddSourceImage(MakeSourceImage("other_0.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(secondCache.TryAddSourceImage(MakeSourceImage("other_1.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(store.GetSourceImageCount() == 2);
+			ASSERT(source->GetSizeInBytes() == imageSize);
+
+			std::shared_ptr<const IImageSource> evictedSource;
+			ASSERT(firstCache.TryGetImageAtSize("shared.png", 16, 16, image, evictedSource) == TryGetImageResult::NotFound);
+
+			outMessage = "test: CachesShareStoredSourceImages passed";
+		}
+
+		void SharedMemoryStoreSharesSourcesBetweenClients(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			if (!SourceImageDaemon::IsSupported())
+			{
+				outMessage = "test: SharedMemoryStoreSharesSourcesBetweenClients skipped, not supported on this platform";
+				return;
+			}
+
+			const int imageSize = 64 * 64 * 4;
+			const auto socketPath = std::filesystem::temp_directory_path() / "ImageCacheTests.sock";
+			auto daemon = std::make_unique<SourceImageDaemon>(socketPath, imageSize);
+			SharedMemorySourceStore firstClient(socketPath);
+			SharedMemorySourceStore secondClient(socketPath);
+			ASSERT(firstClient.IsConnected() && secondClient.IsConnected());
+
+			auto* pixels = static_cast<unsigned char*>(malloc(imageSize));
+			memset(pixels, 7, imageSize);
+			ASSERT(firstClient.TryAddSourceImage(std::make_shared<ImageSource>("shared.png", 64, 64, pixels), std::chrono::microseconds(0))
+				== TryAddImageResult::Added);
+			ASSERT(daemon->GetCurrentMemoryUsage() == imageSize);
+
+			//the other client maps the pixels the first client decoded.
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(secondClient.TryGetSourceImage("shared.png", source));
+			ASSERT(source->GetWidth() == 64 && source->GetPixels()[imageSize - 1] == 7);
+
+			//a source evicted by the daemon stays valid for the client that mapped it.
+			ASSERT(secondClient.TryAddSourceImage(MakeSourceImage("other.png", 64, 64), std::chrono::microseconds(0)) == TryAddImageResult::Added);
+			ASSERT(daemon->GetSourceImageCount() == 1);
+			ASSERT(source->GetPixels()[0] == 7);
+
+			std::shared_ptr<const IImageSource> evictedSource;
+			ASSERT(!firstClient.TryGetSourceImage("shared.png", evictedSource));
+			ASSERT(secondClient.GetMaxMemory() == imageSize);
+
+			//a client that lost its daemon, e.g. because it was restarted, connects to it again on a later request.
+			daemon.reset();
+			daemon = std::make_unique<SourceImageDaemon>(socketPath, imageSize);
+			ASSERT(!firstClient.TryGetSourceImage("other.png", evictedSource));
+			ASSERT(!firstClient.IsConnected());
+			ASSERT(firstClient.TryAddSourceImage(MakeSourceImage("restarted.png", 64, 64), std::chrono::microseconds(0)) == TryAddImageResult::Added);
+			ASSERT(firstClient.IsConnected() && daemon->GetSourceImageCount() == 1);
+
+			outMessage = "test: SharedMemoryStoreSharesSourcesBetweenClients passed";
+		}
+
+		void ThreadLocalLookupIsInvalidatedByRemoval(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			cache.SetUseThreadLocalLookup(true);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("hot.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto added = cache.MakeSharedPtr(new TestImage(16, 16, "hot.png", nullptr));
+			ASSERT(cache.TryAddImage(added, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+
+			//the first lookup takes the lock and fills this thread's table, the second is answered from it. Requests by path are not.
+			ImageId hotId;
+			ASSERT(ImagePathTable::GetShared().TryIntern("hot.png", hotId));
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			const auto hitCount = ThreadLocalImageLookup<TestImage>::GetHitCount();
+			ASSERT(cache.TryGetImageAtSize(hotId, 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(cache.TryGetImageAtSize(hotId, 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(cache.TryGetImageAtSize("hot.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image == added);
+			ASSERT(ThreadLocalImageLookup<TestImage>::GetHitCount() == hitCount + 1);
+
+			//hits answered by the table still count as requests, and keep the entry from expiring.
+			cache.SetIdleTimeout(std::chrono::milliseconds(20));
+			std::this_thread::sleep_for(std::chrono::milliseconds(30));
+			ASSERT(cache.TryGetImageAtSize(hotId, 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(cache.TrimIdleEntries(16) == 0);
+			ASSERT(cache.GetHotImages(1).front().AccessCount == 5);
+			cache.SetIdleTimeout(std::chrono::milliseconds(0));
+
+			//an invalidated image is not returned even though it is still referenced.
+			ASSERT(cache.TryInvalidateImage("hot.png"));
+			ASSERT(cache.TryGetImageAtSize(hotId, 16, 16, image, source) == TryGetImageResult::NotFound);
+			ASSERT(ThreadLocalImageLookup<TestImage>::GetHitCount() == hitCount + 2);
+
+			ImagePathTable::GetShared().Release(hotId);
+
+			outMessage = "test: ThreadLocalLookupIsInvalidatedByRemoval passed";
+		}
+
+		void NearbySizesShareOneImage(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(512 * 512 * 4 * 4);
+			cache.SetSizeTolerance(0.02);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("nearby.png", 512, 512), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto added = cache.MakeSharedPtr(new TestImage(256, 144, "nearby.png", nullptr));
+			ASSERT(cache.TryAddImage(added, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+
+			//sizes within 2% on both axes are served by the cached image instead of being resized again.
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("nearby.png", 255, 143, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image == added);
+			ASSERT(cache.TryGetImageAtSize("nearby.png", 257, 145, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image == added);
+
+			ASSERT(cache.TryGetImageAtSize("nearby.png", 256, 160, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(image == nullptr);
+
+			outMessage = "test: NearbySizesShareOneImage passed";
+		}
+
+		void IdleEntriesAreTrimmed(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const int imageSize = 16 * 16 * 4;
+			ImageCache<TestImage> cache(imageSize * 20);
+			cache.SetMaxRetainedMemory(imageSize * 4);
+			cache.SetIdleTimeout(std::chrono::milliseconds(1));
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("idle.png", 32, 32), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("busy.png", 32, 32), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto idle = cache.MakeSharedPtr(new TestImage(16, 16, "idle.png", nullptr));
+			ASSERT(cache.TryAddImage(idle, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			idle = nullptr;
+			ASSERT(cache.GetRetainedMemoryUsage() == imageSize);
+
+			//only the entry that was not requested since the timeout is freed, along with its retained image.
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize("busy.png", 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(cache.TrimIdleEntries(16) == imageSize + 32 * 32 * 4);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+			ASSERT(cache.GetRetainedMemoryUsage() == 0);
+			ASSERT(cache.GetCurrentMemoryUsage() == 32 * 32 * 4);
+
+			outMessage = "test: IdleEntriesAreTrimmed passed";
+		}
+
+		void RemovalsAreReportedToSubscribers(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			cache.SetEvictionPolicy(EvictionPolicy::LeastRecentlyUsed);
+			std::vector<std::vector<CacheRemoval>> batches;
+			const auto subscriptionId = cache.Subscribe([&batches](const std::vector<CacheRemoval>& removals) { batches.push_back(removals); });
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("changed.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			const TestImage* existingImage = nullptr;
+			auto resized = cache.MakeSharedPtr(new TestImage(16, 16, "changed.png", nullptr));
+			ASSERT(cache.TryAddImage(resized, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(batches.empty());
+
+			//everything removed by one operation is reported in a single batch.
+			ASSERT(cache.TryInvalidateImage("changed.png"));
+			ASSERT(batches.size() == 1 && batches[0].size() == 3);
+			for (const auto& removal : batches[0])
+			{
+				ASSERT(removal.ImagePath == "changed.png");
+				ASSERT(removal.Reason == CacheRemovalReason::Invalidated);
+			}
+
+			ASSERT(batches[0][0].Tier == CacheRemovalTier::SourceImage && batches[0][0].SizeInBytes == 64 * 64 * 4);
+			ASSERT(batches[0][1].Tier == CacheRemovalTier::ResizedImage && batches[0][1].Width == 16);
+			ASSERT(batches[0][2].Tier == CacheRemovalTier::Entry);
+
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("evicted.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			cache.SetMaxMemory(0);
+			ASSERT(batches.size() == 2 && batches[1].size() == 2 && batches[1][1].Tier == CacheRemovalTier::Entry);
+			ASSERT(batches[1][0].ImagePath == "evicted.png" && batches[1][0].Reason == CacheRemovalReason::Evicted);
+
+			ASSERT(cache.Unsubscribe(subscriptionId));
+			cache.SetMaxMemory(64 * 64 * 4 * 4);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("unreported.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+			ASSERT(cache.TryInvalidateImage("unreported.png"));
+			ASSERT(batches.size() == 2);
+
+			outMessage = "test: RemovalsAreReportedToSubscribers passed";
+		}
+
+		void SimulatorReplaysRecordedTrace(std::string& outMessage)
+		{
+			const auto tracePath = std::filesystem::temp_directory_path() / "ImageCacheTests.trace";
+			{
+				//recorded out of order, as requests complete.
+				RequestTraceRecorder recorder(tracePath);
+				const auto start = std::chrono::steady_clock::now();
+				recorder.Record(start + std::chrono::milliseconds(2), { 0, "trace.png", 32, 32, 0, 0, 0, 0 });
+				recorder.Record(start, { 0, "trace.png", 32, 32, 128, 128, 4000, 100 });
+				recorder.Record(start + std::chrono::milliseconds(3), { 0, "trace.png", 64, 64, 0, 0, 0, 400 });
+			}
+
+			std::vector<RequestTraceEntry> trace;
+			ASSERT(RequestTraceRecorder::TryLoad(tracePath, trace));
+			std::filesystem::remove(tracePath);
+			ASSERT(trace.size() == 3 && trace[0].SourceWidth == 128 && trace[2].Width == 64);
+
+			//with room for everything only the first request decodes, without any room every request does.
+			const CacheSimulator simulator(std::move(trace));
+			const auto results = simulator.SimulateBudgets({ 0, 128 * 128 * 4 * 2 }, CacheSimulationSettings());
+			ASSERT(results.size() == 2);
+			ASSERT(results[0].HitCount == 0 && results[0].RecomputeCost.count() == 3 * 4000 + 100 + 100 + 400);
+			ASSERT(results[1].HitCount == 1 && results[1].HitBytes == 32 * 32 * 4);
+			ASSERT(results[1].RecomputeCost.count() == 4000 + 100 + 400);
+			ASSERT(results[1].RequestedBytes == (32 * 32 * 2 + 64 * 64) * 4);
+
+			outMessage = "test: SimulatorReplaysRecordedTrace passed";
+		}
+
+		void PathAliasesShareOneEntry(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			const auto directory = std::filesystem::temp_directory_path() / "ImageCacheTests.paths";
+			std::filesystem::remove_all(directory);
+			std::filesystem::create_directories(directory / "sub");
+			std::ofstream(directory / "image.png") << "pixels";
+#if defined(_WIN32)
+			//creating symbolic links needs elevated rights on Windows.
+			const auto linkPath = directory / "image.png";
+#else
+			const auto linkPath = directory / "link.png";
+			std::filesystem::create_symlink(directory / "image.png", linkPath);
+#endif
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			cache.SetCanonicalizePaths(true);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage(directory / "image.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize(directory / "sub" / ".." / "image.png", 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+			ASSERT(cache.TryGetImageAtSize(linkPath, 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			const TestImage* existingImage = nullptr;
+			auto resized = cache.MakeSharedPtr(new TestImage(16, 16, linkPath, nullptr));
+			ASSERT(cache.TryAddImage(resized, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.GetCacheEntryCount() == 1);
+
+			ASSERT(cache.TryInvalidateImage(linkPath));
+			ASSERT(cache.GetCacheEntryCount() == 0);
+			resized = nullptr;
+
+#if !defined(_WIN32)
+			//a file key is only kept while the file is unchanged, another file may reuse the inode once it is deleted.
+			PathCanonicalizer canonicalizer;
+			const auto key = canonicalizer.GetKey(directory / "image.png");
+			std::filesystem::create_hard_link(directory / "image.png", directory / "hard.png");
+			ASSERT(canonicalizer.GetKey(directory / "hard.png") == key);
+
+			std::ofstream(directory / "image.png", std::ios::app) << "more pixels";
+			std::filesystem::create_hard_link(directory / "image.png", directory / "changed.png");
+			ASSERT(canonicalizer.GetKey(directory / "changed.png") == (directory / "changed.png").lexically_normal().string());
+
+			canonicalizer.Release((directory / "changed.png").lexically_normal().string());
+			std::filesystem::create_hard_link(directory / "image.png", directory / "released.png");
+			ASSERT(canonicalizer.GetKey(directory / "released.png") == (directory / "released.png").lexically_normal().string());
+
+			//the paths resolved to a released key are resolved again, rather than splitting the file into two keys.
+			ASSERT(canonicalizer.GetKey(directory / "changed.png") == (directory / "released.png").lexically_normal().string());
+#endif
+			std::filesystem::remove_all(directory);
+
+			outMessage = "test: PathAliasesShareOneEntry passed";
+		}
+
+		void InternedPathsFindCachedImages(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			auto& pathTable = ImagePathTable::GetShared();
+			const auto pathCount = pathTable.GetPathCount();
+			ImageId imageId;
+			ImageId sameId;
+			ImageId otherId;
+			ASSERT(pathTable.TryIntern("interned.png", imageId));
+			ASSERT(pathTable.TryIntern(std::filesystem::path("interned.png"), sameId) && sameId == imageId);
+			ASSERT(pathTable.TryIntern("other.png", otherId) && otherId != imageId);
+			ASSERT(pathTable.GetPath(imageId) == "interned.png" && pathTable.GetKey(imageId) == "interned.png");
+
+			ImageCache<TestImage> cache(64 * 64 * 4 * 4);
+			ASSERT(cache.TryAddSourceImage(MakeSourceImage("interned.png", 64, 64), MakeInsertInfo(0)) == TryAddImageResult::Added);
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache.TryGetImageAtSize(imageId, 16, 16, image, source) == TryGetImageResult::FoundSourceImageOfDifferentDimensions);
+
+			const TestImage* existingImage = nullptr;
+			auto resized = cache.MakeSharedPtr(new TestImage(16, 16, "interned.png", nullptr));
+			ASSERT(cache.TryAddImage(resized, MakeInsertInfo(0), existingImage) == TryAddImageResult::AddedAsResizedImage);
+			ASSERT(cache.TryGetImageAtSize(imageId, 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+			ASSERT(image == resized);
+			ASSERT(cache.TryGetImage(otherId, image, source) == TryGetImageResult::NotFound);
+
+			//the entry holds its own reference to the path, which is released with the entry.
+			pathTable.Release(imageId);
+			pathTable.Release(sameId);
+			pathTable.Release(otherId);
+			ASSERT(pathTable.GetPathCount() == pathCount + 1);
+			ASSERT(cache.TryGetImageAtSize("interned.png", 16, 16, image, source) == TryGetImageResult::FoundExactMatch);
+
+			ASSERT(cache.TryInvalidateImage("interned.png"));
+			ASSERT(pathTable.GetPathCount() == pathCount);
+
+			//the slot of a released path is reused.
+			ImageId reusedId;
+			ASSERT(pathTable.TryIntern("reused.png", reusedId) && (reusedId == imageId || reusedId == otherId));
+			ASSERT(pathTable.GetPath(reusedId) == "reused.png");
+			pathTable.Release(reusedId);
+
+			outMessage = "test: InternedPathsFindCachedImages passed";
+		}
+
+		void ChangedFilesAreInvalidatedAndUnwatched(std::string& outMessage)
+		{
+			using namespace ImageCaching;
+
+			//the loader and cache are not deleted, as the loader's update thread may still be running.
+			auto* cache = new ImageCache<TestImage>(1920 * 1080 * 4 * 4);
+			auto* loader = new ImageLoader<TestImage>(cache, new ImageFactory(), 1);
+			if (!loader->EnableFileWatching())
+			{
+				outMessage = "test: ChangedFilesAreInvalidatedAndUnwatched skipped, file watching is not supported";
+				return;
+			}
+
+			const auto directory = std::filesystem::temp_directory_path() / "ImageCacheTests.watched";
+			std::filesystem::create_directories(directory);
+			const auto imagePath = directory / "watched.jpg";
+			std::filesystem::copy_file(UnitTestsSetup::GetTestDataPath() / "@base_01 (1).jpg", imagePath,
+				std::filesystem::copy_options::overwrite_existing);
+
+			//the same file under a second spelling of its path is cached and watched separately, the loaded images are held so that
+			//their entries are not removed when they are released.
+			const auto otherImagePath = directory / "." / "watched.jpg";
+			std::vector<std::shared_ptr<const TestImage>> loadedImages;
+			for (const auto& path : { imagePath, otherImagePath })
+			{
+				std::atomic<bool> loaded = false;
+				loader->TryGetImage(path, [&loaded, &loadedImages](const ImageLoadTaskResult<TestImage>& result)
+				{
+					loadedImages.push_back(result.GetImage());
+					loaded = true;
+				});
+				while (!loaded)
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+
+			std::shared_ptr<const TestImage> image;
+			std::shared_ptr<const IImageSource> source;
+			ASSERT(cache->TryGetImage(imagePath, image, source) != TryGetImageResult::NotFound);
+			ASSERT(cache->TryGetImage(otherImagePath, image, source) != TryGetImageResult::NotFound);
+			ASSERT(loader->GetWatchedFileCount() == 2);
+			image = nullptr;
+			source = nullptr;
+
+			//editing the file invalidates the entry of each spelling, after which the file is no longer watched.
+			std::filesystem::copy_file(UnitTestsSetup::GetTestDataPath() / "@base_01 (2).jpg", imagePath,
+				std::filesystem::copy_options::overwrite_existing);
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while ((cache->GetCacheEntryCount() != 0 || loader->GetWatchedFileCount() != 0) && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+			ASSERT(cache->TryGetImage(imagePath, image, source) == TryGetImageResult::NotFound);
+			ASSERT(cache->TryGetImage(otherImagePath, image, source) == TryGetImageResult::NotFound);
+			ASSERT(loader->GetWatchedFileCount() == 0);
+			std::filesystem::remove_all(directory);
+
+			outMessage = "test: ChangedFilesAreInvalidatedAndUnwatched passed";
+		}
+
+		void ThumbnailsRoundTripAcrossRuns(std::string& outMessage)
+		{
+			const auto directory = std::filesystem::temp_directory_path() / "ImageCacheTests.thumbnails";
+			std::filesystem::remove_all(directory);
+
+			FileStat sourceStat;
+			sourceStat.SizeInBytes = 100;
+			sourceStat.ModifiedTime = 1;
+			std::vector<unsigned char> pixels(8 * 8 * 4);
+			for (size_t i = 0; i < pixels.size(); i++)
+				pixels[i] = static_cast<unsigned char>(i);
+
+			{
+				ThumbnailStore store(directory, 1024 * 1024);
+				ASSERT(store.TryWrite("image.png", sourceStat, 8, 8, pixels.data()));
+				ASSERT(store.GetThumbnailCount() == 1 && store.GetSizeInBytes() == 8 * 8 * 4);
+
+				unsigned char* readPixels = nullptr;
+				ASSERT(store.TryRead("image.png", sourceStat, 8, 8, readPixels));
+				ASSERT(memcmp(readPixels, pixels.data(), pixels.size()) == 0);
+				delete[] readPixels;
+				ASSERT(!store.TryRead("image.png", sourceStat, 4, 4, readPixels) && !readPixels);
+			}
+
+			//the index is saved when the store is destroyed, and the thumbnail is served by the next run.
+			{
+				ThumbnailStore store(directory, 1024 * 1024);
+				ASSERT(store.GetThumbnailCount() == 1);
+
+				unsigned char* readPixels = nullptr;
+				ASSERT(store.TryRead("image.png", sourceStat, 8, 8, readPixels));
+				ASSERT(memcmp(readPixels, pixels.data(), pixels.size()) == 0);
+				delete[] readPixels;
+
+				//a thumbnail of a source file that has since changed is removed.
+				auto changedStat = sourceStat;
+				changedStat.ModifiedTime = 2;
+				ASSERT(!store.TryRead("image.png", changedStat, 8, 8, readPixels));
+				ASSERT(store.GetThumbnailCount() == 0 && store.GetSizeInBytes() == 0);
+				ASSERT(store.TryWrite("image.png", sourceStat, 8, 8, pixels.data()));
+			}
+
+			//an index that does not describe the data file, here because the data file is of another generation, is not trusted.
+			{
+				std::fstream dataFile(directory / "thumbnails.dat", std::ios::in | std::ios::out | std::ios::binary);
+				dataFile.seekp(sizeof(uint32_t) * 2);
+				const uint64_t otherGeneration = 1;
+				dataFile.write(reinterpret_cast<const char*>(&otherGeneration), sizeof(otherGeneration));
+			}
+
+			{
+				ThumbnailStore store(directory, 1024 * 1024);
+				ASSERT(store.GetThumbnailCount() == 0 && store.GetSizeInBytes() == 0);
+			}
+
+			std::filesystem::remove_all(directory);
+			outMessage = "test: ThumbnailsRoundTripAcrossRuns passed";
+		}
+
+		void ThumbnailStoreTrimsLeastRecentlyUsed(std::string& outMessage)
+		{
+			const auto directory = std::filesystem::temp_directory_path() / "ImageCacheTests.trimmedThumbnails";
+			std::filesystem::remove_all(directory);
+
+			constexpr int64_t thumbnailSize = 8 * 8 * 4;
+			const std::vector<unsigned char> pixels(thumbnailSize, 7);
+			const FileStat sourceStat;
+
+			{
+				ThumbnailStore store(directory, thumbnailSize * 4);
+				for (int i = 0; i < 4; i++)
+					ASSERT(store.TryWrite("image" + std::to_string(i) + ".png", sourceStat, 8, 8, pixels.data()));
+
+				//the first thumbnail is read, so the second is the least recently used when the store exceeds its size.
+				unsigned char* readPixels = nullptr;
+				ASSERT(store.TryRead("image0.png", sourceStat, 8, 8, readPixels));
+				delete[] readPixels;
+
+				ASSERT(store.TryWrite("image4.png", sourceStat, 8, 8, pixels.data()));
+				ASSERT(store.GetThumbnailCount() == 4 && store.GetSizeInBytes() == thumbnailSize * 4);
+				ASSERT(!store.TryRead("image1.png", sourceStat, 8, 8, readPixels));
+
+				store.SetMaxSize(thumbnailSize * 2);
+				ASSERT(store.GetThumbnailCount() == 2);
+				ASSERT(store.TryRead("image0.png", sourceStat, 8, 8, readPixels));
+				delete[] readPixels;
+				ASSERT(store.TryRead("image4.png", sourceStat, 8, 8, readPixels));
+				delete[] readPixels;
+			}
+
+			//the order of access is kept across runs, and the space of removed thumbnails has been compacted away.
+			{
+				ThumbnailStore store(directory, thumbnailSize);
+				ASSERT(store.GetThumbnailCount() == 1);
+				unsigned char* readPixels = nullptr;
+				ASSERT(store.TryRead("image4.png", sourceStat, 8, 8, readPixels));
+				ASSERT(memcmp(readPixels, pixels.data(), pixels.size()) == 0);
+				delete[] readPixels;
+			}
+
+			std::filesystem::remove_all(directory);
+			outMessage = "test: ThumbnailStoreTrimsLeastRecentlyUsed passed";
+		}
+
+		std::vector<std::string> RunAll()
+		{
+			auto results = std::vector<std::string>();
+
+			std::string testMessage;
+			AdmissionFilterRejectsOneHitImages(testMessage);
+			results.emplace_back(testMessage);
+
+			CostAwareEvictionKeepsExpensiveImages(testMessage);
+			results.emplace_back(testMessage);
+
+			BulkEvictionFollowsAccessOrder(testMessage);
+			results.emplace_back(testMessage);
+
+			ReleasedImagesAreRetainedWithinBudget(testMessage);
+			results.emplace_back(testMessage);
+
+			SmallestLargerCopyIsUsedForResizing(testMessage);
+			results.emplace_back(testMessage);
+
+			MipmapLevelIsUsedForResizing(testMessage);
+			results.emplace_back(testMessage);
+
+			IdenticalFilesShareOneEntry(testMessage);
+			results.emplace_back(testMessage);
+
+			EvictedSourceIsSpilledAndRestored(testMessage);
+			results.emplace_back(testMessage);
+
+			EncodedBytesOutliveEvictedSource(testMessage);
+			results.emplace_back(testMessage);
+
+			PinnedImagesAreNeverEvicted(testMessage);
+			results.emplace_back(testMessage);
+
+			SnapshotRoundTripsHotImages(testMessage);
+			results.emplace_back(testMessage);
+
+			TiersHaveSeparateBudgets(testMessage);
+			results.emplace_back(testMessage);
+
+			NamespaceBudgetsIsolateConsumers(testMessage);
+			results.emplace_back(testMessage);
+
+			CachesShareStoredSourceImages(testMessage);
+			results.emplace_back(testMessage);
+
+			SharedMemoryStoreSharesSourcesBetweenClients(testMessage);
+			results.emplace_back(testMessage);
+
+			ThreadLocalLookupIsInvalidatedByRemoval(testMessage);
+			results.emplace_back(testMessage);
+
+			NearbySizesShareOneImage(testMessage);
+			results.emplace_back(testMessage);
+
+			IdleEntriesAreTrimmed(testMessage);
+			results.emplace_back(testMessage);
+
+			RemovalsAreReportedToSubscribers(testMessage);
+			results.emplace_back(testMessage);
+
+			SimulatorReplaysRecordedTrace(testMessage);
+			results.emplace_back(testMessage);
+
+			PathAliasesShareOneEntry(testMessage);
+			results.emplace_back(testMessage);
+
+			InternedPathsFindCachedImages(testMessage);
+			results.emplace_back(testMessage);
+
+			ChangedFilesAreInvalidatedAndUnwatched(testMessage);
+			results.emplace_back(testMessage);
+
+			ThumbnailsRoundTripAcrossRuns(testMessage);
+			results.emplace_back(testMessage);
+
+			ThumbnailStoreTrimsLeastRecentlyUsed(testMessage);
+			results.emplace_back(testMessage);
+
+			return results;
+		}
 	};
-}
\ No newline at end of file
+}
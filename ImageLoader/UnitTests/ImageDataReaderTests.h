@@ -1,7 +1,10 @@
 #pragma once
 #include "UnitTestsSetup.h"
 #include "../Implementations/ImageDataReader.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <thread>
 #include "assert.h"
 
 namespace UnitTests
@@ -37,6 +40,63 @@ namespace UnitTests
 			return TestResult::Pass;
 		}
 
+		TestResult FileStatIsQueriedAgainAfterItExpires(std::string& outMessage)
+		{
+			const auto filePath = std::filesystem::temp_directory_path() / "ImageDataReaderTests.stat";
+			std::ofstream(filePath, std::ios::binary) << "a";
+
+			FileStatCache fileStatCache(std::chrono::milliseconds(50));
+			FileStat stat;
+			ASSERT(fileStatCache.TryGetStat(filePath, stat));
+			ASSERT(stat.SizeInBytes == 1);
+
+			//the change is not seen until the cached stat expires.
+			std::ofstream(filePath, std::ios::binary) << "abcde";
+			ASSERT(fileStatCache.TryGetStat(filePath, stat));
+			ASSERT(stat.SizeInBytes == 1);
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+			ASSERT(fileStatCache.TryGetStat(filePath, stat));
+			ASSERT(stat.SizeInBytes == 5);
+
+			std::filesystem::remove(filePath);
+			outMessage = "test: FileStatIsQueriedAgainAfterItExpires passed";
+			return TestResult::Pass;
+		}
+
+		TestResult UnreadableFileIsReadAgainOnceItChanges(std::string& outMessage)
+		{
+			const auto filePath = std::filesystem::temp_directory_path() / "ImageDataReaderTests.missing";
+			std::filesystem::remove(filePath);
+
+			FileStatCache fileStatCache(std::chrono::milliseconds(50));
+			FileStat stat;
+			ASSERT(!fileStatCache.TryGetStat(filePath, stat));
+			ASSERT(fileStatCache.IsKnownUnreadable(filePath));
+
+			//a file that appears is found once the negative entry expires.
+			std::ofstream(filePath, std::ios::binary) << "abc";
+			ASSERT(!fileStatCache.TryGetStat(filePath, stat));
+			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+			ASSERT(!fileStatCache.IsKnownUnreadable(filePath));
+			ASSERT(fileStatCache.TryGetStat(filePath, stat));
+
+			//an undecodable file stays unreadable after expiring, until it is changed.
+			fileStatCache.MarkUndecodable(filePath);
+			ASSERT(fileStatCache.IsKnownUnreadable(filePath));
+			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+			ASSERT(!fileStatCache.TryGetStat(filePath, stat));
+
+			std::ofstream(filePath, std::ios::binary) << "abcdef";
+			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+			ASSERT(fileStatCache.TryGetStat(filePath, stat));
+			ASSERT(!fileStatCache.IsKnownUnreadable(filePath));
+
+			std::filesystem::remove(filePath);
+			outMessage = "test: UnreadableFileIsReadAgainOnceItChanges passed";
+			return TestResult::Pass;
+		}
+
 		std::vector<std::string> LoadFiles()
 		{
 			auto results = std::vector<std::string>();
@@ -52,6 +112,16 @@ namespace UnitTests
 			else
 				results.emplace_back("unknown error");
 
+			if (FileStatIsQueriedAgainAfterItExpires(testMessage) != UnitTests::TestResult::Undefined)
+				results.emplace_back(testMessage);
+			else
+				results.emplace_back("unknown error");
+
+			if (UnreadableFileIsReadAgainOnceItChanges(testMessage) != UnitTests::TestResult::Undefined)
+				results.emplace_back(testMessage);
+			else
+				results.emplace_back("unknown error");
+
 			return results;
 		}
 
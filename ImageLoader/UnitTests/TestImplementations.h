@@ -47,7 +47,7 @@ namespace UnitTests
 		/// Gets the path from which image was originally loaded. This also serves as a unique identifier in <see cref="IImageCache"/>.
 		/// </summary>
 		[[nodiscard]]
-		std::filesystem::path GetImagePath() const override {
+		const std::filesystem::path& GetImagePath() const override {
 			return _path;
 		}
 
@@ -55,8 +55,16 @@ namespace UnitTests
 		/// Gets the size in bytes of the image.
 		/// </summary>
 		[[nodiscard]]
-		unsigned int GetSizeInBytes() const override {
-			return _width * _height * 4;
+		int64_t GetSizeInBytes() const override {
+			return static_cast<int64_t>(_width) * _height * 4;
+		}
+
+		/// <summary>
+		/// Gets the image data pixels, as raw 8 bit rgba data.
+		/// </summary>
+		[[nodiscard]]
+		const unsigned char* GetPixels() const {
+			return _imageData;
 		}
 	};
 
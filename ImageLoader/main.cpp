@@ -5,6 +5,7 @@
 #include <iostream>
 #include <filesystem>
 
+#include "UnitTests/ImageCacheTests.h"
 #include "UnitTests/ImageDataReaderTests.h"
 #include "UnitTests/TestImplementations.h"
 #include "Assert.h"
@@ -219,6 +220,15 @@ int main()
 				std::cout << message << "\n";
 		}
 
+		{
+			//image cache unit tests
+			auto imageCacheTests = new UnitTests::ImageCacheTests();
+
+			const auto testResultMessages = imageCacheTests->RunAll();
+			for (const auto& message : testResultMessages)
+				std::cout << message << "\n";
+		}
+
 		std::cout << "Finished unit tests : press enter to continue" << "\n";
 		auto wait = std::cin.get();
 	}